@@ -45,7 +45,10 @@ extern TIM_HandleTypeDef htim5;
 extern TIM_HandleTypeDef htim8;
 
 /* USER CODE BEGIN Private defines */
-
+extern DMA_HandleTypeDef hdma_tim1_up;
+extern DMA_HandleTypeDef hdma_tim4_up;
+extern DMA_HandleTypeDef hdma_tim8_up;
+extern TIM_HandleTypeDef htim7;
 /* USER CODE END Private defines */
 
 void MX_TIM1_Init(void);
@@ -58,7 +61,7 @@ void MX_TIM8_Init(void);
 void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
 
 /* USER CODE BEGIN Prototypes */
-
+void Tim_Loop_Init(void);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
@@ -31,9 +31,11 @@
 #include "candy.h"
 #include "cstring.h"
 #include "key.h"
+#include "motor.h"
 #include "queue.h"
 #include "scheduler.h"
 #include "step.h"
+#include "step_pvt.h"
 #include "uart_pack.h"
 /* USER CODE END Includes */
 
@@ -54,10 +56,13 @@
 /* Private variables ---------------------------------------------------------*/
 
 /* USER CODE BEGIN PV */
-uart_dma_ctrl_t uart_1;
-step_ctrl_t step_1;
-step_ctrl_t step_2;
-step_ctrl_t step_3;
+uart_dma_ctrl_t uart_1 __DMA_BUFFER;  // 含DMA接收缓冲区
+step_ctrl_t step_1 __DTCM_DATA;
+step_ctrl_t step_2 __DTCM_DATA;
+step_ctrl_t step_3 __DTCM_DATA;
+motor_t motor_1 __DTCM_DATA;
+motor_t motor_2 __DTCM_DATA;
+static uint8_t estopId = SCH_INVALID_ID;  // 急停清理事件任务
 // uint8_t user_com_data;
 /* USER CODE END PV */
 
@@ -65,6 +70,7 @@ step_ctrl_t step_3;
 void SystemClock_Config(void);
 /* USER CODE BEGIN PFP */
 void Add_Tasks(void);
+static void MPU_Config(void);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -78,7 +84,9 @@ void Add_Tasks(void);
  */
 int main(void) {
   /* USER CODE BEGIN 1 */
-
+  MPU_Config();
+  SCB_EnableICache();
+  SCB_EnableDCache();
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -120,6 +128,20 @@ int main(void) {
             STEP2_DIR_Pin, 0);
   Step_Init(&step_3, &htim8, &htim5, TIM_CHANNEL_1, STEP3_DIR_GPIO_Port,
             STEP3_DIR_Pin, 0);
+#if MOTOR_NUM >= 1
+  Motor_Setup(&motor_1, &MOTOR1_TIM_ENCODER, &MOTOR1_TIM_PWM,
+              MOTOR1_CH_FORWARD, MOTOR1_CH_REVERSE);
+  Motor_Loop_Add(&motor_1);
+#endif
+#if MOTOR_NUM >= 2
+  Motor_Setup(&motor_2, &MOTOR2_TIM_ENCODER, &MOTOR2_TIM_PWM,
+              MOTOR2_CH_FORWARD, MOTOR2_CH_REVERSE);
+  Motor_Loop_Add(&motor_2);
+#endif
+#if MOTOR_NUM > 0
+  Tim_Loop_Init();
+  Motor_Loop_Start(&htim7, MOTOR_LOOP_DEFAULT_FREQ);
+#endif
   Add_Tasks();
   RGB(0, 0, 0);
   LOG_I("--- System Boot ---");
@@ -199,7 +221,10 @@ void SystemClock_Config(void) {
 }
 
 /* USER CODE BEGIN 4 */
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {}
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+  // 串口忙时未能发送的ACK/事件在发送完成后重试
+  if (huart->Instance == USART3) UserCom_Post(USER_COM_EVT_TX);
+}
 
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
   // if (huart->Instance == USART3) {
@@ -208,7 +233,8 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
   // }
 }
 
-void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size) {
+__ITCM_CODE void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart,
+                                            uint16_t Size) {
   Uart_DMA_Data_Process(&uart_1, huart, Size);
   if (huart->Instance == USART3) {
     UserCom_DataAnl(user_data_temp, Size - 1);
@@ -216,31 +242,91 @@ void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size) {
   }
 }
 
-void Task_Key_Func(void) {
-  uint16_t key_value = key_read_value();
-  if (key_value != 0) {
+// 按键扫描, 读写缓冲区在同一优先级, 按键事件投递给通讯事件任务发送
+void Task_Key_Scan(void) {
+  uint16_t key_value;
+  key_check_all_loop_1ms();
+  while ((key_value = key_read_value()) != 0) {
     LOG_D("key_value: %d", key_value);
+    if (key_value == KEY_SHORT) {
+      UserCom_Post(USER_COM_EVT_USER(USER_EVENT_KEY_SHORT));
+    } else if (key_value == KEY_LONG) {
+      UserCom_Post(USER_COM_EVT_USER(USER_EVENT_KEY_LONG));
+    } else if (key_value == KEY_DOUBLE) {
+      UserCom_Post(USER_COM_EVT_USER(USER_EVENT_KEY_DOUBLE));
+    }
   }
-  if (key_value == KEY_SHORT) {
-    UserCom_SendEvent(USER_EVENT_KEY_SHORT, USER_EVENT_OP_SET);
-  } else if (key_value == KEY_LONG) {
-    UserCom_SendEvent(USER_EVENT_KEY_LONG, USER_EVENT_OP_SET);
-  } else if (key_value == KEY_DOUBLE) {
-    UserCom_SendEvent(USER_EVENT_KEY_DOUBLE, USER_EVENT_OP_SET);
+}
+
+// 步进电机运动完成(定时器中断中调用), 通知主机
+void Step_Finished_Callback(step_ctrl_t *step) {
+  if (step == &step_1) {
+    UserCom_Post(USER_COM_EVT_USER(USER_EVENT_STEP1_DONE));
+  } else if (step == &step_2) {
+    UserCom_Post(USER_COM_EVT_USER(USER_EVENT_STEP2_DONE));
+  } else if (step == &step_3) {
+    UserCom_Post(USER_COM_EVT_USER(USER_EVENT_STEP3_DONE));
   }
 }
 
+// 急停清理, Step_Stop可能等待DMA, 日志等待串口, 因此不在实时任务中运行
+static void EStop_Event_Task(uint32_t events) {
+  UNUSED(events);
+  Step_EStop_Clear();
+}
+
+// 急停(可能在中断中调用), 投递给后台清理任务
+void Step_EStop_Callback(void) { Sch_Post(estopId, 1); }
+
 // TIM interrupt
+// STEP_IRQ_DIRECT为0时从定时器中断经HAL回调分发
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
   Step_IT_Handler(&step_1, htim);
   Step_IT_Handler(&step_2, htim);
   Step_IT_Handler(&step_3, htim);
 }
 
+// TIM compare interrupt (step deceleration point)
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim) {
+  Step_IT_Handler(&step_1, htim);
+  Step_IT_Handler(&step_2, htim);
+  Step_IT_Handler(&step_3, htim);
+}
+
 void Add_Tasks(void) {
+  uint8_t keyId, planId, pvtId;
+  UserCom_Init();
   Add_SchTask(UserCom_Task, 100, 1);
-  Add_SchTask(Task_Key_Func, 50, 1);
-  Add_SchTask(key_check_all_loop_1ms, 1000, 1);
+  keyId = Add_SchTask(Task_Key_Scan, 1000, 1);
+  planId = Add_SchTask(Step_Planner_Task, 1000, 1);
+  pvtId = Add_SchTask_Dt(PVT_Task, 1000, 1);
+  estopId = Add_SchEvent(EStop_Event_Task, SCH_PRIO_BG, 1);
+  // 按键扫描和运动规划不受串口通讯等后台任务耗时影响
+  _Set_SchTask_Prio_Id(keyId, SCH_PRIO_RT);
+  _Set_SchTask_Prio_Id(planId, SCH_PRIO_RT);
+  _Set_SchTask_Prio_Id(pvtId, SCH_PRIO_RT);
+}
+
+/**
+ * @brief 配置MPU, 将DMA缓冲区(见H750_STEP.sct的RW_DMA)设为不可缓存
+ * @note 开启D-Cache后DMA与CPU看到的数据可能不一致, 不可缓存区免去维护
+ */
+static void MPU_Config(void) {
+  MPU_Region_InitTypeDef mpu = {0};
+  HAL_MPU_Disable();
+  mpu.Enable = MPU_REGION_ENABLE;
+  mpu.Number = MPU_REGION_NUMBER0;
+  mpu.BaseAddress = 0x24070000;
+  mpu.Size = MPU_REGION_SIZE_64KB;
+  mpu.SubRegionDisable = 0x00;
+  mpu.TypeExtField = MPU_TEX_LEVEL1;  // TEX=1,C=0,B=0: Normal, 不可缓存
+  mpu.AccessPermission = MPU_REGION_FULL_ACCESS;
+  mpu.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+  mpu.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  mpu.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  mpu.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  HAL_MPU_ConfigRegion(&mpu);
+  HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
 }
 
 /* USER CODE END 4 */
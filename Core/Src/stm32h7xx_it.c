@@ -23,6 +23,9 @@
 #include "stm32h7xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "motor.h"
+#include "scheduler.h"
+#include "step.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -66,7 +69,9 @@ extern DMA_HandleTypeDef hdma_usart3_rx;
 extern UART_HandleTypeDef huart1;
 extern UART_HandleTypeDef huart3;
 /* USER CODE BEGIN EV */
-
+extern DMA_HandleTypeDef hdma_tim1_up;
+extern DMA_HandleTypeDef hdma_tim4_up;
+extern DMA_HandleTypeDef hdma_tim8_up;
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -179,7 +184,7 @@ void DebugMon_Handler(void)
 void PendSV_Handler(void)
 {
   /* USER CODE BEGIN PendSV_IRQn 0 */
-
+  Sch_PendSV_IRQ_Handler();
   /* USER CODE END PendSV_IRQn 0 */
   /* USER CODE BEGIN PendSV_IRQn 1 */
 
@@ -196,6 +201,7 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
+  Sch_Tick_IRQ_Handler();
 
   /* USER CODE END SysTick_IRQn 1 */
 }
@@ -269,7 +275,11 @@ void DMA1_Stream4_IRQHandler(void)
 void TIM2_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM2_IRQn 0 */
-
+  STEP_IRQ_PROFILE_BEGIN();
+#if STEP_IRQ_DIRECT
+  Step_IRQ_Handler(TIM2_IRQn);
+  return;
+#endif
   /* USER CODE END TIM2_IRQn 0 */
   HAL_TIM_IRQHandler(&htim2);
   /* USER CODE BEGIN TIM2_IRQn 1 */
@@ -283,7 +293,11 @@ void TIM2_IRQHandler(void)
 void TIM3_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM3_IRQn 0 */
-
+  STEP_IRQ_PROFILE_BEGIN();
+#if STEP_IRQ_DIRECT
+  Step_IRQ_Handler(TIM3_IRQn);
+  return;
+#endif
   /* USER CODE END TIM3_IRQn 0 */
   HAL_TIM_IRQHandler(&htim3);
   /* USER CODE BEGIN TIM3_IRQn 1 */
@@ -325,7 +339,11 @@ void USART3_IRQHandler(void)
 void TIM5_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM5_IRQn 0 */
-
+  STEP_IRQ_PROFILE_BEGIN();
+#if STEP_IRQ_DIRECT
+  Step_IRQ_Handler(TIM5_IRQn);
+  return;
+#endif
   /* USER CODE END TIM5_IRQn 0 */
   HAL_TIM_IRQHandler(&htim5);
   /* USER CODE BEGIN TIM5_IRQn 1 */
@@ -335,4 +353,36 @@ void TIM5_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA2 stream0 global interrupt (TIM1_UP).
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_tim1_up);
+}
+
+/**
+  * @brief This function handles DMA2 stream1 global interrupt (TIM4_UP).
+  */
+void DMA2_Stream1_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_tim4_up);
+}
+
+/**
+  * @brief This function handles DMA2 stream2 global interrupt (TIM8_UP).
+  */
+void DMA2_Stream2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_tim8_up);
+}
+
+/**
+  * @brief This function handles TIM7 global interrupt (motor control loop).
+  */
+void TIM7_IRQHandler(void)
+{
+  Motor_Loop_IRQ_Handler();
+}
+
 /* USER CODE END 1 */
@@ -21,7 +21,33 @@
 #include "tim.h"
 
 /* USER CODE BEGIN 0 */
+DMA_HandleTypeDef hdma_tim1_up;
+DMA_HandleTypeDef hdma_tim4_up;
+DMA_HandleTypeDef hdma_tim8_up;
 
+/**
+ * @brief 配置主定时器更新事件DMA(用于步进电机加减速时写入ARR)
+ * @param  hdma             DMA句柄
+ * @param  stream           DMA数据流
+ * @param  request          DMA请求
+ */
+static void Tim_UP_DMA_Init(DMA_HandleTypeDef *hdma, DMA_Stream_TypeDef *stream,
+                            uint32_t request) {
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  hdma->Instance = stream;
+  hdma->Init.Request = request;
+  hdma->Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma->Init.MemInc = DMA_MINC_ENABLE;
+  hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  hdma->Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  hdma->Init.Mode = DMA_NORMAL;
+  hdma->Init.Priority = DMA_PRIORITY_HIGH;
+  hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  if (HAL_DMA_Init(hdma) != HAL_OK) {
+    Error_Handler();
+  }
+}
 /* USER CODE END 0 */
 
 TIM_HandleTypeDef htim1;
@@ -340,7 +366,11 @@ void HAL_TIM_PWM_MspInit(TIM_HandleTypeDef* tim_pwmHandle)
     /* TIM1 clock enable */
     __HAL_RCC_TIM1_CLK_ENABLE();
   /* USER CODE BEGIN TIM1_MspInit 1 */
-
+    /* TIM1_UP DMA Init */
+    Tim_UP_DMA_Init(&hdma_tim1_up, DMA2_Stream0, DMA_REQUEST_TIM1_UP);
+    __HAL_LINKDMA(tim_pwmHandle, hdma[TIM_DMA_ID_UPDATE], hdma_tim1_up);
+    HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
   /* USER CODE END TIM1_MspInit 1 */
   }
   else if(tim_pwmHandle->Instance==TIM4)
@@ -351,7 +381,11 @@ void HAL_TIM_PWM_MspInit(TIM_HandleTypeDef* tim_pwmHandle)
     /* TIM4 clock enable */
     __HAL_RCC_TIM4_CLK_ENABLE();
   /* USER CODE BEGIN TIM4_MspInit 1 */
-
+    /* TIM4_UP DMA Init */
+    Tim_UP_DMA_Init(&hdma_tim4_up, DMA2_Stream1, DMA_REQUEST_TIM4_UP);
+    __HAL_LINKDMA(tim_pwmHandle, hdma[TIM_DMA_ID_UPDATE], hdma_tim4_up);
+    HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
   /* USER CODE END TIM4_MspInit 1 */
   }
   else if(tim_pwmHandle->Instance==TIM8)
@@ -362,7 +396,11 @@ void HAL_TIM_PWM_MspInit(TIM_HandleTypeDef* tim_pwmHandle)
     /* TIM8 clock enable */
     __HAL_RCC_TIM8_CLK_ENABLE();
   /* USER CODE BEGIN TIM8_MspInit 1 */
-
+    /* TIM8_UP DMA Init */
+    Tim_UP_DMA_Init(&hdma_tim8_up, DMA2_Stream2, DMA_REQUEST_TIM8_UP);
+    __HAL_LINKDMA(tim_pwmHandle, hdma[TIM_DMA_ID_UPDATE], hdma_tim8_up);
+    HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
   /* USER CODE END TIM8_MspInit 1 */
   }
 }
@@ -496,7 +534,8 @@ void HAL_TIM_PWM_MspDeInit(TIM_HandleTypeDef* tim_pwmHandle)
     /* Peripheral clock disable */
     __HAL_RCC_TIM1_CLK_DISABLE();
   /* USER CODE BEGIN TIM1_MspDeInit 1 */
-
+    HAL_DMA_DeInit(tim_pwmHandle->hdma[TIM_DMA_ID_UPDATE]);
+    HAL_NVIC_DisableIRQ(DMA2_Stream0_IRQn);
   /* USER CODE END TIM1_MspDeInit 1 */
   }
   else if(tim_pwmHandle->Instance==TIM4)
@@ -507,7 +546,8 @@ void HAL_TIM_PWM_MspDeInit(TIM_HandleTypeDef* tim_pwmHandle)
     /* Peripheral clock disable */
     __HAL_RCC_TIM4_CLK_DISABLE();
   /* USER CODE BEGIN TIM4_MspDeInit 1 */
-
+    HAL_DMA_DeInit(tim_pwmHandle->hdma[TIM_DMA_ID_UPDATE]);
+    HAL_NVIC_DisableIRQ(DMA2_Stream1_IRQn);
   /* USER CODE END TIM4_MspDeInit 1 */
   }
   else if(tim_pwmHandle->Instance==TIM8)
@@ -518,7 +558,8 @@ void HAL_TIM_PWM_MspDeInit(TIM_HandleTypeDef* tim_pwmHandle)
     /* Peripheral clock disable */
     __HAL_RCC_TIM8_CLK_DISABLE();
   /* USER CODE BEGIN TIM8_MspDeInit 1 */
-
+    HAL_DMA_DeInit(tim_pwmHandle->hdma[TIM_DMA_ID_UPDATE]);
+    HAL_NVIC_DisableIRQ(DMA2_Stream2_IRQn);
   /* USER CODE END TIM8_MspDeInit 1 */
   }
 }
@@ -571,5 +612,24 @@ void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef* tim_baseHandle)
 }
 
 /* USER CODE BEGIN 1 */
+TIM_HandleTypeDef htim7;
 
+/**
+ * @brief 配置基本定时器TIM7, 作为直流电机控制环的周期中断
+ * 计数频率为10MHz, 重装载值由Motor_Loop_Start按控制频率设置
+ */
+void Tim_Loop_Init(void) {
+  __HAL_RCC_TIM7_CLK_ENABLE();
+  htim7.Instance = TIM7;
+  htim7.Init.Prescaler = 24 - 1;
+  htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim7.Init.Period = 1000 - 1;
+  htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim7) != HAL_OK) {
+    Error_Handler();
+  }
+  // 低于步进电机中断, 避免控制环计算推迟脉冲计数
+  HAL_NVIC_SetPriority(TIM7_IRQn, 4, 0);
+  HAL_NVIC_EnableIRQ(TIM7_IRQn);
+}
 /* USER CODE END 1 */
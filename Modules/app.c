@@ -10,8 +10,11 @@
 
 #include "app.h"
 
+#include "motor.h"
 #include "queue.h"
+#include "scheduler.h"
 #include "step.h"
+#include "step_pvt.h"
 #include "uart_pack.h"
 #include "usart.h"
 extern step_ctrl_t step_1;
@@ -20,23 +23,30 @@ extern step_ctrl_t step_3;
 
 void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len);
 void UserCom_DataExchange(void);
-void UserCom_SendData(uint8_t* dataToSend, uint8_t Length);
-void UserCom_CheckAck();
+uint8_t UserCom_SendData(uint8_t* dataToSend, uint8_t Length);
+uint8_t UserCom_SendSchStat(uint8_t taskId);
+uint8_t UserCom_CheckAck();
+void UserCom_Event_Task(uint32_t events);
 void UserCom_SendAck(uint8_t option, uint8_t* data_p, uint8_t data_len);
 
-static uint8_t user_connected = 0;       // 用户下位机是否连接
-static uint16_t user_heartbeat_cnt = 0;  // 用户下位机心跳计数
-_to_user_un to_user_data;                // 回传状态数据
-static uint8_t user_ack_buf[32];         // ACK数据
-static queue_t user_ack_queue;           // ACK队列
-static uint16_t user_ack_cnt = 0;        // ACK计数
-uint8_t user_data_temp[128];             // 数据接受缓存
+static uint8_t user_connected = 0;                  // 用户下位机是否连接
+static uint16_t user_heartbeat_cnt = 0;             // 用户下位机心跳计数
+_to_user_un to_user_data __DMA_BUFFER;              // 回传状态数据
+static uint8_t user_ack_buf[32];                    // ACK数据
+static queue_t user_ack_queue;                      // ACK队列
+static uint16_t user_ack_cnt = 0;                   // ACK计数
+static uint8_t pvt_mask = 0;                        // 轨迹点流式执行的电机掩码
+static __IO uint8_t sch_stat_req = SCH_INVALID_ID;  // 待回传统计的任务id
+static __IO uint8_t sch_stat_reset = 0;             // 回传后清除统计
+static uint8_t user_com_evt_id = SCH_INVALID_ID;    // 通讯事件任务id
+static uint32_t user_com_pending = 0;               // 串口忙未能发送的事件
+uint8_t user_data_temp[128] __DMA_BUFFER;           // 数据接受缓存
 
 /**
  * @brief 用户协议数据获取,在串口中断中调用,解析完成后调用UserCom_DataAnl
  * @param  data             数据
  */
-void UserCom_GetOneByte(uint8_t data) {
+__ITCM_CODE void UserCom_GetOneByte(uint8_t data) {
   static uint8_t _user_data_cnt = 0;
   static uint8_t _data_len = 0;
   static uint8_t state = 0;
@@ -70,12 +80,23 @@ void UserCom_GetOneByte(uint8_t data) {
     state = 0;
 }
 
+/**
+ * @brief 检查直流电机掩码选中的电机都已启用
+ * @param  mask             电机掩码, bit0为电机1
+ * @retval uint8_t          1: 通过; 0: 不回复ACK, 上位机重发后报错
+ */
+static uint8_t UserCom_Motor_Mask_Check(uint8_t mask) {
+  if (Motor_Num() > 0 && (mask >> Motor_Num()) == 0) return 1;
+  LOG_E("[COM] dc motor 0x%02x not enabled (%d)", mask, Motor_Num());
+  return 0;
+}
+
 /**
  * @brief 用户命令解析执行,数据接收完成后自动调用
  * @param  data_buf         数据缓存
  * @param  data_len         数据长度
  */
-void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
+__ITCM_CODE void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
   static uint8_t option;
   static uint8_t suboption;
   static uint8_t recv_check;
@@ -89,6 +110,7 @@ void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
   static uint32_t uint32_t_temp;
   __IO static int32_t int32_t_temp;
   __IO static double double_temp;
+  static int64_t int64_t_temp;
   p_data = (uint8_t*)(data_buf + 4);
   option = data_buf[2];
   len = data_buf[3];
@@ -118,6 +140,7 @@ void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
       int32_t_temp = *((int32_t*)(p_data + 1));
       double_temp = (double)(int32_t_temp) / 100.0;
       LOG_D("[COM] set step speed: 0x%02x, %f", uint8_t_temp, double_temp);
+      double_temp = STEP_DEG_TO_PULSE(double_temp);
       if (uint8_t_temp & 0x01) Step_Set_Speed(&step_1, double_temp);
       if (uint8_t_temp & 0x02) Step_Set_Speed(&step_2, double_temp);
       if (uint8_t_temp & 0x04) Step_Set_Speed(&step_3, double_temp);
@@ -128,9 +151,10 @@ void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
       int32_t_temp = *((int32_t*)(p_data + 1));
       double_temp = (double)(int32_t_temp) / 1000.0;
       LOG_D("[COM] set step angle: 0x%02x, %f", uint8_t_temp, double_temp);
-      if (uint8_t_temp & 0x01) Step_Set_Angle(&step_1, double_temp);
-      if (uint8_t_temp & 0x02) Step_Set_Angle(&step_2, double_temp);
-      if (uint8_t_temp & 0x04) Step_Set_Angle(&step_3, double_temp);
+      int64_t_temp = STEP_DEG_TO_POS(double_temp);
+      if (uint8_t_temp & 0x01) Step_Set_Pos(&step_1, int64_t_temp);
+      if (uint8_t_temp & 0x02) Step_Set_Pos(&step_2, int64_t_temp);
+      if (uint8_t_temp & 0x04) Step_Set_Pos(&step_3, int64_t_temp);
       UserCom_SendAck(option, p_data, 5);
       break;
     case 0x03:  // 步进电机相对旋转
@@ -138,9 +162,12 @@ void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
       int32_t_temp = *((int32_t*)(p_data + 1));
       double_temp = (double)(int32_t_temp) / 1000.0;
       LOG_D("[COM] rotate: 0x%02x, %f", uint8_t_temp, double_temp);
-      if (uint8_t_temp & 0x01) Step_Rotate(&step_1, double_temp);
-      if (uint8_t_temp & 0x02) Step_Rotate(&step_2, double_temp);
-      if (uint8_t_temp & 0x04) Step_Rotate(&step_3, double_temp);
+      int64_t_temp = STEP_DEG_TO_POS(double_temp);
+      Step_Group_Begin();  // 多轴同时启动
+      if (uint8_t_temp & 0x01) Step_Rotate(&step_1, int64_t_temp);
+      if (uint8_t_temp & 0x02) Step_Rotate(&step_2, int64_t_temp);
+      if (uint8_t_temp & 0x04) Step_Rotate(&step_3, int64_t_temp);
+      Step_Group_End();
       UserCom_SendAck(option, p_data, 5);
       break;
     case 0x04:  // 步进电机绝对旋转
@@ -148,9 +175,12 @@ void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
       int32_t_temp = *((int32_t*)(p_data + 1));
       double_temp = (double)(int32_t_temp) / 1000.0;
       LOG_D("[COM] rotate abs 0x%02x, %f", uint8_t_temp, double_temp);
-      if (uint8_t_temp & 0x01) Step_Rotate_Abs(&step_1, double_temp);
-      if (uint8_t_temp & 0x02) Step_Rotate_Abs(&step_2, double_temp);
-      if (uint8_t_temp & 0x04) Step_Rotate_Abs(&step_3, double_temp);
+      int64_t_temp = STEP_DEG_TO_POS(double_temp);
+      Step_Group_Begin();  // 多轴同时启动
+      if (uint8_t_temp & 0x01) Step_Rotate_Abs(&step_1, int64_t_temp);
+      if (uint8_t_temp & 0x02) Step_Rotate_Abs(&step_2, int64_t_temp);
+      if (uint8_t_temp & 0x04) Step_Rotate_Abs(&step_3, int64_t_temp);
+      Step_Group_End();
       UserCom_SendAck(option, p_data, 5);
       break;
     case 0x05:  // 步进电机停止
@@ -161,6 +191,204 @@ void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len) {
       if (uint8_t_temp & 0x04) Step_Stop(&step_3);
       UserCom_SendAck(option, p_data, 1);
       break;
+    case 0x06:  // 步进电机加速度设置
+      uint8_t_temp = p_data[0];
+      int32_t_temp = *((int32_t*)(p_data + 1));
+      double_temp = (double)(int32_t_temp) / 100.0;
+      LOG_D("[COM] set step accel: 0x%02x, %f", uint8_t_temp, double_temp);
+      double_temp = STEP_DEG_TO_PULSE(double_temp);
+      if (uint8_t_temp & 0x01) Step_Set_Accel(&step_1, double_temp);
+      if (uint8_t_temp & 0x02) Step_Set_Accel(&step_2, double_temp);
+      if (uint8_t_temp & 0x04) Step_Set_Accel(&step_3, double_temp);
+      UserCom_SendAck(option, p_data, 5);
+      break;
+    case 0x07:  // 步进电机加加速度设置
+      uint8_t_temp = p_data[0];
+      int32_t_temp = *((int32_t*)(p_data + 1));
+      double_temp = (double)(int32_t_temp) / 100.0;
+      LOG_D("[COM] set step jerk: 0x%02x, %f", uint8_t_temp, double_temp);
+      double_temp = STEP_DEG_TO_PULSE(double_temp);
+      if (uint8_t_temp & 0x01) Step_Set_Jerk(&step_1, double_temp);
+      if (uint8_t_temp & 0x02) Step_Set_Jerk(&step_2, double_temp);
+      if (uint8_t_temp & 0x04) Step_Set_Jerk(&step_3, double_temp);
+      UserCom_SendAck(option, p_data, 5);
+      break;
+    case 0x08:  // 多轴直线插补(bit7置位为绝对角度)
+      uint8_t_temp = p_data[0];
+      int32_t_temp = *((int32_t*)(p_data + 1));
+      double_temp = (double)(int32_t_temp) / 100.0;
+      LOG_D("[COM] rotate sync: 0x%02x, %f", uint8_t_temp, double_temp);
+      {
+        static step_ctrl_t* const all_steps[3] = {&step_1, &step_2, &step_3};
+        step_ctrl_t* sync_steps[3];
+        int64_t sync_pulses[3];
+        uint8_t num = 0;
+        for (uint8_t i = 0; i < 3; i++) {
+          if (!(uint8_t_temp & (1 << i))) continue;
+          sync_steps[num] = all_steps[i];
+          int64_t_temp = STEP_DEG_TO_POS(
+              (double)(*((int32_t*)(p_data + 5 + i * 4))) / 1000.0);
+          if (uint8_t_temp & 0x80) int64_t_temp -= all_steps[i]->pos;
+          sync_pulses[num] = int64_t_temp;
+          num++;
+        }
+        if (num > 0)
+          Step_Rotate_Sync(sync_steps, sync_pulses, num,
+                           STEP_DEG_TO_PULSE(double_temp));
+      }
+      UserCom_SendAck(option, p_data, 17);
+      break;
+    case 0x09:  // 运动中修改目标角度和速度(bit6置位为保持目标)
+      uint8_t_temp = p_data[0];
+      int32_t_temp = *((int32_t*)(p_data + 1));
+      double_temp = (double)(*((int32_t*)(p_data + 5))) / 100.0;
+      LOG_D("[COM] retarget 0x%02x, %d, %f", uint8_t_temp, int32_t_temp,
+            double_temp);
+      {
+        static step_ctrl_t* const all_steps[3] = {&step_1, &step_2, &step_3};
+        for (uint8_t i = 0; i < 3; i++) {
+          if (!(uint8_t_temp & (1 << i))) continue;
+          int64_t_temp = uint8_t_temp & 0x40
+                             ? all_steps[i]->posTarget
+                             : STEP_DEG_TO_POS((double)int32_t_temp / 1000.0);
+          Step_Retarget(all_steps[i], int64_t_temp,
+                        STEP_DEG_TO_PULSE(double_temp));
+        }
+      }
+      UserCom_SendAck(option, p_data, 9);
+      break;
+    case 0x0A:  // 步进电机连续速度模式(符号为方向, 0为减速停止)
+      uint8_t_temp = p_data[0];
+      int32_t_temp = *((int32_t*)(p_data + 1));
+      double_temp = (double)(int32_t_temp) / 100.0;
+      LOG_D("[COM] jog 0x%02x, %f", uint8_t_temp, double_temp);
+      double_temp = STEP_DEG_TO_PULSE(double_temp);
+      if (uint8_t_temp & 0x01) Step_Jog(&step_1, double_temp);
+      if (uint8_t_temp & 0x02) Step_Jog(&step_2, double_temp);
+      if (uint8_t_temp & 0x04) Step_Jog(&step_3, double_temp);
+      UserCom_SendAck(option, p_data, 5);
+      break;
+    case 0x0B:  // 轨迹点流式执行控制(1:开始, 2:结束, 0:中止)
+      uint8_t_temp = p_data[0];
+      LOG_D("[COM] pvt 0x%02x, %d", uint8_t_temp, p_data[1]);
+      if (p_data[1] == 0x01) {
+        static step_ctrl_t* const all_steps[3] = {&step_1, &step_2, &step_3};
+        step_ctrl_t* pvt_list[3];
+        uint8_t num = 0;
+        for (uint8_t i = 0; i < 3; i++) {
+          if (uint8_t_temp & (1 << i)) pvt_list[num++] = all_steps[i];
+        }
+        pvt_mask = uint8_t_temp;
+        PVT_Begin(pvt_list, num);
+      } else if (p_data[1] == 0x02) {
+        PVT_End();
+      } else {
+        PVT_Abort();
+      }
+      UserCom_SendAck(option, p_data, 2);
+      break;
+    case 0x0C:  // 轨迹点(不回复ACK, 缓冲状态通过实时数据回传)
+      uint8_t_temp = p_data[0];
+      if (uint8_t_temp > PVT_MAX_PER_FRAME) uint8_t_temp = PVT_MAX_PER_FRAME;
+      if (len < 1 + uint8_t_temp * 29) {  // 不使用缓存中上一帧残留的数据
+        LOG_E("[COM] pvt frame too short: %d", len);
+        break;
+      }
+      for (uint8_t k = 0; k < uint8_t_temp; k++) {
+        static pvt_point_t point;
+        uint8_t* p_point = p_data + 1 + k * 29;
+        uint8_t num = 0;
+        point.time = *((uint32_t*)p_point);
+        point.hasVel = p_point[4] & 0x01;
+        for (uint8_t i = 0; i < 3; i++) {
+          if (!(pvt_mask & (1 << i))) continue;
+          point.pos[num] = STEP_DEG_TO_POS(
+              (double)(*((int32_t*)(p_point + 5 + i * 4))) / 1000.0);
+          point.vel[num] = STEP_DEG_TO_PULSE(
+              (double)(*((int32_t*)(p_point + 17 + i * 4))) / 100.0);
+          num++;
+        }
+        if (!PVT_Push(&point)) LOG_W("[COM] pvt point dropped");
+      }
+      break;
+    case 0x0D:  // 步进电机减速停止/暂停/恢复/急停
+      uint8_t_temp = p_data[0];
+      int32_t_temp = *((int32_t*)(p_data + 2));
+      LOG_D("[COM] halt 0x%02x, %d, %d", uint8_t_temp, p_data[1],
+            int32_t_temp);
+      if (p_data[1] == 0x03) {
+        Step_EStop();
+      } else {
+        static step_ctrl_t* const all_steps[3] = {&step_1, &step_2, &step_3};
+        for (uint8_t i = 0; i < 3; i++) {
+          if (!(uint8_t_temp & (1 << i))) continue;
+          if (p_data[1] == 0x00)
+            Step_Stop_Ramp(all_steps[i], STEP_DEG_TO_POS(fabs(
+                                             (double)int32_t_temp / 1000.0)));
+          else if (p_data[1] == 0x01)
+            Step_Pause(all_steps[i]);
+          else if (p_data[1] == 0x02)
+            Step_Resume(all_steps[i]);
+        }
+      }
+      UserCom_SendAck(option, p_data, 6);
+      break;
+    case 0x0E:  // 直流电机目标设置(0:速度环 rpm, 1:位置环 角度)
+      uint8_t_temp = p_data[0];
+      int32_t_temp = *((int32_t*)(p_data + 2));
+      LOG_D("[COM] dc target 0x%02x, %d, %d", uint8_t_temp, p_data[1],
+            int32_t_temp);
+      if (!UserCom_Motor_Mask_Check(uint8_t_temp)) break;
+      for (uint8_t i = 0; i < Motor_Num(); i++) {
+        if (!(uint8_t_temp & (1 << i))) continue;
+        if (p_data[1] == 0x00)
+          Motor_Set_Speed(Motor_Get(i), (double)int32_t_temp / 100.0);
+        else
+          Motor_Set_Position(Motor_Get(i), (double)int32_t_temp / 1000.0 *
+                                               PULSE_PER_ROTATION / 360.0);
+      }
+      UserCom_SendAck(option, p_data, 6);
+      break;
+    case 0x0F:  // 直流电机PID参数设置(0:速度环, 1:位置环)
+      uint8_t_temp = p_data[0];
+      LOG_D("[COM] dc gains 0x%02x, %d", uint8_t_temp, p_data[1]);
+      if (!UserCom_Motor_Mask_Check(uint8_t_temp)) break;
+      for (uint8_t i = 0; i < Motor_Num(); i++) {
+        if (!(uint8_t_temp & (1 << i))) continue;
+        Motor_Set_Gains(Motor_Get(i),
+                        p_data[1] ? MOTOR_TUNE_POS : MOTOR_TUNE_SPD,
+                        (double)(*((int32_t*)(p_data + 2))) / 1000000.0,
+                        (double)(*((int32_t*)(p_data + 6))) / 1000000.0,
+                        (double)(*((int32_t*)(p_data + 10))) / 1000000.0);
+      }
+      UserCom_SendAck(option, p_data, 14);
+      break;
+    case 0x10:  // 直流电机自整定(0:中止, 1:速度环, 2:位置环)
+      uint8_t_temp = p_data[0];
+      // 速度环: 幅值为占空比, 滞环为rpm; 位置环: 幅值为rpm, 滞环为角度
+      double_temp = (double)(*((int32_t*)(p_data + 6))) / 100.0;
+      if (p_data[1] == 0x02) double_temp *= PULSE_PER_ROTATION / 360.0;
+      LOG_D("[COM] dc autotune 0x%02x, %d", uint8_t_temp, p_data[1]);
+      if (!UserCom_Motor_Mask_Check(uint8_t_temp)) break;
+      for (uint8_t i = 0; i < Motor_Num(); i++) {
+        if (!(uint8_t_temp & (1 << i))) continue;
+        if (p_data[1] == 0x00)
+          Motor_Autotune_Stop(Motor_Get(i));
+        else
+          Motor_Autotune_Start(
+              Motor_Get(i), p_data[1] == 0x01 ? MOTOR_TUNE_SPD : MOTOR_TUNE_POS,
+              (double)(*((int32_t*)(p_data + 2))) / 100.0, double_temp,
+              p_data[10]);
+      }
+      UserCom_SendAck(option, p_data, 11);
+      break;
+    case 0x11:  // 调度器任务统计查询(bit0: 回传后清除统计)
+      LOG_D("[COM] sch stat %d, 0x%02x", p_data[0], p_data[1]);
+      sch_stat_reset = p_data[1] & 0x01;
+      sch_stat_req = p_data[0];  // 在事件任务中回传, 避免与调度器竞争
+      UserCom_Post(USER_COM_EVT_SCH);
+      UserCom_SendAck(option, p_data, 2);
+      break;
     default:
       LOG_E("[COM] unknown option: 0x%02x", option);
       break;
@@ -175,6 +403,43 @@ void UserCom_SendAck(uint8_t option, uint8_t* data_p, uint8_t data_len) {
   }
   ENQUEUE(&user_ack_queue, &ack_data, 1, uint8_t);
   user_ack_cnt++;
+  UserCom_Post(USER_COM_EVT_ACK);
+}
+
+/**
+ * @brief 初始化用户通讯, 注册通讯事件任务
+ */
+void UserCom_Init(void) {
+  QUEUE_INIT(&user_ack_queue, user_ack_buf, 32);
+  user_com_evt_id = Add_SchEvent(UserCom_Event_Task, SCH_PRIO_BG, 0);
+}
+
+/**
+ * @brief 唤醒通讯事件任务, 可在中断中调用
+ * @param  events           USER_COM_EVT_xxx
+ */
+void UserCom_Post(uint32_t events) { Sch_Post(user_com_evt_id, events); }
+
+/**
+ * @brief 通讯事件任务, 发送ACK/用户事件/调度器统计, 串口忙时留待发送完成后重试
+ * @param  events           USER_COM_EVT_xxx
+ */
+void UserCom_Event_Task(uint32_t events) {
+  uint32_t pending = user_com_pending | events;
+  if ((pending & USER_COM_EVT_ACK) && UserCom_CheckAck()) {
+    pending &= ~USER_COM_EVT_ACK;
+  }
+  for (uint8_t event = 1; event <= USER_EVENT_NUM; event++) {
+    if ((pending & USER_COM_EVT_USER(event)) &&
+        UserCom_SendEvent(event, USER_EVENT_OP_SET)) {
+      pending &= ~USER_COM_EVT_USER(event);
+    }
+  }
+  if (sch_stat_req != SCH_INVALID_ID && UserCom_SendSchStat(sch_stat_req)) {
+    if (sch_stat_reset) Sch_Reset_Stat(sch_stat_req);
+    sch_stat_req = SCH_INVALID_ID;
+  }
+  user_com_pending = pending & ~(USER_COM_EVT_TX | USER_COM_EVT_SCH);
 }
 
 /**
@@ -184,12 +449,6 @@ void UserCom_SendAck(uint8_t option, uint8_t* data_p, uint8_t data_len) {
 void UserCom_Task() {
   const float dT_s = 0.01f;
   static uint16_t data_exchange_cnt = 0;
-  static uint8_t ack_queue_inited = 0;
-
-  if (!ack_queue_inited) {
-    ack_queue_inited = 1;
-    QUEUE_INIT(&user_ack_queue, user_ack_buf, 32);
-  }
 
   if (user_connected) {
     // 心跳超时检查
@@ -200,9 +459,6 @@ void UserCom_Task() {
       LOG_W("[COM] disconnected");
     }
 
-    // ACK发送检查
-    UserCom_CheckAck();
-
     // 数据交换
     data_exchange_cnt++;
     if (data_exchange_cnt * dT_s >= USER_DATA_EXCHANGE_TIMEOUT_S) {
@@ -219,6 +475,7 @@ void UserCom_DataExchange(void) {
   static uint8_t test_data = 0;
   test_data++;
   static uint8_t user_data_size = sizeof(to_user_data.byte_data);
+  uint32_t wcet, overrun, skew;
 
   // 初始化数据
   to_user_data.st_data.head1 = 0xAA;
@@ -227,23 +484,68 @@ void UserCom_DataExchange(void) {
   to_user_data.st_data.cmd = 0x01;
 
   // 数据赋值
-  to_user_data.st_data.step1_speed = step_1.speed * 100;
-  to_user_data.st_data.step1_angle = Step_Get_Angle(&step_1) * 1000;
-  to_user_data.st_data.step1_target_angle = step_1.angleTarget * 1000;
+  to_user_data.st_data.step1_speed =
+      STEP_POS_TO_DEG(Step_Get_Speed(&step_1)) * 100;
+  to_user_data.st_data.step1_angle =
+      STEP_POS_TO_DEG(Step_Get_Pos(&step_1)) * 1000;
+  to_user_data.st_data.step1_target_angle =
+      STEP_POS_TO_DEG(step_1.posTarget) * 1000;
   to_user_data.st_data.step1_rotating = step_1.rotating;
   to_user_data.st_data.step1_dir = step_1.dir;
+  to_user_data.st_data.step1_queue = Step_Queue_Depth(&step_1);
+  to_user_data.st_data.step1_planned = Step_Queue_Planned(&step_1);
+  to_user_data.st_data.step1_freq = Step_Get_Speed(&step_1) * 1000;
+  to_user_data.st_data.step1_freq_set = step_1.speedSet * 1000;
 
-  to_user_data.st_data.step2_speed = step_2.speed * 100;
-  to_user_data.st_data.step2_angle = Step_Get_Angle(&step_2) * 1000;
-  to_user_data.st_data.step2_target_angle = step_2.angleTarget * 1000;
+  to_user_data.st_data.step2_speed =
+      STEP_POS_TO_DEG(Step_Get_Speed(&step_2)) * 100;
+  to_user_data.st_data.step2_angle =
+      STEP_POS_TO_DEG(Step_Get_Pos(&step_2)) * 1000;
+  to_user_data.st_data.step2_target_angle =
+      STEP_POS_TO_DEG(step_2.posTarget) * 1000;
   to_user_data.st_data.step2_rotating = step_2.rotating;
   to_user_data.st_data.step2_dir = step_2.dir;
+  to_user_data.st_data.step2_queue = Step_Queue_Depth(&step_2);
+  to_user_data.st_data.step2_planned = Step_Queue_Planned(&step_2);
+  to_user_data.st_data.step2_freq = Step_Get_Speed(&step_2) * 1000;
+  to_user_data.st_data.step2_freq_set = step_2.speedSet * 1000;
 
-  to_user_data.st_data.step3_speed = step_3.speed * 100;
-  to_user_data.st_data.step3_angle = Step_Get_Angle(&step_3) * 1000;
-  to_user_data.st_data.step3_target_angle = step_3.angleTarget * 1000;
+  to_user_data.st_data.step3_speed =
+      STEP_POS_TO_DEG(Step_Get_Speed(&step_3)) * 100;
+  to_user_data.st_data.step3_angle =
+      STEP_POS_TO_DEG(Step_Get_Pos(&step_3)) * 1000;
+  to_user_data.st_data.step3_target_angle =
+      STEP_POS_TO_DEG(step_3.posTarget) * 1000;
   to_user_data.st_data.step3_rotating = step_3.rotating;
   to_user_data.st_data.step3_dir = step_3.dir;
+  to_user_data.st_data.step3_queue = Step_Queue_Depth(&step_3);
+  to_user_data.st_data.step3_planned = Step_Queue_Planned(&step_3);
+  to_user_data.st_data.step3_freq = Step_Get_Speed(&step_3) * 1000;
+  to_user_data.st_data.step3_freq_set = step_3.speedSet * 1000;
+
+  skew = Step_Get_Sync_Skew();
+  to_user_data.st_data.sync_skew = skew > 0xFFFF ? 0xFFFF : skew;
+  to_user_data.st_data.pvt_depth = PVT_Depth();
+  to_user_data.st_data.pvt_underrun = PVT_Underrun();
+
+  for (uint8_t i = 0; i < 2; i++) {
+    _to_user_dc_st* dc = &to_user_data.st_data.dc[i];
+    motor_t* motor = Motor_Get(i);
+    if (motor == NULL) {
+      *dc = (_to_user_dc_st){0};
+      continue;
+    }
+    dc->speed = motor->speed * 100;
+    dc->angle = motor->pos * 360.0 / PULSE_PER_ROTATION * 1000;
+    dc->duty = motor->pwmDuty * 100;
+    dc->mode = motor->posEnable;
+    dc->tune = motor->tune.state;
+  }
+  Motor_Get_Loop_Stat(&wcet, &overrun);
+  to_user_data.st_data.motor_loop_wcet = wcet > 0xFFFF ? 0xFFFF : wcet;
+  to_user_data.st_data.motor_loop_overrun =
+      overrun > 0xFFFF ? 0xFFFF : overrun;
+  to_user_data.st_data.cpu_load = Sch_Get_Load();
 
   // 校验和
   to_user_data.st_data.check_sum = 0;
@@ -254,13 +556,23 @@ void UserCom_DataExchange(void) {
   UserCom_SendData(to_user_data.byte_data, user_data_size);
 }
 
-static uint8_t data_to_send[12];
+static uint8_t data_to_send[12] __DMA_BUFFER;
+
+/**
+ * @brief 串口是否空闲, 忙时不可改写正在发送的缓冲区
+ */
+static inline uint8_t UserCom_TxReady(void) {
+  return USER_COM_UART.gState == HAL_UART_STATE_READY &&
+         USER_COM_UART.hdmatx->State == HAL_DMA_STATE_READY;
+}
 
 /**
  * @brief 检查ACK队列并发送
+ * @retval uint8_t          1: 已全部发送, 0: 串口忙
  */
-void UserCom_CheckAck() {
+uint8_t UserCom_CheckAck() {
   while (user_ack_cnt) {
+    if (!UserCom_TxReady()) return 0;
     data_to_send[0] = 0xAA;  // head1
     data_to_send[1] = 0x55;  // head2
     data_to_send[2] = 0x02;  // length
@@ -272,16 +584,19 @@ void UserCom_CheckAck() {
       data_to_send[5] += data_to_send[i];
     }
     UserCom_SendData(data_to_send, 6);
-    user_ack_cnt--;
+    SAFE_ATOM_CODE { user_ack_cnt--; }  // 串口中断中会递增
   }
+  return 1;
 }
 
 /**
  * @brief 发送事件
  * @param  event            事件代码
  * @param  op               操作代码
+ * @retval uint8_t          1: 已发送, 0: 串口忙
  */
-void UserCom_SendEvent(uint8_t event, uint8_t op) {
+uint8_t UserCom_SendEvent(uint8_t event, uint8_t op) {
+  if (!UserCom_TxReady()) return 0;
   data_to_send[0] = 0xAA;   // head1
   data_to_send[1] = 0x55;   // head2
   data_to_send[2] = 0x03;   // length
@@ -292,16 +607,57 @@ void UserCom_SendEvent(uint8_t event, uint8_t op) {
   for (uint8_t i = 0; i < 6; i++) {
     data_to_send[6] += data_to_send[i];
   }
-  UserCom_SendData(data_to_send, 7);
+  return UserCom_SendData(data_to_send, 7);
+}
+
+static _to_user_sch_un to_user_sch __DMA_BUFFER;  // 调度器统计回传
+
+/**
+ * @brief 发送调度器任务统计
+ * @param  taskId           任务id, 不存在时state为0
+ * @retval uint8_t          1: 已发送, 0: 串口忙
+ */
+uint8_t UserCom_SendSchStat(uint8_t taskId) {
+  _to_user_sch_st* st = &to_user_sch.st_data;
+  scheduler_task_t info;
+  if (!UserCom_TxReady()) return 0;
+  to_user_sch = (_to_user_sch_un){0};
+  st->head1 = 0xAA;
+  st->head2 = 0x55;
+  st->length = sizeof(to_user_sch.byte_data) - 4;
+  st->cmd = 0x04;
+  st->id = taskId;
+  st->max_task = SCH_MAX_TASK;
+  st->cpu_load = Sch_Get_Load();
+  st->core_clock = SystemCoreClock;
+  if (Sch_Get_Stat(taskId, &info)) {
+    st->state = 0x01 | (info.enable << 1);
+    st->rate = info.rateHz * 1000;
+    st->run_cnt = info.stat.runCnt;
+    if (info.stat.runCnt) {
+      st->min_cyc = info.stat.minCyc;
+      st->avg_cyc = info.stat.sumCyc / info.stat.runCnt;
+    }
+    st->max_cyc = info.stat.maxCyc;
+    st->max_late = info.stat.maxLateCyc;
+    st->overrun = info.stat.overrun;
+    st->load = Sch_Get_Task_Load(taskId);
+  }
+  for (uint8_t i = 0; i < sizeof(to_user_sch.byte_data) - 1; i++) {
+    st->check_sum += to_user_sch.byte_data[i];
+  }
+  return UserCom_SendData(to_user_sch.byte_data, sizeof(to_user_sch.byte_data));
 }
 
 /**
  * @brief 用户通讯数据发送
+ * @retval uint8_t          1: 已开始发送, 0: 串口忙
  */
-void UserCom_SendData(uint8_t* dataToSend, uint8_t Length) {
+uint8_t UserCom_SendData(uint8_t* dataToSend, uint8_t Length) {
   // HAL_UART_Transmit_IT(&USER_COM_UART, dataToSend, Length);
   // DMA
-  if (USER_COM_UART.gState == HAL_UART_STATE_READY &&
-      USER_COM_UART.hdmatx->State == HAL_DMA_STATE_READY)
-    HAL_UART_Transmit_DMA(&USER_COM_UART, dataToSend, Length);
+  if (UserCom_TxReady())
+    return HAL_UART_Transmit_DMA(&USER_COM_UART, dataToSend, Length) ==
+           HAL_OK;
+  return 0;
 }
@@ -22,12 +22,32 @@
 #define USER_EVENT_KEY_SHORT 0x01
 #define USER_EVENT_KEY_LONG 0x02
 #define USER_EVENT_KEY_DOUBLE 0x03
+#define USER_EVENT_STEP1_DONE 0x04  // 步进电机运动完成, 依次为STEP1~3
+#define USER_EVENT_STEP2_DONE 0x05
+#define USER_EVENT_STEP3_DONE 0x06
+#define USER_EVENT_NUM 0x06
 // 事件操作
 #define USER_EVENT_OP_SET 0x01
 #define USER_EVENT_OP_CLEAR 0x02
 
+// 通讯事件任务的事件位, 由UserCom_Post投递
+#define USER_COM_EVT_ACK (1UL << 0)  // 有待发送的ACK
+#define USER_COM_EVT_TX (1UL << 1)   // 串口发送完成, 重试未能发送的数据
+#define USER_COM_EVT_SCH (1UL << 2)  // 调度器统计查询
+// 发送用户事件(USER_EVENT_xxx)
+#define USER_COM_EVT_USER(_EVENT) (1UL << (8 + (_EVENT)))
+
 extern uint8_t user_data_temp[128];
 
+// 直流电机回传数据
+typedef struct {
+  int32_t speed;  // rpm * 100
+  int32_t angle;  // deg * 1000
+  int16_t duty;   // % * 100
+  uint8_t mode;   // 0:速度环 1:位置环
+  uint8_t tune;   // 自整定状态
+} __attribute__((__packed__)) _to_user_dc_st;
+
 // 回传数据结构
 typedef struct {
   uint8_t head1;
@@ -41,33 +61,86 @@ typedef struct {
   int32_t step1_target_angle;
   uint8_t step1_rotating;
   uint8_t step1_dir;
+  uint8_t step1_queue;
+  uint8_t step1_planned;
+  uint32_t step1_freq;
+  uint32_t step1_freq_set;
 
   int32_t step2_speed;
   int32_t step2_angle;
   int32_t step2_target_angle;
   uint8_t step2_rotating;
   uint8_t step2_dir;
+  uint8_t step2_queue;
+  uint8_t step2_planned;
+  uint32_t step2_freq;
+  uint32_t step2_freq_set;
 
   int32_t step3_speed;
   int32_t step3_angle;
   int32_t step3_target_angle;
   uint8_t step3_rotating;
   uint8_t step3_dir;
-  //
+  uint8_t step3_queue;
+  uint8_t step3_planned;
+  uint32_t step3_freq;
+  uint32_t step3_freq_set;
+
+  uint16_t sync_skew;  // ns, 超过0xFFFF时为0xFFFF
+  uint8_t pvt_depth;
+  uint16_t pvt_underrun;
+
+  _to_user_dc_st dc[2];
+  uint16_t motor_loop_wcet;     // ns
+  uint16_t motor_loop_overrun;  //
+  uint16_t cpu_load;            // % * 100
   uint8_t check_sum;
 } __attribute__((__packed__)) _to_user_st;
 
 typedef union {
-  uint8_t byte_data[47];
+  uint8_t byte_data[sizeof(_to_user_st)];
   _to_user_st st_data;
 } _to_user_un;
 
+// 调度器任务统计回传结构
+typedef struct {
+  uint8_t head1;
+  uint8_t head2;
+  uint8_t length;
+  //
+  uint8_t cmd;
+  // data
+  uint8_t id;           // 任务id
+  uint8_t state;        // bit0:存在 bit1:使能
+  uint8_t max_task;     // 任务池容量
+  uint32_t rate;        // mHz
+  uint32_t run_cnt;     // 运行次数
+  uint32_t min_cyc;     // 最短执行时间, cycles
+  uint32_t avg_cyc;     // 平均执行时间, cycles
+  uint32_t max_cyc;     // 最长执行时间, cycles
+  uint32_t max_late;    // 最大启动抖动, cycles
+  uint32_t overrun;     // 超时次数
+  uint16_t load;        // 任务CPU占用率, % * 100
+  uint16_t cpu_load;    // 总CPU占用率, % * 100
+  uint32_t core_clock;  // Hz
+  uint8_t check_sum;
+} __attribute__((__packed__)) _to_user_sch_st;
+
+typedef union {
+  uint8_t byte_data[sizeof(_to_user_sch_st)];
+  _to_user_sch_st st_data;
+} _to_user_sch_un;
+
 void UserCom_DataAnl(uint8_t* data_buf, uint8_t data_len);
 
 void UserCom_GetOneByte(uint8_t data);
 
 void UserCom_Task();
 
-void UserCom_SendEvent(uint8_t event, uint8_t op);
+void UserCom_Init(void);
+
+void UserCom_Post(uint32_t events);
+
+uint8_t UserCom_SendEvent(uint8_t event, uint8_t op);
 
 #endif  // __APP_H__
@@ -94,6 +94,20 @@ void RGB(uint8_t r, uint8_t g, uint8_t b);
         }),                                            \
         __set_PRIMASK(SAFE_NAME(temp)))
 
+// 存储区域放置, 执行区域见 MDK-ARM/H750_STEP.sct
+// ITCM: 零等待取指; DTCM: 零等待读写, 但DMA1/2无法访问;
+// DMA缓冲区: AXI SRAM末尾64KB, 由MPU设为不可缓存, 无需维护D-Cache
+#if defined(__CC_ARM)
+#define __ITCM_CODE __attribute__((section(".itcm_code")))
+#define __DTCM_DATA __attribute__((section(".dtcm_data"), zero_init))
+#define __DMA_BUFFER \
+  __attribute__((section(".dma_buffer"), zero_init, aligned(32)))
+#else
+#define __ITCM_CODE __attribute__((section(".itcm_code")))
+#define __DTCM_DATA __attribute__((section(".dtcm_data")))
+#define __DMA_BUFFER __attribute__((section(".dma_buffer"), aligned(32)))
+#endif
+
 #define __size_of_array(__array) \
   _Generic((__array), char * : sizeof(*(__array)), default : sizeof(__array))
 #define __dim_of_1(__array) (sizeof(__array) / sizeof((__array[0]))
@@ -13,6 +13,16 @@
 #include "motor.h"
 
 #include "candy.h"
+#include "uart_pack.h"
+
+static motor_t *motor_list[MOTOR_MAX_NUM];        // 控制环中的电机
+static uint8_t motor_num = 0;                     // 控制环电机数量
+static TIM_HandleTypeDef *motor_loop_tim = NULL;  // 控制环定时器
+static uint32_t motor_loop_last_cyc = 0;          // 上次进入控制环的DWT周期计数
+static uint32_t motor_loop_period_cyc = 0;        // 控制环名义周期, CPU周期
+static uint32_t motor_loop_wcet_cyc = 0;          // 控制环最长执行时间, CPU周期
+static uint32_t motor_loop_overrun = 0;           // 控制环超时/丢失周期次数
+
 /****************** Position PID Functions ******************/
 
 /**
@@ -38,10 +48,8 @@ void Pos_PID_Param_Init(pos_pid_t *PIDx) {
  * @retval double           PID output
  */
 double Pos_PID_Calc(pos_pid_t *PIDx, int32_t nextPoint) {
-  static int32_t error_0 = 0;
-  static double output = 0;
-  output = 0;
-  error_0 = PIDx->setPoint - nextPoint;
+  int32_t error_0 = PIDx->setPoint - nextPoint;
+  double output = 0;
   /* Dead band */
   if (error_0 > PIDx->deadBand || error_0 < -PIDx->deadBand) {
     /* Proportion */
@@ -93,10 +101,8 @@ void Spd_PID_Param_Init(spd_pid_t *PIDx) {
  * @retval double           PID output
  */
 double Spd_PID_Calc(spd_pid_t *PIDx, double nextPoint) {
-  static double error_0 = 0;
-  static double output = 0;
-  output = 0;
-  error_0 = PIDx->setPoint - nextPoint;
+  double error_0 = PIDx->setPoint - nextPoint;
+  double output = 0;
   /* Dead band */
   if (error_0 < PIDx->deadBand && error_0 > -PIDx->deadBand) {
     error_0 = 0;
@@ -172,20 +178,30 @@ double Inc_PID_Calc(inc_pid_t *PIDx, double nextPoint) {
 void Motor_Setup(motor_t *motor, TIM_HandleTypeDef *timEncoder,
                  TIM_HandleTypeDef *timPWM, uint32_t forwardChannel,
                  uint32_t reverseChannel) {
-  Pos_PID_Param_Init(&motor->posPID);
-  motor->posPID.setPoint = 0;
-  Spd_PID_Param_Init(&motor->spdPID);
+  // Gains were tuned per call, convert I/D terms to per second
+  PID_F32_Init(&motor->posPID, POS_KP, POS_KI * MOTOR_PID_TUNE_FREQ,
+               POS_KD / MOTOR_PID_TUNE_FREQ, -POS_INIT_TARGET_SPEED,
+               POS_INIT_TARGET_SPEED);
+  PID_F32_Init(&motor->spdPID, SPD_KP, SPD_KI * MOTOR_PID_TUNE_FREQ,
+               SPD_KD / MOTOR_PID_TUNE_FREQ, -100, 100);
+  motor->spdSet = SPD_INIT_TARGET;
+  motor->posSet = POS_INIT_TARGET;
+  motor->posEnable = 0;
   motor->timEncoder = timEncoder;
   motor->timPWM = timPWM;
   motor->forwardChannel = forwardChannel;
   motor->reverseChannel = reverseChannel;
   motor->posTargetSpd = POS_INIT_TARGET_SPEED;
   motor->pwmDuty = 0;
+  motor->pidOut = 0;
+  motor->tune.state = MOTOR_TUNE_IDLE;
   motor->speed = 0;
   motor->pos = 0;
   motor->lastPos = 0;
+  motor->timCapture = NULL;
+  motor->edgeValid = 0;
   HAL_TIM_Encoder_Start(timEncoder, TIM_CHANNEL_ALL);
-  __HAL_TIM_SET_COUNTER(timEncoder, ENCODER_MID_VALUE);
+  motor->encLast = __HAL_TIM_GET_COUNTER(timEncoder);
   __HAL_TIM_SET_PRESCALER(timPWM,
                           (SYSTEM_CLOCK_FREQ_HZ / 1000 / MOTOR_PWM_FREQ) - 1);
   __HAL_TIM_SET_AUTORELOAD(timPWM, 1000 - 1);
@@ -195,44 +211,144 @@ void Motor_Setup(motor_t *motor, TIM_HandleTypeDef *timEncoder,
   HAL_TIM_PWM_Start(timPWM, reverseChannel);
 }
 
+/**
+ * @brief Enable M/T speed measurement with an input capture timer
+ * @param  motor            Target
+ * @param  timCapture       Free-running timer capturing encoder edges
+ * @param  captureChannel   Capture channel, configured for the same edges
+ *                          the encoder counts (e.g. TI1 both edges in x2 mode)
+ * @param  captureClk       Counting frequency of timCapture, Hz
+ */
+void Motor_Setup_Capture(motor_t *motor, TIM_HandleTypeDef *timCapture,
+                         uint32_t captureChannel, double captureClk) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  motor->captureChannel = captureChannel;
+  motor->captureClk = captureClk;
+  motor->edgeValid = 0;
+  HAL_TIM_IC_Start(timCapture, captureChannel);
+  motor->timCapture = timCapture;
+}
+
+/**
+ * @brief Encoder count difference, aware of counter wrap
+ */
+static inline int32_t Motor_Encoder_Delta(uint32_t now, uint32_t last) {
+#if ENCODER_TIM_PERIOD == 65535
+  return (int16_t)(now - last);
+#else
+  return (int32_t)(now - last);
+#endif
+}
+
 /**
  * @brief Get motor speed and position
  * @param  motor            Target
  * @param  runTimeHz        How fast this function is called
+ * @note The encoder counter runs freely and is never written. With a capture
+ * timer the speed is M/T: counted edges divided by the time between the last
+ * edges of two samples; without edges the speed decays to the bound given by
+ * the time since the last edge. Otherwise edges per period (M method).
  */
 void Motor_Update_Speed(motor_t *motor, double runTimeHz) {
-  static double speed = 0;
-  motor->pos +=
-      (int32_t)__HAL_TIM_GET_COUNTER(motor->timEncoder) - ENCODER_MID_VALUE;
-  __HAL_TIM_SET_COUNTER(motor->timEncoder, ENCODER_MID_VALUE);
-  speed = (double)(motor->pos - motor->lastPos) * 60.0 * runTimeHz /
-          PULSE_PER_ROTATION;
+  uint32_t cnt, ccr, capCnt, age, edge, now;
+  int32_t delta;
+  double speed, since, bound;
+  if (motor->timCapture == NULL) {
+    cnt = __HAL_TIM_GET_COUNTER(motor->timEncoder);
+    delta = Motor_Encoder_Delta(cnt, motor->encLast);
+    motor->encLast = cnt;
+    motor->pos += delta;
+    motor->lastPos = motor->pos;
+    speed = delta * 60.0 * runTimeHz / PULSE_PER_ROTATION;
+    motor->speed += (speed - motor->speed) * SPEED_FILTER;
+    return;
+  }
+  // Count and capture must describe the same edge, retry if one lands between
+  do {
+    ccr = HAL_TIM_ReadCapturedValue(motor->timCapture, motor->captureChannel);
+    cnt = __HAL_TIM_GET_COUNTER(motor->timEncoder);
+    capCnt = __HAL_TIM_GET_COUNTER(motor->timCapture);
+    now = DWT->CYCCNT;
+  } while (ccr !=
+           HAL_TIM_ReadCapturedValue(motor->timCapture, motor->captureChannel));
+  delta = Motor_Encoder_Delta(cnt, motor->encLast);
+  motor->encLast = cnt;
+  motor->pos += delta;
   motor->lastPos = motor->pos;
-  motor->speed += (speed - motor->speed) * SPEED_FILTER;
+  speed = motor->speed;
+  if (delta != 0) {
+    age = capCnt >= ccr ? capCnt - ccr
+                        : capCnt + __HAL_TIM_GET_AUTORELOAD(motor->timCapture) +
+                              1 - ccr;
+    edge = now - (uint32_t)(age * (SystemCoreClock / motor->captureClk));
+    since = (uint32_t)(edge - motor->lastEdgeCyc) / (double)SystemCoreClock;
+    if (motor->edgeValid && since > 0 && since < MOTOR_MT_TIMEOUT) {
+      speed = delta * 60.0 / (since * PULSE_PER_ROTATION);
+    } else {  // First edge after standstill
+      speed = delta * 60.0 * runTimeHz / PULSE_PER_ROTATION;
+    }
+    motor->lastEdgeCyc = edge;
+    motor->edgeValid = 1;
+  } else if (motor->edgeValid) {
+    since = (uint32_t)(now - motor->lastEdgeCyc) / (double)SystemCoreClock;
+    if (since >= MOTOR_MT_TIMEOUT) {
+      speed = 0;
+      motor->edgeValid = 0;
+    } else {  // Next edge is at least this far away
+      bound = 60.0 / (since * PULSE_PER_ROTATION);
+      if (speed > bound) speed = bound;
+      if (speed < -bound) speed = -bound;
+    }
+  } else {
+    speed = 0;
+  }
+  motor->speed = speed;
 }
 
 /**
  * @brief Calculate motor position PID, will set speed PID setpoint!
  * @param  motor            Target
+ * @param  dt               Time since last call, s
  */
-void Motor_Pos_PID_Run(motor_t *motor) {
-  double tempSpeed = Pos_PID_Calc(&motor->posPID, motor->pos);
-  // Set target speed
-  if (tempSpeed > motor->posTargetSpd) {
-    tempSpeed = motor->posTargetSpd;
-  } else if (tempSpeed < -motor->posTargetSpd) {
-    tempSpeed = -motor->posTargetSpd;
+void Motor_Pos_PID_Run(motor_t *motor, double dt) {
+  int32_t meas = motor->pos;
+  // Dead band
+  if (meas - motor->posSet <= POS_DEAD_BAND &&
+      motor->posSet - meas <= POS_DEAD_BAND) {
+    meas = motor->posSet;
   }
-  motor->spdPID.setPoint = tempSpeed;
+  // Set target speed, clamped by posTargetSpd
+  motor->posPID.outMax = motor->posTargetSpd;
+  motor->posPID.outMin = -motor->posTargetSpd;
+  motor->spdSet = PID_F32_Update(&motor->posPID, motor->posSet, meas, dt);
 }
 
 /**
  * @brief Calculate motor speed PID, will change motor speed!
  * @param  motor            Target
+ * @param  dt               Time since last call, s
+ */
+void Motor_Spd_PID_Run(motor_t *motor, double dt) {
+  double meas = motor->speed;
+  // Dead band
+  if (meas - motor->spdSet < SPD_DEAD_BAND &&
+      motor->spdSet - meas < SPD_DEAD_BAND) {
+    meas = motor->spdSet;
+  }
+  Motor_Set_Output(motor,
+                   PID_F32_Update(&motor->spdPID, motor->spdSet, meas, dt));
+}
+
+/**
+ * @brief Map speed loop output to PWM duty (compensating the launch duty)
+ * and set PWM output
+ * @param  motor            Target
+ * @param  out              Speed loop output, -100~100
  */
-void Motor_Spd_PID_Run(motor_t *motor) {
-  static double pwmDuty = 0;
-  pwmDuty = Spd_PID_Calc(&motor->spdPID, motor->speed);
+void Motor_Set_Output(motor_t *motor, double out) {
+  double pwmDuty = out;
+  motor->pidOut = out;
   if (pwmDuty > 0.1)
     // pwmDuty += MOTOR_LAUNCH_PWM_DUTY;
     pwmDuty = dmap(pwmDuty, 0, 100, MOTOR_LAUNCH_PWM_DUTY, 100);
@@ -253,3 +369,293 @@ void Motor_Spd_PID_Run(motor_t *motor) {
   }
   motor->pwmDuty = pwmDuty;
 }
+
+/**
+ * @brief Run in speed mode, disabling the position loop
+ * @param  motor            Target
+ * @param  speed            Target speed, rpm
+ */
+void Motor_Set_Speed(motor_t *motor, double speed) {
+  SAFE_ATOM_CODE {
+    Motor_Autotune_Stop(motor);
+    motor->posEnable = 0;
+    motor->spdSet = speed;
+  }
+}
+
+/**
+ * @brief Run in position mode, enabling the position loop
+ * @param  motor            Target
+ * @param  pos              Target position, pulse
+ */
+void Motor_Set_Position(motor_t *motor, int32_t pos) {
+  SAFE_ATOM_CODE {
+    Motor_Autotune_Stop(motor);
+    if (!motor->posEnable) PID_F32_Reset(&motor->posPID);
+    motor->posSet = pos;
+    motor->posEnable = 1;
+  }
+}
+
+/**
+ * @brief Set runtime PID gains, output limits are kept
+ * @param  motor            Target
+ * @param  loop             MOTOR_TUNE_SPD or MOTOR_TUNE_POS
+ * @param  kp               Proportional gain
+ * @param  ki               Integral gain, 1/s
+ * @param  kd               Derivative gain, s
+ * @note Safe to call from an interrupt preempting the control loop, the
+ * reset is not overwritten by an interrupted PID update
+ */
+void Motor_Set_Gains(motor_t *motor, uint8_t loop, double kp, double ki,
+                     double kd) {
+  pid_f32_t *pid = loop == MOTOR_TUNE_SPD ? &motor->spdPID : &motor->posPID;
+  SAFE_ATOM_CODE { PID_F32_Init(pid, kp, ki, kd, pid->outMin, pid->outMax); }
+}
+
+/****************** Auto Tune Functions ******************/
+
+/**
+ * @brief Start relay feedback auto tune (Astrom-Hagglund). The loop output is
+ * replaced by bias +/- amp, switching when the error crosses +/- hyst, until
+ * the process oscillates at its ultimate period; gains are then computed from
+ * the ultimate gain and period. Hold the setpoint during tuning; the position
+ * loop is suspended while tuning the speed loop.
+ * @param  motor            Target, should be steady at the operating point
+ * @param  loop             MOTOR_TUNE_SPD or MOTOR_TUNE_POS
+ * @param  amp              Relay amplitude, duty(%) or rpm
+ * @param  hyst             Relay hysteresis, rpm or pulse
+ * @param  cycles           Oscillation cycles to average
+ */
+void Motor_Autotune_Start(motor_t *motor, uint8_t loop, double amp,
+                          double hyst, uint8_t cycles) {
+  motor_tune_t *tune = &motor->tune;
+  ASSERT(amp > 0 && hyst >= 0 && cycles > 0, "[MOTOR] bad tune param",
+         return);
+  ASSERT(loop == MOTOR_TUNE_SPD || motor->posEnable,
+         "[MOTOR] position loop disabled", return);
+  SAFE_ATOM_CODE {  // Not interleaved with a running control loop
+    tune->loop = loop;
+    tune->amp = amp;
+    tune->hyst = hyst;
+    tune->bias = loop == MOTOR_TUNE_SPD ? motor->pidOut : 0;
+    tune->relay = 1;
+    tune->cycles = 0;
+    tune->skip = 0;
+    tune->cycleNum = cycles;
+    tune->time = 0;
+    tune->lastSwitch = -1;
+    tune->pvMax = -1e30;
+    tune->pvMin = 1e30;
+    tune->periodSum = 0;
+    tune->ampSum = 0;
+    tune->state = MOTOR_TUNE_RUN;
+  }
+}
+
+/**
+ * @brief Abort auto tune, keep the original gains
+ * @param  motor            Target
+ */
+void Motor_Autotune_Stop(motor_t *motor) {
+  SAFE_ATOM_CODE {
+    if (motor->tune.state == MOTOR_TUNE_RUN) {
+      motor->tune.state = MOTOR_TUNE_IDLE;
+      PID_F32_Reset(&motor->spdPID);
+      PID_F32_Reset(&motor->posPID);
+    }
+  }
+}
+
+/**
+ * @brief Compute gains from the measured oscillation
+ * @param  motor            Target
+ */
+static void Motor_Autotune_Finish(motor_t *motor) {
+  motor_tune_t *tune = &motor->tune;
+  double a = tune->ampSum / tune->cycles / 2;  // Oscillation amplitude
+  pid_f32_t *pid;
+  if (a <= tune->hyst) {
+    tune->state = MOTOR_TUNE_FAIL;
+    PID_F32_Reset(&motor->spdPID);
+    PID_F32_Reset(&motor->posPID);
+    return;
+  }
+  // Describing function of a relay with hysteresis
+  tune->ku = 4 * tune->amp /
+             (3.14159265 * sqrt(a * a - tune->hyst * tune->hyst));
+  tune->pu = tune->periodSum / tune->cycles;
+  if (tune->loop == MOTOR_TUNE_SPD) {  // Ziegler-Nichols PI
+    pid = &motor->spdPID;
+    PID_F32_Init(pid, 0.45 * tune->ku, 0.54 * tune->ku / tune->pu, 0,
+                 pid->outMin, pid->outMax);
+  } else {  // Ziegler-Nichols PID, no overshoot
+    pid = &motor->posPID;
+    PID_F32_Init(pid, 0.2 * tune->ku, 0.4 * tune->ku / tune->pu,
+                 0.066 * tune->ku * tune->pu, pid->outMin, pid->outMax);
+    PID_F32_Reset(&motor->spdPID);
+  }
+  tune->state = MOTOR_TUNE_DONE;
+}
+
+/**
+ * @brief Run one auto tune step in place of the tuned loop's PID
+ * @param  motor            Target
+ * @param  dt               Time since last call, s
+ */
+void Motor_Autotune_Run(motor_t *motor, double dt) {
+  motor_tune_t *tune = &motor->tune;
+  double pv, err;
+  if (tune->loop == MOTOR_TUNE_SPD) {
+    pv = motor->speed;
+    err = motor->spdSet - pv;
+  } else {
+    pv = motor->pos;
+    err = motor->posSet - pv;
+  }
+  tune->time += dt;
+  if (pv > tune->pvMax) tune->pvMax = pv;
+  if (pv < tune->pvMin) tune->pvMin = pv;
+  if (tune->relay > 0 && err < -tune->hyst) {
+    tune->relay = -1;
+  } else if (tune->relay < 0 && err > tune->hyst) {
+    tune->relay = 1;
+    // One full oscillation between two switches to positive output
+    if (tune->lastSwitch >= 0) {
+      if (tune->skip < MOTOR_TUNE_SKIP) {
+        tune->skip++;
+      } else {
+        tune->periodSum += tune->time - tune->lastSwitch;
+        tune->ampSum += tune->pvMax - tune->pvMin;
+        tune->cycles++;
+      }
+    }
+    tune->lastSwitch = tune->time;
+    tune->pvMax = pv;
+    tune->pvMin = pv;
+  }
+  if (tune->cycles >= tune->cycleNum) {
+    Motor_Autotune_Finish(motor);
+    return;
+  }
+  if (tune->time > MOTOR_TUNE_TIMEOUT) {
+    tune->state = MOTOR_TUNE_FAIL;
+    PID_F32_Reset(&motor->spdPID);
+    PID_F32_Reset(&motor->posPID);
+    return;
+  }
+  if (tune->loop == MOTOR_TUNE_SPD) {
+    Motor_Set_Output(motor, tune->bias + tune->relay * tune->amp);
+  } else {
+    motor->spdSet = tune->bias + tune->relay * tune->amp;
+    Motor_Spd_PID_Run(motor, dt);
+  }
+}
+
+/****************** Control Loop Functions ******************/
+
+/**
+ * @brief Add motor to the timer driven control loop
+ * @param  motor            Target
+ */
+void Motor_Loop_Add(motor_t *motor) {
+  ASSERT(motor_num < MOTOR_MAX_NUM, "[MOTOR] too many motors", return);
+  SAFE_ATOM_CODE { motor_list[motor_num++] = motor; }
+}
+
+/**
+ * @brief Start the control loop: encoder sampling, position loop and speed
+ * loop of every added motor run in the timer update interrupt
+ * @param  htim             Basic timer, counting at MOTOR_LOOP_TIM_CLK
+ * @param  freq             Loop frequency, Hz
+ */
+void Motor_Loop_Start(TIM_HandleTypeDef *htim, uint32_t freq) {
+  ASSERT(freq > 0 && freq <= MOTOR_LOOP_MAX_FREQ &&
+             MOTOR_LOOP_TIM_CLK / freq <= 0x10000,
+         "[MOTOR] bad loop freq", return);
+  HAL_TIM_Base_Stop_IT(htim);
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  motor_loop_tim = htim;
+  motor_loop_period_cyc = SystemCoreClock / freq;
+  motor_loop_wcet_cyc = 0;
+  motor_loop_overrun = 0;
+  __HAL_TIM_SET_AUTORELOAD(htim, MOTOR_LOOP_TIM_CLK / freq - 1);
+  __HAL_TIM_SET_COUNTER(htim, 0);
+  __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+  motor_loop_last_cyc = DWT->CYCCNT;
+  HAL_TIM_Base_Start_IT(htim);
+}
+
+/**
+ * @brief Stop the control loop and set all PWM outputs to zero
+ */
+void Motor_Loop_Stop(void) {
+  if (motor_loop_tim == NULL) return;
+  HAL_TIM_Base_Stop_IT(motor_loop_tim);
+  for (uint8_t i = 0; i < motor_num; i++) {
+    __HAL_TIM_SET_COMPARE(motor_list[i]->timPWM, motor_list[i]->forwardChannel,
+                          0);
+    __HAL_TIM_SET_COMPARE(motor_list[i]->timPWM, motor_list[i]->reverseChannel,
+                          0);
+    motor_list[i]->pwmDuty = 0;
+  }
+}
+
+/**
+ * @brief Control loop timer interrupt, call from the timer IRQHandler
+ * @note dt fed into the PIDs is measured by DWT, not the nominal period
+ */
+__ITCM_CODE void Motor_Loop_IRQ_Handler(void) {
+  uint32_t start = DWT->CYCCNT;
+  uint32_t elapsed = start - motor_loop_last_cyc;
+  double dt = (double)elapsed / SystemCoreClock;
+  motor_t *motor;
+  TIM_TypeDef *tim = motor_loop_tim->Instance;
+  tim->SR = ~(uint32_t)TIM_SR_UIF;
+  // Interval over 1.5 periods means an update event was missed
+  if (elapsed > motor_loop_period_cyc + motor_loop_period_cyc / 2) {
+    motor_loop_overrun++;
+  }
+  motor_loop_last_cyc = start;
+  for (uint8_t i = 0; i < motor_num; i++) {
+    motor = motor_list[i];
+    Motor_Update_Speed(motor, 1.0 / dt);
+    if (motor->tune.state == MOTOR_TUNE_RUN) {
+      Motor_Autotune_Run(motor, dt);
+      continue;
+    }
+    if (motor->posEnable) Motor_Pos_PID_Run(motor, dt);
+    Motor_Spd_PID_Run(motor, dt);
+  }
+  elapsed = DWT->CYCCNT - start;
+  if (elapsed > motor_loop_wcet_cyc) motor_loop_wcet_cyc = elapsed;
+  // Next period already elapsed while running
+  if (tim->SR & TIM_SR_UIF) motor_loop_overrun++;
+}
+
+/**
+ * @brief Get control loop statistics
+ * @param  wcetNs           Worst-case execution time, ns
+ * @param  overrun          Overrun and missed period count
+ */
+void Motor_Get_Loop_Stat(uint32_t *wcetNs, uint32_t *overrun) {
+  if (wcetNs) {
+    *wcetNs = (uint64_t)motor_loop_wcet_cyc * 1000000000 / SystemCoreClock;
+  }
+  if (overrun) *overrun = motor_loop_overrun;
+}
+
+/**
+ * @brief Number of motors in the control loop
+ */
+uint8_t Motor_Num(void) { return motor_num; }
+
+/**
+ * @brief Get motor in the control loop by adding order
+ * @param  index            Index, 0 ~ Motor_Num() - 1
+ * @retval motor_t*         Motor, NULL if out of range
+ */
+motor_t *Motor_Get(uint8_t index) {
+  return index < motor_num ? motor_list[index] : NULL;
+}
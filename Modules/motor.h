@@ -13,6 +13,8 @@
 #include <main.h>
 #include <tim.h>
 
+#include "pid.h"
+
 /****************** 常量定义 ******************/
 // 电机参数相关
 #define SPEED_RATIO 1.0          // 齿轮组减速比
@@ -26,11 +28,45 @@
 
 // 功能相关
 #define MOTOR_PWM_FREQ 20000  // 电机PWM频率
-#define SYSTEM_CLOCK_FREQ_HZ 72000000
+#define SYSTEM_CLOCK_FREQ_HZ 240000000  // PWM定时器时钟频率
 #define ENCODER_TIM_PERIOD \
   65535  // 编码器TIM周期, 用于计算溢出 16bit:65535 32bit:4294967295
-#define ENCODER_MID_VALUE ENCODER_TIM_PERIOD / 2  // 编码器中值
-#define SPEED_FILTER 0.8                          // 速度滤波系数
+#define SPEED_FILTER 0.8      // 速度滤波系数(M法)
+#define MOTOR_MT_TIMEOUT 0.2  // 超过该时间无编码器边沿认为静止, s
+
+// 板级配置, 编码器需使用支持编码器模式的定时器(TIM1~5/TIM8), 当前均被
+// 步进电机占用; 在CubeMX中分配定时器后定义句柄(tim.h中的htimX)并设置
+// MOTOR_NUM
+#define MOTOR_NUM 0                      // 启用的直流电机数量
+// #define MOTOR1_TIM_ENCODER htimX      // 电机1编码器定时器
+// #define MOTOR1_TIM_PWM htimX          // 电机1PWM定时器
+#define MOTOR1_CH_FORWARD TIM_CHANNEL_1  // 电机1正向PWM通道
+#define MOTOR1_CH_REVERSE TIM_CHANNEL_2  // 电机1反向PWM通道
+// #define MOTOR2_TIM_ENCODER htimX      // 电机2编码器定时器
+// #define MOTOR2_TIM_PWM htimX          // 电机2PWM定时器
+#define MOTOR2_CH_FORWARD TIM_CHANNEL_1  // 电机2正向PWM通道
+#define MOTOR2_CH_REVERSE TIM_CHANNEL_2  // 电机2反向PWM通道
+
+// 控制环相关
+#define MOTOR_MAX_NUM 2                // 控制环最多电机数
+#define MOTOR_LOOP_TIM_CLK 10000000    // 控制环定时器计数频率
+#define MOTOR_LOOP_MAX_FREQ 20000      // 控制环最高频率
+#define MOTOR_LOOP_DEFAULT_FREQ 10000  // 控制环默认频率
+#define MOTOR_PID_TUNE_FREQ 100.0      // 以下PID参数整定时的调用频率
+
+#if MOTOR_NUM > MOTOR_MAX_NUM
+#error "MOTOR_NUM exceeds MOTOR_MAX_NUM"
+#endif
+#if MOTOR_NUM >= 1 && !(defined(MOTOR1_TIM_ENCODER) && defined(MOTOR1_TIM_PWM))
+#error "MOTOR_NUM >= 1: define MOTOR1_TIM_ENCODER and MOTOR1_TIM_PWM"
+#endif
+#if MOTOR_NUM >= 2 && !(defined(MOTOR2_TIM_ENCODER) && defined(MOTOR2_TIM_PWM))
+#error "MOTOR_NUM >= 2: define MOTOR2_TIM_ENCODER and MOTOR2_TIM_PWM"
+#endif
+
+// 继电反馈自整定
+#define MOTOR_TUNE_SKIP 2        // 丢弃的起始振荡周期数(未进入稳态)
+#define MOTOR_TUNE_TIMEOUT 20.0  // 自整定超时, s
 
 // 增量式PID
 #define INC_KP 0.0       // 比例项系数
@@ -92,14 +128,57 @@ typedef struct {           // 位置环PID结构体
   __IO int32_t maxI;       // 积分上限
 } pos_pid_t;
 
+enum {               // 自整定状态
+  MOTOR_TUNE_IDLE,   // 未进行
+  MOTOR_TUNE_RUN,    // 继电振荡中
+  MOTOR_TUNE_DONE,   // 完成, 新参数已写入
+  MOTOR_TUNE_FAIL,   // 超时或振荡幅值不足, 保留原参数
+};
+
+enum {              // 自整定对象
+  MOTOR_TUNE_SPD,   // 速度环(PI, 输出为PWM占空比)
+  MOTOR_TUNE_POS,   // 位置环(PID, 输出为速度环目标速度)
+};
+
+typedef struct {      // 继电反馈自整定
+  uint8_t state;      // 状态
+  uint8_t loop;       // 整定对象
+  int8_t relay;       // 继电器输出方向
+  uint8_t skip;       // 已丢弃的起始振荡周期数
+  uint8_t cycles;     // 已测量的振荡周期数
+  uint8_t cycleNum;   // 需测量的振荡周期数
+  double amp;         // 继电器幅值
+  double hyst;        // 继电器滞环宽度
+  double bias;        // 工作点输出
+  double time;        // 已运行时间, s
+  double lastSwitch;  // 上次切换到正向输出的时刻, s(<0:无)
+  double pvMax;       // 当前周期测量值最大值
+  double pvMin;       // 当前周期测量值最小值
+  double periodSum;   // 振荡周期累计, s
+  double ampSum;      // 振荡峰峰值累计
+  double ku;          // 临界增益
+  double pu;          // 临界周期, s
+} motor_tune_t;
+
 typedef struct {                  // 电机闭环控制结构体
   double speed;                   // 速度
   int32_t pos;                    // 位置
   int32_t lastPos;                // 上一次位置
-  spd_pid_t spdPID;               // 速度环PID
-  pos_pid_t posPID;               // 位置环PID
-  double posTargetSpd;            // 位置环目标速度
+  uint32_t encLast;               // 上次读取的编码器计数值(计数器自由运行)
+  TIM_HandleTypeDef *timCapture;  // 编码器边沿输入捕获定时器(NULL:仅用M法)
+  uint32_t captureChannel;        // 输入捕获通道
+  double captureClk;              // 输入捕获定时器计数频率, Hz
+  uint32_t lastEdgeCyc;           // 上一个编码器边沿的时刻, DWT周期
+  uint8_t edgeValid;              // lastEdgeCyc有效
+  pid_f32_t spdPID;               // 速度环PID
+  pid_f32_t posPID;               // 位置环PID
+  double spdSet;                  // 速度环目标速度, rpm
+  int32_t posSet;                 // 位置环目标位置, pulse
+  uint8_t posEnable;              // 使能位置环
+  double posTargetSpd;            // 位置环目标速度(速度环设定值限幅)
   double pwmDuty;                 // PWM占空比
+  double pidOut;                  // 速度环输出(启动占空比映射前)
+  motor_tune_t tune;              // 继电反馈自整定
   TIM_HandleTypeDef *timEncoder;  // 编码器定时器
   TIM_HandleTypeDef *timPWM;      // PWM定时器
   uint32_t forwardChannel;        // 正向通道
@@ -109,20 +188,20 @@ typedef struct {                  // 电机闭环控制结构体
 /****************** 带参宏定义 ******************/
 
 // 设置速度环速度（前提是没使能位置环）
-#define __MOTOR_SET_SPEED(motor, speed) motor.spdPID.setPoint = speed
+#define __MOTOR_SET_SPEED(motor, speed) motor.spdSet = speed
 
 // 设置位置环位置（以中立位为基准）
-#define __MOTOR_SET_POS(motor, pos) motor.posPID.setPoint = pos
+#define __MOTOR_SET_POS(motor, pos) motor.posSet = pos
 
 // 获取当前位置（以中立位为基准）
 #define __MOTOR_GET_POS(motor) (motor.pos)
 
 // 前进一定脉冲数（使能位置环）
-#define __MOTOR_GO_POS(motor, pos) motor.posPID.setPoint += pos
+#define __MOTOR_GO_POS(motor, pos) motor.posSet += pos
 
 // 设置位置环角度（以中立位为基准）
 #define __MOTOR_SET_DEGREE(motor, degree) \
-  motor.posPID.setPoint = (int32_t)(degree * PULSE_PER_ROTATION / 360.0)
+  motor.posSet = (int32_t)(degree * PULSE_PER_ROTATION / 360.0)
 
 // 获取当前角度（以中立位为基准）
 #define __MOTOR_GET_DEGREE(motor) \
@@ -130,11 +209,11 @@ typedef struct {                  // 电机闭环控制结构体
 
 // 按角度前进(使能位置环)
 #define __MOTOR_GO_DEGREE(motor, degree) \
-  motor.posPID.setPoint += (int32_t)(degree * PULSE_PER_ROTATION / 360.0)
+  motor.posSet += (int32_t)(degree * PULSE_PER_ROTATION / 360.0)
 
 // 按米前进（使能位置环）
 #define __MOTOR_GO_METER(motor, meter) \
-  motor.posPID.setPoint += meter * PULSE_PER_METER
+  motor.posSet += meter * PULSE_PER_METER
 
 // 停止（会使能32的PWM刹车功能（大概？））
 #define __MOTOR_PWM_SETZERO(motor)                              \
@@ -160,16 +239,13 @@ typedef struct {                  // 电机闭环控制结构体
   HAL_TIM_PWM_Start(motor.timPWM, motor.forwardChannel || motor.reverseChannel)
 
 // 以当前状态重置位置环中立位
-#define __MOTOR_RESET_ENCODER(motor)                          \
-  __HAL_TIM_SET_COUNTER(motor.timEncoder, ENCODER_MID_VALUE); \
-  motor.lastPos = 0;                                          \
+#define __MOTOR_RESET_ENCODER(motor)                        \
+  motor.encLast = __HAL_TIM_GET_COUNTER(motor.timEncoder); \
+  motor.lastPos = 0;                                        \
   motor.pos = 0
 
-// 清空任意类型PID的误差累计
-#define __CLEAR_PID_ERROR(motor, pid) \
-  pid.sumError = 0;                   \
-  pid.error_1 = 0;                    \
-  pid.error_2 = 0
+// 清空PID的误差累计
+#define __CLEAR_PID_ERROR(motor, pid) PID_F32_Reset(&pid)
 
 // 清空双环PID的误差累计
 #define __CLEAR_ALL_PID_ERROR(motor)      \
@@ -190,9 +266,27 @@ void Pos_PID_Param_Init(pos_pid_t *);
 void Motor_Setup(motor_t *motor, TIM_HandleTypeDef *timEncoder,
                  TIM_HandleTypeDef *timPWM, uint32_t forwardChannel,
                  uint32_t reverseChannel);
+void Motor_Setup_Capture(motor_t *motor, TIM_HandleTypeDef *timCapture,
+                         uint32_t captureChannel, double captureClk);
 void Motor_Update_Speed(motor_t *motor, double runTimeHz);
 void Motor_Encoder_Overflow(motor_t *motor);
-void Motor_Pos_PID_Run(motor_t *motor);
-void Motor_Spd_PID_Run(motor_t *motor);
+void Motor_Pos_PID_Run(motor_t *motor, double dt);
+void Motor_Spd_PID_Run(motor_t *motor, double dt);
+void Motor_Set_Output(motor_t *motor, double out);
+void Motor_Set_Speed(motor_t *motor, double speed);
+void Motor_Set_Position(motor_t *motor, int32_t pos);
+void Motor_Set_Gains(motor_t *motor, uint8_t loop, double kp, double ki,
+                     double kd);
+void Motor_Autotune_Start(motor_t *motor, uint8_t loop, double amp,
+                          double hyst, uint8_t cycles);
+void Motor_Autotune_Stop(motor_t *motor);
+void Motor_Autotune_Run(motor_t *motor, double dt);
+void Motor_Loop_Add(motor_t *motor);
+void Motor_Loop_Start(TIM_HandleTypeDef *htim, uint32_t freq);
+void Motor_Loop_Stop(void);
+void Motor_Loop_IRQ_Handler(void);
+void Motor_Get_Loop_Stat(uint32_t *wcetNs, uint32_t *overrun);
+uint8_t Motor_Num(void);
+motor_t *Motor_Get(uint8_t index);
 
 #endif  // __MOTOR_H
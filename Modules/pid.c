@@ -0,0 +1,240 @@
+/**
+ * @file pid.c
+ * @brief 可重入PID控制器, 所有中间状态保存在实例中, 可在多个中断中控制多台电机
+ * 微分作用于测量值(设定值突变不产生微分冲击), 输出限幅, 积分以反算法抗饱和:
+ * 积分项额外加上 kb*(限幅后输出-限幅前输出), 输出饱和时积分自动回退
+ * 提供浮点和Q15/Q31定点三种实现, 定点版本的ki/kd在初始化时折算控制周期,
+ * 各系数单独选取移位数, 大小相差悬殊的系数都能保留有效位
+ * @author Ellu (lutaoyu@163.com)
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include "pid.h"
+
+#include "uart_pack.h"
+
+static inline int64_t PID_Sat(int64_t x, int64_t min, int64_t max) {
+  return x > max ? max : (x < min ? min : x);
+}
+
+static inline int64_t PID_Shift(int64_t x, int8_t sh) {
+  return sh >= 0 ? x * ((int64_t)1 << sh) : x >> -sh;
+}
+
+/**
+ * @brief 将浮点系数转换为定点, 每个系数单独选取移位数, 小系数右移保留精度
+ * @param  k                浮点系数
+ * @param  q                定点系数输出
+ * @param  frac             定点小数位数(15或31)
+ * @param  minShift         允许的最小移位数(负数为右移)
+ * @param  maxShift         允许的最大移位数
+ * @retval int8_t           移位数, 实际值 = q * 2^(移位数-frac)
+ */
+static int8_t PID_To_Fixed(float k, int64_t *q, uint8_t frac, int8_t minShift,
+                           int8_t maxShift) {
+  double a = k < 0 ? -k : k, s = 1;  // s = 2^shift
+  int8_t shift = 0;
+  while (shift > minShift && a < s / 2) {
+    shift--;
+    s /= 2;
+  }
+  while (shift < maxShift && a >= s) {
+    shift++;
+    s *= 2;
+  }
+  *q = (int64_t)((double)k / s * ((int64_t)1 << frac));
+  *q = PID_Sat(*q, -((int64_t)1 << frac), ((int64_t)1 << frac) - 1);
+  ASSERT(k == 0 || *q != 0, "[PID] coefficient underflow");
+  return shift;
+}
+
+/****************** Float PID Functions ******************/
+
+/**
+ * @brief 初始化浮点PID, 抗饱和系数取ki/kp
+ * @param  pid              PID实例
+ * @param  kp               比例系数
+ * @param  ki               积分系数, 1/s
+ * @param  kd               微分系数, s
+ * @param  outMin           输出下限
+ * @param  outMax           输出上限
+ */
+void PID_F32_Init(pid_f32_t *pid, float kp, float ki, float kd, float outMin,
+                  float outMax) {
+  pid->kp = kp;
+  pid->ki = ki;
+  pid->kd = kd;
+  pid->kb = kp != 0 ? ki / kp : 0;
+  pid->outMin = outMin;
+  pid->outMax = outMax;
+  PID_F32_Reset(pid);
+}
+
+/**
+ * @brief 清除浮点PID的积分和微分历史
+ * @param  pid              PID实例
+ */
+void PID_F32_Reset(pid_f32_t *pid) {
+  pid->integ = 0;
+  pid->lastMeas = 0;
+  pid->first = 1;
+}
+
+/**
+ * @brief 计算浮点PID
+ * @param  pid              PID实例
+ * @param  setPoint         设定值
+ * @param  meas             测量值
+ * @param  dt               距上次计算的时间, s
+ * @retval float            限幅后的输出
+ */
+float PID_F32_Update(pid_f32_t *pid, float setPoint, float meas, float dt) {
+  float err = setPoint - meas;
+  float v, u;
+  if (pid->first || dt <= 0) {
+    pid->lastMeas = meas;
+    pid->first = 0;
+  }
+  v = pid->kp * err + pid->integ;
+  if (dt > 0) v -= pid->kd * (meas - pid->lastMeas) / dt;
+  u = v > pid->outMax ? pid->outMax : (v < pid->outMin ? pid->outMin : v);
+  pid->integ += (pid->ki * err + pid->kb * (u - v)) * dt;
+  pid->lastMeas = meas;
+  return u;
+}
+
+/****************** Q15 PID Functions ******************/
+
+/**
+ * @brief 初始化Q15定点PID, 抗饱和系数取ki/kp
+ * @param  pid              PID实例
+ * @param  kp               比例系数
+ * @param  ki               积分系数, 1/s
+ * @param  kd               微分系数, s
+ * @param  dt               控制周期, s
+ * @param  outMin           输出下限, Q15
+ * @param  outMax           输出上限, Q15
+ */
+void PID_Q15_Init(pid_q15_t *pid, float kp, float ki, float kd, float dt,
+                  int16_t outMin, int16_t outMax) {
+  int64_t q;
+  pid->kpShift = PID_To_Fixed(kp, &q, 15, -15, 14);
+  pid->kp = q;
+  pid->kiShift = PID_To_Fixed(ki * dt, &q, 15, -15, 14);
+  pid->ki = q;
+  pid->kdShift = PID_To_Fixed(kd / dt, &q, 15, -15, 14);
+  pid->kd = q;
+  pid->kbShift = PID_To_Fixed(kp != 0 ? ki / kp * dt : 0, &q, 15, -15, 14);
+  pid->kb = q;
+  pid->outMin = outMin;
+  pid->outMax = outMax;
+  PID_Q15_Reset(pid);
+}
+
+/**
+ * @brief 清除Q15定点PID的积分和微分历史
+ * @param  pid              PID实例
+ */
+void PID_Q15_Reset(pid_q15_t *pid) {
+  pid->integ = 0;
+  pid->lastMeas = 0;
+  pid->first = 1;
+}
+
+/**
+ * @brief 计算Q15定点PID, 需以初始化时的控制周期调用
+ * @param  pid              PID实例
+ * @param  setPoint         设定值, Q15
+ * @param  meas             测量值, Q15
+ * @retval int16_t          限幅后的输出, Q15
+ */
+int16_t PID_Q15_Update(pid_q15_t *pid, int16_t setPoint, int16_t meas) {
+  int32_t err = PID_Sat(setPoint - meas, INT16_MIN, INT16_MAX);
+  int32_t dm, v, u, aw;
+  int64_t acc;
+  if (pid->first) {
+    pid->lastMeas = meas;
+    pid->first = 0;
+  }
+  dm = PID_Sat(meas - pid->lastMeas, INT16_MIN, INT16_MAX);
+  v = ((pid->kp * err) >> (15 - pid->kpShift)) -
+      ((pid->kd * dm) >> (15 - pid->kdShift)) + (pid->integ >> 16);
+  u = PID_Sat(v, pid->outMin, pid->outMax);
+  aw = PID_Sat((int64_t)u - v, INT32_MIN, INT32_MAX);  // 深度饱和时可超过满量程
+  // 系数与误差之积为Q30, 积分项为Q15再扩展16位小数即Q31
+  acc = PID_Shift((int64_t)pid->ki * err, pid->kiShift + 1) +
+        PID_Shift((int64_t)pid->kb * aw, pid->kbShift + 1);
+  pid->integ = PID_Sat(pid->integ + acc, INT32_MIN, INT32_MAX);
+  pid->lastMeas = meas;
+  return u;
+}
+
+/****************** Q31 PID Functions ******************/
+
+/**
+ * @brief 初始化Q31定点PID, 抗饱和系数取ki/kp
+ * @param  pid              PID实例
+ * @param  kp               比例系数
+ * @param  ki               积分系数, 1/s
+ * @param  kd               微分系数, s
+ * @param  dt               控制周期, s
+ * @param  outMin           输出下限, Q31
+ * @param  outMax           输出上限, Q31
+ */
+void PID_Q31_Init(pid_q31_t *pid, float kp, float ki, float kd, float dt,
+                  int32_t outMin, int32_t outMax) {
+  int64_t q;
+  pid->kpShift = PID_To_Fixed(kp, &q, 31, -31, 15);
+  pid->kp = q;
+  pid->kiShift = PID_To_Fixed(ki * dt, &q, 31, -31, 15);
+  pid->ki = q;
+  pid->kdShift = PID_To_Fixed(kd / dt, &q, 31, -31, 15);
+  pid->kd = q;
+  pid->kbShift = PID_To_Fixed(kp != 0 ? ki / kp * dt : 0, &q, 31, -31, 15);
+  pid->kb = q;
+  pid->outMin = outMin;
+  pid->outMax = outMax;
+  PID_Q31_Reset(pid);
+}
+
+/**
+ * @brief 清除Q31定点PID的积分和微分历史
+ * @param  pid              PID实例
+ */
+void PID_Q31_Reset(pid_q31_t *pid) {
+  pid->integ = 0;
+  pid->lastMeas = 0;
+  pid->first = 1;
+}
+
+/**
+ * @brief 计算Q31定点PID, 需以初始化时的控制周期调用
+ * @param  pid              PID实例
+ * @param  setPoint         设定值, Q31
+ * @param  meas             测量值, Q31
+ * @retval int32_t          限幅后的输出, Q31
+ */
+int32_t PID_Q31_Update(pid_q31_t *pid, int32_t setPoint, int32_t meas) {
+  int64_t err = PID_Sat((int64_t)setPoint - meas, INT32_MIN, INT32_MAX);
+  int64_t dm, v, u, aw;
+  if (pid->first) {
+    pid->lastMeas = meas;
+    pid->first = 0;
+  }
+  dm = PID_Sat((int64_t)meas - pid->lastMeas, INT32_MIN, INT32_MAX);
+  v = ((pid->kp * err) >> (31 - pid->kpShift)) -
+      ((pid->kd * dm) >> (31 - pid->kdShift)) + (pid->integ >> 16);
+  u = PID_Sat(v, pid->outMin, pid->outMax);
+  // 反算量限制在2倍满量程内, 与抗饱和系数之积不超出int64
+  aw = PID_Sat(u - v, (int64_t)INT32_MIN * 2, (int64_t)INT32_MAX * 2);
+  // 系数与误差之积为Q62, 积分项为Q31再扩展16位小数即Q47
+  pid->integ += ((pid->ki * err) >> (15 - pid->kiShift)) +
+                ((pid->kb * aw) >> (15 - pid->kbShift));
+  pid->integ = PID_Sat(pid->integ, (int64_t)INT32_MIN * 65536,
+                       (int64_t)INT32_MAX * 65536);
+  pid->lastMeas = meas;
+  return u;
+}
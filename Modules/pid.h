@@ -0,0 +1,78 @@
+/**
+ * @file pid.h
+ * @brief see pid.c
+ * @author Ellu (lutaoyu@163.com)
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * THINK DIFFERENTLY
+ */
+
+#ifndef __PID_H
+#define __PID_H
+#include "main.h"
+
+/****************** 数据类型定义 ******************/
+
+typedef struct {   // 浮点PID
+  float kp;        // 比例系数
+  float ki;        // 积分系数, 1/s
+  float kd;        // 微分系数, s
+  float kb;        // 抗饱和反算系数, 1/s (0: 取ki/kp)
+  float outMin;    // 输出下限
+  float outMax;    // 输出上限
+  float integ;     // 积分项(已乘ki)
+  float lastMeas;  // 上次测量值
+  uint8_t first;   // 首次计算, 不计微分
+} pid_f32_t;
+
+typedef struct {     // Q15定点PID, 输入输出为Q15
+  int16_t kp;        // 比例系数, Q15, 实际值 = kp * 2^kpShift
+  int16_t ki;        // 积分系数(已乘控制周期), Q15, 实际值 = ki * 2^kiShift
+  int16_t kd;        // 微分系数(已除控制周期), Q15, 实际值 = kd * 2^kdShift
+  int16_t kb;        // 抗饱和反算系数(已乘控制周期), Q15, 同上
+  int8_t kpShift;    // 比例系数移位数, -15~14, 负数为右移
+  int8_t kiShift;    // 积分系数移位数, 同上
+  int8_t kdShift;    // 微分系数移位数, 同上
+  int8_t kbShift;    // 抗饱和系数移位数, 同上
+  int16_t outMin;    // 输出下限
+  int16_t outMax;    // 输出上限
+  int32_t integ;     // 积分项, Q15再扩展16位小数
+  int16_t lastMeas;  // 上次测量值
+  uint8_t first;     // 首次计算, 不计微分
+} pid_q15_t;
+
+typedef struct {     // Q31定点PID, 输入输出为Q31
+  int32_t kp;        // 比例系数, Q31, 实际值 = kp * 2^kpShift
+  int32_t ki;        // 积分系数(已乘控制周期), Q31, 实际值 = ki * 2^kiShift
+  int32_t kd;        // 微分系数(已除控制周期), Q31, 实际值 = kd * 2^kdShift
+  int32_t kb;        // 抗饱和反算系数(已乘控制周期), Q31, 同上
+  int8_t kpShift;    // 比例系数移位数, -31~15, 负数为右移
+  int8_t kiShift;    // 积分系数移位数, 同上
+  int8_t kdShift;    // 微分系数移位数, 同上
+  int8_t kbShift;    // 抗饱和系数移位数, 同上
+  int32_t outMin;    // 输出下限
+  int32_t outMax;    // 输出上限
+  int64_t integ;     // 积分项, Q31再扩展16位小数
+  int32_t lastMeas;  // 上次测量值
+  uint8_t first;     // 首次计算, 不计微分
+} pid_q31_t;
+
+/****************** 函数声明 ******************/
+
+void PID_F32_Init(pid_f32_t *pid, float kp, float ki, float kd, float outMin,
+                  float outMax);
+void PID_F32_Reset(pid_f32_t *pid);
+float PID_F32_Update(pid_f32_t *pid, float setPoint, float meas, float dt);
+
+void PID_Q15_Init(pid_q15_t *pid, float kp, float ki, float kd, float dt,
+                  int16_t outMin, int16_t outMax);
+void PID_Q15_Reset(pid_q15_t *pid);
+int16_t PID_Q15_Update(pid_q15_t *pid, int16_t setPoint, int16_t meas);
+
+void PID_Q31_Init(pid_q31_t *pid, float kp, float ki, float kd, float dt,
+                  int32_t outMin, int32_t outMax);
+void PID_Q31_Reset(pid_q31_t *pid);
+int32_t PID_Q31_Update(pid_q31_t *pid, int32_t setPoint, int32_t meas);
+
+#endif
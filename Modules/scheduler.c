@@ -1,8 +1,18 @@
 /**
  * @file scheduler.c
  * @brief
- * 时分调度器，目前基本使用__weak修饰，以便在其他文件中可以重写（不用考虑头文件问题）
- * 后续直接整合，使用static修饰提高重入效率
+ * 时分调度器，任务存放于静态任务池，启动后不再使用堆
+ * 使能的任务按下次运行时刻组成二叉最小堆，主循环只检查堆顶，
+ * 按id查找为O(1)，使能/删除/改频为O(log n)
+ * 时基为扩展到64位的DWT周期计数，每次运行后下次运行时刻恰好推进一个周期，
+ * 偶发延迟后自动追赶，长期不漂移；带dt参数的任务获得距上次运行的实测时间
+ * 每个任务始终记录执行时间、启动抖动和超时次数，并按窗口统计CPU占用率
+ * 任务分为两个优先级: 后台任务在主循环中协作运行; 实时任务由SysTick触发
+ * PendSV, 在PendSV中断中运行并抢占后台任务, 不受后台任务耗时影响.
+ * 两级之间共享的数据用SCH_LOCK_CODE保护
+ * 事件任务平时休眠, 由中断调用Sch_Post投递事件位后运行; 每级的就绪事件任务
+ * 记录在32位就绪位图中, 用CLZ指令O(1)选出最高优先级, 先于周期任务运行
+ * @note 任务控制函数可在任务中调用, 不可在硬件中断中调用
  * @author Ellu (lutaoyu@163.com)
  * @version 1.0
  * @date 2021-12-11
@@ -11,17 +21,199 @@
  */
 
 #include <scheduler.h>
-#include <stdlib.h>
+#include <uart_pack.h>
 /************************ scheduler tasks ************************/
 
-// task lists
-static scheduler_task_t *schTaskEntry = NULL;
-static scheduler_task_t *task_p = NULL;
-// @note !redefined in main.c
+// task pool
+static scheduler_task_t sch_pool[SCH_MAX_TASK] __DTCM_DATA;
+typedef struct {              // due-time heap, stores task ids
+  uint8_t id[SCH_MAX_TASK];  // heap array
+  uint8_t num;               // task count
+} sch_heap_t;
+static sch_heap_t sch_heap[SCH_PRIO_NUM] __DTCM_DATA;  // one heap per level
+// event tasks: ready bitmap, allocated bits and bit to task id, per level
+static __IO uint32_t sch_ready[SCH_PRIO_NUM] = {0};
+static uint32_t sch_evt_used[SCH_PRIO_NUM] = {0};
+static uint8_t sch_evt_id[SCH_PRIO_NUM][SCH_EVT_PRIO_NUM] __DTCM_DATA;
+static uint32_t sch_cyc_last = 0;   // 上次读取的DWT计数
+static uint32_t sch_cyc_high = 0;   // DWT计数溢出次数
+static uint64_t sch_busy_cyc = 0;   // 当前窗口内任务执行时间
+static uint64_t sch_rt_cyc = 0;     // 实时任务累计执行时间
+static uint64_t sch_win_start = 0;  // 当前窗口起点
+static uint16_t sch_load = 0;       // 上个窗口的CPU占用率, % * 100
 
 /************************ scheduler tasks end ************************/
 
-// variables
+// due-time heap functions, call with scheduler locked
+
+static inline uint8_t Sch_Heap_Less(sch_heap_t *h, uint8_t a, uint8_t b) {
+  return (int64_t)(sch_pool[h->id[a]].nextRunCyc -
+                   sch_pool[h->id[b]].nextRunCyc) < 0;
+}
+
+static inline void Sch_Heap_Swap(sch_heap_t *h, uint8_t a, uint8_t b) {
+  uint8_t t = h->id[a];
+  h->id[a] = h->id[b];
+  h->id[b] = t;
+  sch_pool[h->id[a]].heapIdx = a;
+  sch_pool[h->id[b]].heapIdx = b;
+}
+
+static void Sch_Heap_Up(sch_heap_t *h, uint8_t i) {
+  while (i > 0 && Sch_Heap_Less(h, i, (i - 1) / 2)) {
+    Sch_Heap_Swap(h, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void Sch_Heap_Down(sch_heap_t *h, uint8_t i) {
+  uint8_t l, m;
+  while (1) {
+    l = 2 * i + 1;
+    if (l >= h->num) break;
+    m = (l + 1 < h->num && Sch_Heap_Less(h, l + 1, l)) ? l + 1 : l;
+    if (!Sch_Heap_Less(h, m, i)) break;
+    Sch_Heap_Swap(h, i, m);
+    i = m;
+  }
+}
+
+static void Sch_Heap_Push(uint8_t taskId) {
+  sch_heap_t *h = &sch_heap[sch_pool[taskId].prio];
+  h->id[h->num] = taskId;
+  sch_pool[taskId].heapIdx = h->num;
+  h->num++;
+  Sch_Heap_Up(h, h->num - 1);
+}
+
+static void Sch_Heap_Remove(uint8_t taskId) {
+  sch_heap_t *h = &sch_heap[sch_pool[taskId].prio];
+  uint8_t i = sch_pool[taskId].heapIdx;
+  if (i == SCH_INVALID_ID) return;
+  sch_pool[taskId].heapIdx = SCH_INVALID_ID;
+  h->num--;
+  if (i == h->num) return;
+  h->id[i] = h->id[h->num];
+  sch_pool[h->id[i]].heapIdx = i;
+  Sch_Heap_Up(h, i);
+  Sch_Heap_Down(h, sch_pool[h->id[i]].heapIdx);
+}
+
+static inline uint64_t Sch_Period(float rateHz) {
+  uint64_t period = (double)SystemCoreClock / rateHz + 0.5;
+  return period == 0 ? 1 : period;
+}
+
+static inline uint32_t Sch_Sat32(uint64_t x) {
+  return x > UINT32_MAX ? UINT32_MAX : x;
+}
+
+/**
+ * @brief 获取扩展到64位的DWT周期计数
+ * @note 需至少每个DWT溢出周期(480MHz下约8.9s)调用一次, 主循环中自然满足
+ */
+uint64_t Sch_Get_Cycles(void) {
+  uint64_t cyc;
+  SCH_LOCK_CODE {
+    cyc = DWT->CYCCNT;
+    if (cyc < sch_cyc_last) sch_cyc_high++;
+    sch_cyc_last = cyc;
+    cyc |= (uint64_t)sch_cyc_high << 32;
+  }
+  return cyc;
+}
+
+/**
+ * @brief 启用任务, 调度器已锁定
+ */
+static void Sch_Enable(uint8_t taskId) {
+  scheduler_task_t *p;
+  uint64_t now = Sch_Get_Cycles();
+  if (taskId >= SCH_MAX_TASK) return;
+  p = &sch_pool[taskId];
+  if (!p->used || p->enable) return;
+  if (p->evtBit != SCH_INVALID_ID) {  // 停用期间投递的事件在启用后运行
+    SAFE_ATOM_CODE {
+      p->enable = 1;
+      if (p->posted) sch_ready[p->prio] |= 1UL << p->evtBit;
+    }
+    if (p->posted && p->prio == SCH_PRIO_RT) {
+      SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    }
+    return;
+  }
+  p->enable = 1;
+  // 停用期间错过的周期不补跑, 到期即运行
+  if ((int64_t)(now - p->nextRunCyc) > 0) p->nextRunCyc = now;
+  Sch_Heap_Push(taskId);
+}
+
+/**
+ * @brief 停用任务, 调度器已锁定
+ */
+static void Sch_Disable(uint8_t taskId) {
+  scheduler_task_t *p;
+  if (taskId >= SCH_MAX_TASK || !sch_pool[taskId].enable) return;
+  p = &sch_pool[taskId];
+  if (p->evtBit != SCH_INVALID_ID) {
+    SAFE_ATOM_CODE {
+      p->enable = 0;
+      sch_ready[p->prio] &= ~(1UL << p->evtBit);
+    }
+    return;
+  }
+  p->enable = 0;
+  Sch_Heap_Remove(taskId);
+}
+
+/**
+ * @brief 删除任务, 调度器已锁定
+ */
+static void Sch_Del(uint8_t taskId) {
+  if (taskId >= SCH_MAX_TASK || !sch_pool[taskId].used) return;
+  Sch_Disable(taskId);
+  if (sch_pool[taskId].evtBit != SCH_INVALID_ID) {
+    sch_evt_used[sch_pool[taskId].prio] &= ~(1UL << sch_pool[taskId].evtBit);
+  }
+  sch_pool[taskId].used = 0;
+}
+
+/**
+ * @brief 修改任务频率, 调度器已锁定
+ */
+static void Sch_Set_Freq(uint8_t taskId, float freq) {
+  scheduler_task_t *p;
+  uint64_t period;
+  if (taskId >= SCH_MAX_TASK || !sch_pool[taskId].used || freq <= 0) return;
+  p = &sch_pool[taskId];
+  if (p->evtBit != SCH_INVALID_ID) return;  // 事件任务无周期
+  period = Sch_Period(freq);
+  p->rateHz = freq;
+  p->nextRunCyc += period - p->periodCyc;  // 保持上次运行时刻不变
+  p->periodCyc = period;
+  if (p->heapIdx != SCH_INVALID_ID) {
+    Sch_Heap_Up(&sch_heap[p->prio], p->heapIdx);
+    Sch_Heap_Down(&sch_heap[p->prio], p->heapIdx);
+  }
+}
+
+/**
+ * @brief 修改任务优先级, 调度器已锁定
+ */
+static void Sch_Set_Prio(uint8_t taskId, uint8_t prio) {
+  uint8_t enable;
+  if (taskId >= SCH_MAX_TASK || !sch_pool[taskId].used) return;
+  if (prio >= SCH_PRIO_NUM || sch_pool[taskId].prio == prio) return;
+  // 事件任务的就绪位在添加时按优先级分配, 不可更改
+  if (sch_pool[taskId].evtBit != SCH_INVALID_ID) return;
+  if (prio == SCH_PRIO_RT) {
+    HAL_NVIC_SetPriority(PendSV_IRQn, SCH_RT_IRQ_PRIO, 0);
+  }
+  enable = sch_pool[taskId].enable;
+  Sch_Disable(taskId);
+  sch_pool[taskId].prio = prio;
+  if (enable) Sch_Enable(taskId);
+}
 
 // scheduler task control functions
 
@@ -30,102 +222,323 @@ static scheduler_task_t *task_p = NULL;
  * @param  task             task function
  * @param  rateHz           task rate
  * @param  enable           enable or disable at startup
- * @retval uint8_t taskId
+ * @retval uint8_t taskId, SCH_INVALID_ID if the pool is full
  */
-uint8_t Add_SchTask(void (*task)(void), float rateHz, uint8_t enable) {
-  scheduler_task_t *p = (scheduler_task_t *)malloc(sizeof(scheduler_task_t));
+uint8_t Add_SchTask(sch_func_t task, float rateHz, uint8_t enable) {
+  uint8_t id = 0;
+  ASSERT(rateHz > 0, "[SCH] bad task rate", return SCH_INVALID_ID);
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->LAR = 0xC5ACCE55;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  SCH_LOCK_CODE {
+    while (id < SCH_MAX_TASK && sch_pool[id].used) id++;
+    if (id < SCH_MAX_TASK) sch_pool[id].used = 1;  // 先占用, 再初始化
+  }
+  ASSERT(id < SCH_MAX_TASK, "[SCH] task pool full", return SCH_INVALID_ID);
+  scheduler_task_t *p = &sch_pool[id];
   p->task = task;
   p->rateHz = rateHz;
-  p->periodMs = 1000 / p->rateHz;
-  if (p->periodMs == 0) p->periodMs = 1;
-  p->lastRunMs = 0;
-  p->enable = enable;
-  p->taskId = 0;
-  p->next = NULL;
-  if (schTaskEntry == NULL) {
-    schTaskEntry = p;
-  } else {
-    scheduler_task_t *q = schTaskEntry;
-    while (q->next != NULL) {
-      q = q->next;
+  p->periodCyc = Sch_Period(rateHz);
+  p->nextRunCyc = Sch_Get_Cycles();
+  p->lastRunCyc = p->nextRunCyc - p->periodCyc;  // 首次运行dt为标称周期
+  p->withDt = 0;
+  p->enable = 0;
+  p->prio = SCH_PRIO_BG;
+  p->heapIdx = SCH_INVALID_ID;
+  p->evtBit = SCH_INVALID_ID;
+  p->posted = 0;
+  p->events = 0;
+  Sch_Reset_Stat(id);
+  if (enable) _Enable_SchTask_Id(id);
+  return id;
+}
+
+/**
+ * @brief add a task which receives the measured time since its last run
+ * @param  task             task function, dt in seconds
+ * @param  rateHz           task rate
+ * @param  enable           enable or disable at startup
+ * @retval uint8_t taskId, SCH_INVALID_ID if the pool is full
+ */
+uint8_t Add_SchTask_Dt(sch_func_dt_t task, float rateHz, uint8_t enable) {
+  uint8_t id = Add_SchTask((sch_func_t)task, rateHz, 0);
+  if (id == SCH_INVALID_ID) return id;
+  sch_pool[id].withDt = 1;
+  if (enable) _Enable_SchTask_Id(id);
+  return id;
+}
+
+/**
+ * @brief 添加事件任务, 平时休眠, 由Sch_Post唤醒, 添加后即启用
+ * @param  task             任务函数, 参数为自上次运行以来投递的事件位
+ * @param  prio             SCH_PRIO_BG or SCH_PRIO_RT
+ * @param  evtPrio          同级事件任务间的优先级, 0~31, 越大越先运行, 不可重复
+ * @retval uint8_t taskId, SCH_INVALID_ID if failed
+ */
+uint8_t Add_SchEvent(sch_func_evt_t task, uint8_t prio, uint8_t evtPrio) {
+  uint8_t id;
+  ASSERT(prio < SCH_PRIO_NUM && evtPrio < SCH_EVT_PRIO_NUM,
+         "[SCH] bad event prio", return SCH_INVALID_ID);
+  ASSERT(!(sch_evt_used[prio] & (1UL << evtPrio)), "[SCH] event prio used",
+         return SCH_INVALID_ID);
+  id = Add_SchTask((sch_func_t)task, 1, 0);
+  if (id == SCH_INVALID_ID) return id;
+  SCH_LOCK_CODE {
+    sch_evt_used[prio] |= 1UL << evtPrio;
+    sch_evt_id[prio][evtPrio] = id;
+    sch_pool[id].rateHz = 0;
+    sch_pool[id].prio = prio;
+    sch_pool[id].evtBit = evtPrio;
+    if (prio == SCH_PRIO_RT) {
+      HAL_NVIC_SetPriority(PendSV_IRQn, SCH_RT_IRQ_PRIO, 0);
     }
-    q->next = p;
-    p->taskId = q->taskId + 1;
+    Sch_Enable(id);
   }
-  return p->taskId;
+  return id;
 }
 
-#if _ENABLE_SCH_DEBUG
-#include <stdio.h>
-#include <uart_pack.h>
+/**
+ * @brief 向事件任务投递事件, 可在任意中断中调用
+ * @param  taskId           事件任务id
+ * @param  events           事件位, 与未处理的事件位合并; 可为0, 仅唤醒
+ */
+__ITCM_CODE void Sch_Post(uint8_t taskId, uint32_t events) {
+  scheduler_task_t *p;
+  uint8_t wake = 0;
+  if (taskId >= SCH_MAX_TASK) return;
+  p = &sch_pool[taskId];
+  if (!p->used || p->evtBit == SCH_INVALID_ID) return;
+  SAFE_ATOM_CODE {
+    if (p->posted) {
+      p->stat.overrun++;
+    } else {
+      p->posted = 1;
+      p->postCyc = DWT->CYCCNT;
+    }
+    p->events |= events;
+    if (p->enable) {
+      sch_ready[p->prio] |= 1UL << p->evtBit;
+      wake = p->prio == SCH_PRIO_RT;
+    }
+  }
+  if (wake) SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
 
+#if _ENABLE_SCH_DEBUG
 void Print_Debug_info(void) {
-  static char str_buf[100];
-  scheduler_task_t *p = schTaskEntry;
-  sprintf(str_buf, "SCH INFO ---\r\n");
-  while (p != NULL) {
-    sprintf(str_buf, "%sTask %d: %dms\r\n", str_buf, p->taskId,
-            p->task_consuming);
-    p = p->next;
+  scheduler_task_t info;
+  LOG_D("SCH INFO --- load %d.%02d%%", sch_load / 100, sch_load % 100);
+  for (uint8_t i = 0; i < SCH_MAX_TASK; i++) {
+    if (!Sch_Get_Stat(i, &info) || info.stat.runCnt == 0) continue;
+    LOG_D("Task %d: %ld/%ld/%ld cyc, late %ld, overrun %ld", i,
+          info.stat.minCyc, (uint32_t)(info.stat.sumCyc / info.stat.runCnt),
+          info.stat.maxCyc, info.stat.maxLateCyc, info.stat.overrun);
   }
-  LOG_D("%s--- INFO END ---", str_buf);
 }
-
 #endif  // _ENABLE_SCH_DEBUG
 
+/**
+ * @brief 记录任务执行时间
+ * @param  task_p           任务
+ * @param  prio             优先级
+ * @param  start            开始时刻
+ * @param  rt               开始时的实时任务累计执行时间
+ */
+static void Sch_Stat_Exec(scheduler_task_t *task_p, uint8_t prio,
+                          uint64_t start, uint64_t rt) {
+  uint32_t exec;
+  sch_stat_t *stat = &task_p->stat;
+  SCH_LOCK_CODE {
+    // 后台任务的执行时间扣除期间被实时任务抢占的时间
+    exec = Sch_Sat32(Sch_Get_Cycles() - start - (sch_rt_cyc - rt));
+    if (prio == SCH_PRIO_RT) sch_rt_cyc += exec;
+    sch_busy_cyc += exec;
+    stat->runCnt++;
+    stat->sumCyc += exec;
+    if (exec < stat->minCyc) stat->minCyc = exec;
+    if (exec > stat->maxCyc) stat->maxCyc = exec;
+  }
+}
+
+/**
+ * @brief 运行一个到期任务
+ * @param  prio             优先级
+ * @retval uint8_t          1: 已运行, 0: 无到期任务
+ */
+static uint8_t Sch_Run_Once(uint8_t prio) {
+  sch_heap_t *h = &sch_heap[prio];
+  scheduler_task_t *task_p = NULL;
+  sch_stat_t *stat;
+  uint64_t now, late, rt;
+  float dt;
+  SCH_LOCK_CODE {
+    now = Sch_Get_Cycles();
+    if (h->num > 0 &&
+        (int64_t)(now - sch_pool[h->id[0]].nextRunCyc) >= 0) {
+      task_p = &sch_pool[h->id[0]];
+      late = now - task_p->nextRunCyc;
+      stat = &task_p->stat;
+      if (late > stat->maxLateCyc) stat->maxLateCyc = Sch_Sat32(late);
+      if (late >= task_p->periodCyc) stat->overrun++;
+      // 下次运行时刻只推进一个周期, 保持相位; 落后过多时整周期跳过
+      if (late >= task_p->periodCyc * SCH_MAX_CATCHUP) {
+        task_p->nextRunCyc += late / task_p->periodCyc * task_p->periodCyc;
+      }
+      task_p->nextRunCyc += task_p->periodCyc;
+      dt = (float)(now - task_p->lastRunCyc) / SystemCoreClock;
+      task_p->lastRunCyc = now;
+      rt = sch_rt_cyc;
+      // 先重排堆再运行, 任务中可安全地修改自身或其他任务
+      Sch_Heap_Down(h, 0);
+    }
+  }
+  if (task_p == NULL) return 0;
+  if (task_p->withDt) {
+    ((sch_func_dt_t)task_p->task)(dt);
+  } else {
+    task_p->task();
+  }
+  Sch_Stat_Exec(task_p, prio, now, rt);
+  return 1;
+}
+
+/**
+ * @brief 运行一个就绪的事件任务, 按就绪位图选出最高优先级
+ * @param  prio             优先级
+ * @retval uint8_t          1: 已运行, 0: 无就绪任务
+ */
+static uint8_t Sch_Run_Event(uint8_t prio) {
+  scheduler_task_t *task_p = NULL;
+  uint64_t now, rt;
+  uint32_t events, late;
+  uint8_t bit;
+  if (sch_ready[prio] == 0) return 0;
+  SCH_LOCK_CODE {
+    SAFE_ATOM_CODE {
+      if (sch_ready[prio]) {
+        bit = 31 - __CLZ(sch_ready[prio]);
+        sch_ready[prio] &= ~(1UL << bit);
+        task_p = &sch_pool[sch_evt_id[prio][bit]];
+        events = task_p->events;
+        task_p->events = 0;
+        task_p->posted = 0;
+        late = DWT->CYCCNT - task_p->postCyc;
+      }
+    }
+    if (task_p != NULL) {
+      now = Sch_Get_Cycles();
+      rt = sch_rt_cyc;
+      if (late > task_p->stat.maxLateCyc) task_p->stat.maxLateCyc = late;
+      task_p->lastRunCyc = now;
+    }
+  }
+  if (task_p == NULL) return 0;
+  ((sch_func_evt_t)task_p->task)(events);
+  Sch_Stat_Exec(task_p, prio, now, rt);
+  return 1;
+}
+
 /**
  * @brief scheduler runner, call in main loop
  * @retval None
  **/
 void Scheduler_Run(void) {
-  static uint32_t currentTime = 0;
+  uint64_t now, win;
 #if _ENABLE_SCH_DEBUG
-  static uint32_t _sch_debug_task_tick = 0;
   static uint32_t _last_show_debug_info_tick = 0;
 #endif  // _ENABLE_SCH_DEBUG
 
   while (1) {
-    if (schTaskEntry == NULL) continue;
-    if (task_p == NULL) task_p = schTaskEntry;
-    currentTime = HAL_GetTick();
-    if (task_p->enable &&
-        (currentTime - task_p->lastRunMs >= task_p->periodMs)) {
-      task_p->lastRunMs = currentTime;
-#if _ENABLE_SCH_DEBUG
-      _sch_debug_task_tick = HAL_GetTick();
-      task_p->task();
-      _sch_debug_task_tick = HAL_GetTick() - _sch_debug_task_tick;
-      if (task_p->task_consuming < _sch_debug_task_tick) {
-        task_p->task_consuming = _sch_debug_task_tick;
-      }
-#else
-      task_p->task();
-#endif  // _ENABLE_SCH_DEBUG
-    }
-    if (task_p != NULL) task_p = task_p->next;
 #if _ENABLE_SCH_DEBUG
-    currentTime = HAL_GetTick();
-    if (currentTime - _last_show_debug_info_tick >= _SCH_DEBUG_INFO_PERIOD) {
-      _last_show_debug_info_tick = currentTime;
+    if (HAL_GetTick() - _last_show_debug_info_tick >= _SCH_DEBUG_INFO_PERIOD) {
+      _last_show_debug_info_tick = HAL_GetTick();
       Print_Debug_info();
     }
 #endif  // _ENABLE_SCH_DEBUG
+    SCH_LOCK_CODE {
+      now = Sch_Get_Cycles();
+      win = now - sch_win_start;
+      if (win >= (uint64_t)SystemCoreClock / 1000 * SCH_LOAD_WINDOW_MS) {
+        sch_load = sch_busy_cyc * 10000 / win;
+        sch_busy_cyc = 0;
+        sch_win_start = now;
+      }
+    }
+    if (!Sch_Run_Event(SCH_PRIO_BG)) Sch_Run_Once(SCH_PRIO_BG);
+  }
+}
+
+/**
+ * @brief SysTick中断中调用, 有实时任务时触发PendSV
+ */
+void Sch_Tick_IRQ_Handler(void) {
+  if (sch_heap[SCH_PRIO_RT].num > 0) SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/**
+ * @brief PendSV中断中调用, 运行所有就绪和到期的实时任务, 事件任务优先
+ */
+__ITCM_CODE void Sch_PendSV_IRQ_Handler(void) {
+  while (Sch_Run_Event(SCH_PRIO_RT) || Sch_Run_Once(SCH_PRIO_RT)) {
   }
 }
 
+/**
+ * @brief 获取任务信息及运行统计
+ * @param  taskId           任务id
+ * @param  info             输出任务信息(拷贝)
+ * @retval uint8_t          1: 成功, 0: 任务不存在
+ */
+uint8_t Sch_Get_Stat(uint8_t taskId, scheduler_task_t *info) {
+  if (taskId >= SCH_MAX_TASK || !sch_pool[taskId].used) return 0;
+  SCH_LOCK_CODE { *info = sch_pool[taskId]; }
+  return 1;
+}
+
+/**
+ * @brief 清除任务运行统计
+ * @param  taskId           任务id, SCH_INVALID_ID清除全部
+ */
+void Sch_Reset_Stat(uint8_t taskId) {
+  if (taskId == SCH_INVALID_ID) {
+    for (uint8_t i = 0; i < SCH_MAX_TASK; i++) Sch_Reset_Stat(i);
+    return;
+  }
+  if (taskId >= SCH_MAX_TASK) return;
+  SCH_LOCK_CODE {
+    sch_pool[taskId].stat = (sch_stat_t){0};
+    sch_pool[taskId].stat.minCyc = UINT32_MAX;
+  }
+}
+
+/**
+ * @brief 获取上个统计窗口的CPU占用率(任务执行时间, 含其间的中断)
+ * @retval uint16_t         % * 100
+ */
+uint16_t Sch_Get_Load(void) { return sch_load; }
+
+/**
+ * @brief 获取任务按平均执行时间和运行频率估算的CPU占用率
+ * @param  taskId           任务id
+ * @retval uint16_t         % * 100
+ */
+uint16_t Sch_Get_Task_Load(uint8_t taskId) {
+  scheduler_task_t *p;
+  float load;
+  if (taskId >= SCH_MAX_TASK || !sch_pool[taskId].used) return 0;
+  p = &sch_pool[taskId];
+  if (p->stat.runCnt == 0) return 0;
+  load = (float)p->stat.sumCyc / p->stat.runCnt * p->rateHz /
+         SystemCoreClock * 10000;
+  return load > 10000 ? 10000 : load;
+}
+
 /**
  * @brief Enable a task by id
  * @param  taskId           Target task id
  */
 void _Enable_SchTask_Id(uint8_t taskId) {
-  scheduler_task_t *p = schTaskEntry;
-  while (p != NULL) {
-    if (p->taskId == taskId) {
-      p->enable = 1;
-      break;
-    }
-    p = p->next;
-  }
+  SCH_LOCK_CODE { Sch_Enable(taskId); }
 }
 
 /**
@@ -133,14 +546,7 @@ void _Enable_SchTask_Id(uint8_t taskId) {
  * @param  taskId            Target task id
  */
 void _Disable_SchTask_Id(uint8_t taskId) {
-  scheduler_task_t *p = schTaskEntry;
-  while (p != NULL) {
-    if (p->taskId == taskId) {
-      p->enable = 0;
-      break;
-    }
-    p = p->next;
-  }
+  SCH_LOCK_CODE { Sch_Disable(taskId); }
 }
 
 /**
@@ -148,13 +554,11 @@ void _Disable_SchTask_Id(uint8_t taskId) {
  * @param  task             Target task function
  * @note if multiple tasks have the same function, all of them will be enabled
  */
-void _Enable_SchTask_Func(void (*task)(void)) {
-  scheduler_task_t *p = schTaskEntry;
-  while (p != NULL) {
-    if (p->task == task) {
-      p->enable = 1;
+void _Enable_SchTask_Func(sch_func_t task) {
+  SCH_LOCK_CODE {
+    for (uint8_t i = 0; i < SCH_MAX_TASK; i++) {
+      if (sch_pool[i].used && sch_pool[i].task == task) Sch_Enable(i);
     }
-    p = p->next;
   }
 }
 
@@ -164,13 +568,11 @@ void _Enable_SchTask_Func(void (*task)(void)) {
  * @note if multiple tasks have the same function, all of them will be
  * disabled
  */
-void _Disable_SchTask_Func(void (*task)(void)) {
-  scheduler_task_t *p = schTaskEntry;
-  while (p != NULL) {
-    if (p->task == task) {
-      p->enable = 0;
+void _Disable_SchTask_Func(sch_func_t task) {
+  SCH_LOCK_CODE {
+    for (uint8_t i = 0; i < SCH_MAX_TASK; i++) {
+      if (sch_pool[i].used && sch_pool[i].task == task) Sch_Disable(i);
     }
-    p = p->next;
   }
 }
 
@@ -180,22 +582,7 @@ void _Disable_SchTask_Func(void (*task)(void)) {
  * @retval None
  */
 void _Del_SchTask_Id(uint8_t taskId) {
-  scheduler_task_t *p = schTaskEntry;
-  scheduler_task_t *q = NULL;
-  while (p != NULL) {
-    if (p->taskId == taskId) {
-      if (q == NULL) {
-        schTaskEntry = p->next;
-      } else {
-        q->next = p->next;
-      }
-      if (task_p == p) task_p = p->next;
-      free(p);
-      break;
-    }
-    q = p;
-    p = p->next;
-  }
+  SCH_LOCK_CODE { Sch_Del(taskId); }
 }
 
 /**
@@ -203,25 +590,11 @@ void _Del_SchTask_Id(uint8_t taskId) {
  * @param  task             task function
  * @retval None
  */
-void _Del_SchTask_Func(void (*task)(void)) {
-  scheduler_task_t *p = schTaskEntry;
-  scheduler_task_t *q = NULL;
-  scheduler_task_t *k = NULL;
-  while (p != NULL) {
-    if (p->task == task) {
-      if (q == NULL) {
-        schTaskEntry = p->next;
-      } else {
-        q->next = p->next;
-      }
-      if (task_p == p) task_p = p->next;
-      k = p->next;
-      free(p);
-      p = k;
-      continue;
+void _Del_SchTask_Func(sch_func_t task) {
+  SCH_LOCK_CODE {
+    for (uint8_t i = 0; i < SCH_MAX_TASK; i++) {
+      if (sch_pool[i].used && sch_pool[i].task == task) Sch_Del(i);
     }
-    q = p;
-    p = p->next;
   }
 }
 
@@ -231,18 +604,7 @@ void _Del_SchTask_Func(void (*task)(void)) {
  * @param  freq             Freq
  */
 void _Set_SchTask_Freq_Id(uint8_t taskId, float freq) {
-  scheduler_task_t *p = schTaskEntry;
-  while (p != NULL) {
-    if (p->taskId == taskId) {
-      p->rateHz = freq;
-      p->periodMs = 1000 / p->rateHz;
-      if (p->periodMs == 0) {
-        p->periodMs = 1;
-      }
-      break;
-    }
-    p = p->next;
-  }
+  SCH_LOCK_CODE { Sch_Set_Freq(taskId, freq); }
 }
 
 /**
@@ -250,17 +612,35 @@ void _Set_SchTask_Freq_Id(uint8_t taskId, float freq) {
  * @param  task             Task function
  * @param  freq             Freq
  */
-void _Set_SchTask_Freq_Func(void (*task)(void), float freq) {
-  scheduler_task_t *p = schTaskEntry;
-  while (p != NULL) {
-    if (p->task == task) {
-      p->rateHz = freq;
-      p->periodMs = 1000 / p->rateHz;
-      if (p->periodMs == 0) {
-        p->periodMs = 1;
-      }
+void _Set_SchTask_Freq_Func(sch_func_t task, float freq) {
+  SCH_LOCK_CODE {
+    for (uint8_t i = 0; i < SCH_MAX_TASK; i++) {
+      if (sch_pool[i].used && sch_pool[i].task == task) Sch_Set_Freq(i, freq);
+    }
+  }
+}
+
+/**
+ * @brief Set a task's priority level
+ * @param  taskId           Task ID
+ * @param  prio             SCH_PRIO_BG or SCH_PRIO_RT
+ * @note SCH_PRIO_RT tasks run in PendSV, triggered by SysTick, so their
+ * period is quantized to the 1ms tick
+ */
+void _Set_SchTask_Prio_Id(uint8_t taskId, uint8_t prio) {
+  SCH_LOCK_CODE { Sch_Set_Prio(taskId, prio); }
+}
+
+/**
+ * @brief Set a task's priority level
+ * @param  task             Task function
+ * @param  prio             SCH_PRIO_BG or SCH_PRIO_RT
+ */
+void _Set_SchTask_Prio_Func(sch_func_t task, uint8_t prio) {
+  SCH_LOCK_CODE {
+    for (uint8_t i = 0; i < SCH_MAX_TASK; i++) {
+      if (sch_pool[i].used && sch_pool[i].task == task) Sch_Set_Prio(i, prio);
     }
-    p = p->next;
   }
 }
 // debug functions
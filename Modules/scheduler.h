@@ -10,62 +10,104 @@
 #ifndef _SCHEDULER_H_
 #define _SCHEDULER_H_
 
+#include "candy.h"
 #include "main.h"
 //  defines
-#define _ENABLE_SCH_DEBUG 0
+#define _ENABLE_SCH_DEBUG 0          // 定期打印任务运行统计
 #define _SCH_DEBUG_INFO_PERIOD 5000  // ms
+#define SCH_LOAD_WINDOW_MS 500       // CPU占用率统计窗口, ms
+#define SCH_MAX_TASK 16              // 任务池容量(静态分配)
+#define SCH_INVALID_ID 0xFF          // 无效任务id
+#define SCH_MAX_CATCHUP 4  // 落后超过该周期数时跳过错过的周期(保持相位)
+
+// 优先级
+#define SCH_PRIO_BG 0  // 后台任务, 主循环中协作运行
+#define SCH_PRIO_RT 1  // 实时任务, PendSV中运行, 抢占后台任务
+#define SCH_PRIO_NUM 2
+// PendSV中断优先级, 低于SysTick(14)和所有外设中断, 实时任务中HAL_GetTick
+// 仍会增加, 但实时任务不应等待超时或打印日志
+#define SCH_RT_IRQ_PRIO 15
+#define SCH_EVT_PRIO_NUM 32  // 每个优先级内事件任务数上限(就绪位图宽度)
 
 // typedef
-typedef struct {       // 用户任务结构
-  void (*task)(void);  // task function
-  float rateHz;        // task rate
-  uint16_t periodMs;   // task period
-  uint32_t lastRunMs;  // last run time
-  uint8_t enable;      // enable or disable
-  uint8_t taskId;      // task id
-#if _ENABLE_SCH_DEBUG
-  uint32_t task_consuming;  // task consuming time
-#endif
-  void *next;  // next task
+typedef void (*sch_func_t)(void);                 // 普通任务
+typedef void (*sch_func_dt_t)(float dt);          // 带实测周期(s)的任务
+typedef void (*sch_func_evt_t)(uint32_t events);  // 事件任务, 参数为事件位
+
+typedef struct {        // 任务运行统计
+  uint32_t runCnt;      // 运行次数
+  uint32_t minCyc;      // 最短执行时间, DWT cycles
+  uint32_t maxCyc;      // 最长执行时间, DWT cycles
+  uint64_t sumCyc;      // 累计执行时间, DWT cycles
+  uint32_t maxLateCyc;  // 最大启动抖动(实际启动-应启动), DWT cycles
+                        // 事件任务为投递到运行的最大延迟
+  uint32_t overrun;     // 启动落后超过一个周期的次数
+                        // 事件任务为运行前被合并的重复投递次数
+} sch_stat_t;
+
+typedef struct {          // 用户任务结构
+  sch_func_t task;        // task function
+  float rateHz;           // task rate
+  uint64_t periodCyc;     // task period, DWT cycles
+  uint64_t nextRunCyc;    // next due time, DWT cycles
+  uint64_t lastRunCyc;    // last start time, DWT cycles
+  uint8_t withDt;         // task is sch_func_dt_t
+  uint8_t enable;         // enable or disable
+  uint8_t used;           // slot in use
+  uint8_t prio;           // priority level, SCH_PRIO_BG or SCH_PRIO_RT
+  uint8_t heapIdx;        // position in due-time heap, SCH_INVALID_ID if none
+  uint8_t evtBit;         // ready bitmap bit of event task, SCH_INVALID_ID if
+                          // periodic; higher bit runs first
+  __IO uint8_t posted;    // event posted, waiting to run
+  __IO uint32_t events;   // pending event bits
+  __IO uint32_t postCyc;  // DWT->CYCCNT at first post
+  sch_stat_t stat;        // runtime statistics
 } scheduler_task_t;
 // private variables
 
 // private functions
 
-uint8_t Add_SchTask(void (*task)(void), float rateHz, uint8_t enable);
+uint8_t Add_SchTask(sch_func_t task, float rateHz, uint8_t enable);
+uint8_t Add_SchTask_Dt(sch_func_dt_t task, float rateHz, uint8_t enable);
+uint8_t Add_SchEvent(sch_func_evt_t task, uint8_t prio, uint8_t evtPrio);
+void Sch_Post(uint8_t taskId, uint32_t events);
 void Scheduler_Run(void);
+uint64_t Sch_Get_Cycles(void);
+uint8_t Sch_Get_Stat(uint8_t taskId, scheduler_task_t *info);
+void Sch_Reset_Stat(uint8_t taskId);
+uint16_t Sch_Get_Load(void);
+uint16_t Sch_Get_Task_Load(uint8_t taskId);
+void Sch_Tick_IRQ_Handler(void);
+void Sch_PendSV_IRQ_Handler(void);
 
+// 按任务id(Add_SchTask等的返回值)或任务函数启用/禁用/删除任务, 修改频率和
+// 优先级; 带dt的任务按函数操作时转换为sch_func_t传入
 void _Enable_SchTask_Id(uint8_t taskId);
 void _Disable_SchTask_Id(uint8_t taskId);
-void _Enable_SchTask_Func(void (*task)(void));
-void _Disable_SchTask_Func(void (*task)(void));
+void _Enable_SchTask_Func(sch_func_t task);
+void _Disable_SchTask_Func(sch_func_t task);
 void _Del_SchTask_Id(uint8_t taskId);
-void _Del_SchTask_Func(void (*task)(void));
+void _Del_SchTask_Func(sch_func_t task);
 void _Set_SchTask_Freq_Id(uint8_t taskId, float freq);
-void _Set_SchTask_Freq_Func(void (*task)(void), float freq);
+void _Set_SchTask_Freq_Func(sch_func_t task, float freq);
+void _Set_SchTask_Prio_Id(uint8_t taskId, uint8_t prio);
+void _Set_SchTask_Prio_Func(sch_func_t task, uint8_t prio);
 
-// Enable a task by task id or task function
-#define Enable_SchTask(_OP)                \
-  _Generic((_OP), void (*)(void)           \
-           : _Enable_SchTask_Func, default \
-           : _Enable_SchTask_Id)(_OP)
-
-// Disable a task by task id or task function
-#define Disable_SchTask(_OP)                \
-  _Generic((_OP), void (*)(void)            \
-           : _Disable_SchTask_Func, default \
-           : _Disable_SchTask_Id)(_OP)
+/**
+ * @brief 锁定调度器, 屏蔽实时任务(PendSV), SysTick和外设中断不受影响
+ * @retval uint32_t         锁定前的BASEPRI, 交给Sch_Unlock恢复, 可嵌套
+ */
+static inline uint32_t Sch_Lock(void) {
+  uint32_t basepri = __get_BASEPRI();
+  __set_BASEPRI_MAX(SCH_RT_IRQ_PRIO << (8U - __NVIC_PRIO_BITS));
+  return basepri;
+}
 
-// Delete a task by task id or task function
-#define Del_SchTask(_OP)                \
-  _Generic((_OP), void (*)(void)        \
-           : _Del_SchTask_Func, default \
-           : _Del_SchTask_Id)(_OP)
+static inline void Sch_Unlock(uint32_t basepri) { __set_BASEPRI(basepri); }
 
-// Set task frequency by task id or task function
-#define Set_SchTask_Freq(_OP, _FREQ)       \
-  _Generic((_OP), , void (*)(void)         \
-           : _Set_SchTask_Freq_Id, default \
-           : _Set_SchTask_Freq_Id)(_OP, _FREQ)
+// 调度锁代码块, 后台任务访问与实时任务共享的数据时使用, 块内不可return
+#define SCH_LOCK_CODE                             \
+  using(uint32_t SAFE_NAME(basepri) = Sch_Lock(), \
+        Sch_Unlock(SAFE_NAME(basepri)))
 
 #endif  // _SCHEDULER_H_
@@ -12,6 +12,49 @@
 
 #include "uart_pack.h"
 
+static step_ctrl_t *step_list[STEP_MAX_NUM];  // 已初始化的步进电机
+static uint8_t step_num = 0;
+static step_ctrl_t *group_list[STEP_MAX_NUM];  // 等待同步启动的步进电机
+static uint8_t group_num = 0;
+static uint8_t group_active = 0;
+static uint32_t sync_skew_ns = 0;  // 最近一次启动时首末轴的启动偏差
+static step_ctrl_t *step_irq_table[STEP_IRQ_TABLE_SIZE];  // 中断号->电机
+
+// DMA读取的ARR表, 控制结构体位于DTCM(DMA1/2无法访问), 表单独放在不可缓存区
+typedef struct {
+  uint16_t acc[STEP_RAMP_TABLE_SIZE];
+  uint16_t dec[STEP_RAMP_TABLE_SIZE];
+  uint16_t profile[STEP_PROFILE_CHUNK * 2];
+} step_dma_buf_t;
+static step_dma_buf_t step_dma_buf[STEP_MAX_NUM] __DMA_BUFFER;
+#define STEP_RAMP_BUILDING 2  // rampStale: 加减速表正在重新生成
+#if STEP_IRQ_PROFILE
+uint32_t step_irq_cyc_start = 0;         // 进入中断时的DWT周期计数
+static uint32_t step_irq_cycles = 0;     // 最近一次中断分发周期数
+static uint32_t step_irq_cycles_max = 0;  // 中断分发最大周期数
+#endif
+
+static uint8_t Step_Queue_Blend(step_ctrl_t *step);
+static uint8_t Step_Queue_Pop(step_ctrl_t *step);
+static uint16_t Step_Ramp_Index(step_ctrl_t *step, uint32_t done);
+static uint8_t Step_Replan_Exit(step_ctrl_t *step, uint16_t exit);
+
+/**
+ * @brief 从定时器实例对应的中断号
+ * @param  tim              从定时器实例
+ * @retval IRQn_Type        中断号, 不支持时为-1
+ */
+static IRQn_Type Step_Slave_IRQn(TIM_TypeDef *tim) {
+  if (tim == TIM2) return TIM2_IRQn;
+  if (tim == TIM3) return TIM3_IRQn;
+  if (tim == TIM4) return TIM4_IRQn;
+  if (tim == TIM5) return TIM5_IRQn;
+  if (tim == TIM15) return TIM15_IRQn;
+  if (tim == TIM16) return TIM16_IRQn;
+  if (tim == TIM17) return TIM17_IRQn;
+  return (IRQn_Type)-1;
+}
+
 /**
  * @brief 初始化步进电机
  * @param  step             步进电机控制结构体
@@ -25,13 +68,55 @@
 void Step_Init(step_ctrl_t *step, TIM_HandleTypeDef *timMaster,
                TIM_HandleTypeDef *timSlave, uint32_t timMasterCh,
                GPIO_TypeDef *dirPort, uint16_t dirPin, uint8_t dirLogic) {
-  step->speed = 0;
-  step->angle = 0;
-  step->angleTarget = 0;
+  IRQn_Type irqn;
+  ASSERT(step_num < STEP_MAX_NUM, "[STEP] too many steps", return);
+  step->speedSet = 0;
+  step->speedCfg.psc = 1;
+  step->speedCfg.arr = 0;
+  step->speedCfg.rampLen = 0;
+  step->speedCfg.mode = STEP_MODE_CONST;
+  step->pos = 0;
+  step->posTarget = 0;
   step->rotating = 0;
   step->dir = 0;
   step->slaveTimReload = 0;
   step->slaveTimITCnt = 0;
+  step->slaveTimSplit = 0;
+  // 32位从定时器(TIM2/TIM5)一次计完, 16位从定时器(TIM3)分段计数
+  step->slaveTimMaxCnt =
+      IS_TIM_32B_COUNTER_INSTANCE(timSlave->Instance) ? 0xFFFFFFFF : 0xFFFF;
+  step->slaveTimBase = 0;
+  step->accel = 0;
+  step->jerk = 0;
+  step->mode = STEP_MODE_CONST;
+  step->rampLen = 0;
+  step->rampMax = 0;
+  step->rampAccel = 0;
+  step->rampStale = 0;
+  step->rampCrossArr = 0;
+  step->rampPsc = 1;
+  step->cruiseArr = 0;
+  step->decelPulse = 0;
+  step->decelLen = 0;
+  step->decelIdx = 0;
+  step->exitIdx = 0;
+  step->rampEntry = 0;
+  step->rampPeak = 0;
+  step->rampAccLen = 0;
+  step->rampBase = 0;
+  step->pulseTotal = 0;
+  step->jog = 0;
+  step->jogVel = 0;
+  step->stream = 0;
+  step->rampDirty = 0;
+  step->paused = 0;
+  step->estop = 0;
+  step->pauseTarget = 0;
+  step->pauseVel = 0;
+  step->queueHead = 0;
+  step->queueTail = 0;
+  step->planDirty = 0;
+  step->posQueued = 0;
   step->timMaster = timMaster;
   step->timSlave = timSlave;
   step->timMasterCh = timMasterCh;
@@ -40,150 +125,1598 @@ void Step_Init(step_ctrl_t *step, TIM_HandleTypeDef *timMaster,
   step->dirLogic = dirLogic;
   __HAL_TIM_SET_COUNTER(step->timMaster, 0);
   __HAL_TIM_SET_COUNTER(step->timSlave, 0);
+  // ARR预装载, 保证DMA写入的周期从下一个脉冲开始生效
+  step->timMaster->Instance->CR1 |= TIM_CR1_ARPE;
+  // DWT周期计数器用于测量多轴同步启动偏差
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->LAR = 0xC5ACCE55;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  step->rampAccTable = step_dma_buf[step_num].acc;
+  step->rampDecTable = step_dma_buf[step_num].dec;
+  step->profileBuf = step_dma_buf[step_num].profile;
+  step_list[step_num++] = step;
+  irqn = Step_Slave_IRQn(timSlave->Instance);
+  ASSERT(irqn >= 0 && irqn < STEP_IRQ_TABLE_SIZE, "[STEP] unknown slave IRQ",
+         return);
+  step_irq_table[irqn] = step;
+}
+
+/**
+ * @brief 按设定加速度生成加减速ARR表, 第i项为从静止开始第i个脉冲的周期
+ * @param  step             步进电机控制结构体
+ * @note 表与速度无关, 一直生成到最高频率; 只在未转动时于线程中调用,
+ * 运动段的匀速段周期在装载时写入加速表(Step_Speed_Load)
+ */
+static void Step_Ramp_Build(step_ctrl_t *step) {
+  double tickFreq = (double)STEP_TIM_BASE_CLK / STEP_RAMP_PSC;
+  step->rampLen = 0;  // 表重新生成, 不需要恢复被替换的周期
+  step->rampDirty = 0;
+  step->rampMax = 0;
+  step->rampAccel = step->accel;
+  if (step->accel <= 0 || step->jerk > 0) return;  // S曲线不需要加速表
+  step->rampMax = Ramp_Build(step->rampAccTable, STEP_RAMP_TABLE_SIZE,
+                             step->accel, tickFreq,
+                             tickFreq / STEP_PWM_MAX_FREQ);
+  for (uint16_t i = 0; i < step->rampMax; i++)
+    step->rampDecTable[i] = step->rampAccTable[step->rampMax - 1 - i];
+}
+
+/**
+ * @brief 求解频率误差最小的分频系数与重装载值
+ * @param  freq             目标频率
+ * @param  psc              输出分频系数(PSC+1)
+ * @param  arr              输出周期计数值(ARR+1)
+ * @retval double           实际频率
+ * @note 总分频 n = CLK / freq, 取ARR不溢出的最小分频系数使ARR最大
+ * (占空比分辨率最高), 再与相邻两个分频系数比较取整误差, 无迭代
+ */
+static double Step_Solve_Div(double freq, uint32_t *psc, uint32_t *arr) {
+  double n = (double)STEP_TIM_BASE_CLK / freq;
+  double err, errMin = n;
+  uint32_t p, a, pMin = ceil(n / 0x10000);
+  if (pMin < 1) pMin = 1;
+  *psc = pMin;
+  *arr = 2;
+  for (p = pMin; p < pMin + 3 && p <= 0x10000; p++) {
+    a = n / p + 0.5;
+    if (a < 2) a = 2;
+    if (a > 0x10000) a = 0x10000;
+    err = fabs((double)p * a - n);
+    if (err < errMin) {
+      errMin = err;
+      *psc = p;
+      *arr = a;
+    }
+  }
+  return (double)STEP_TIM_BASE_CLK / ((double)*psc * *arr);
+}
+
+/**
+ * @brief 求解速度对应的主定时器配置, 在线程中调用
+ * @param  step             步进电机控制结构体
+ * @param  speed            速度(单位:脉冲/秒), 已限制在最高频率以内
+ * @param  cfg              输出配置
+ * @retval double           实际匀速段频率
+ * @note 低于加速表起步频率的速度直接匀速运行
+ */
+static double Step_Speed_Solve(step_ctrl_t *step, double speed,
+                               step_speed_t *cfg) {
+  double tickFreq = (double)STEP_TIM_BASE_CLK / STEP_RAMP_PSC;
+  uint32_t ticks = tickFreq / speed + 0.5, psc, period;
+  uint16_t idx;
+  uint8_t scurve = step->accel > 0 && step->jerk > 0;
+  cfg->rampLen = 0;
+  if ((scurve || step->rampMax > 0) && ticks <= 0x10000) {
+    cfg->psc = STEP_RAMP_PSC;
+    cfg->arr = ticks - 1;
+    cfg->mode = STEP_MODE_SCURVE;
+    if (scurve) return tickFreq / ticks;
+    cfg->mode = STEP_MODE_TRAPZ;
+    idx = Ramp_Find(step->rampAccel, tickFreq, step->rampMax, ticks);
+    if (idx >= step->rampMax) {  // 表长不足以加速到目标速度
+      idx = step->rampMax - 1;
+      cfg->arr = Ramp_Ticks(step->rampAccel, tickFreq, idx) - 1;
+      LOG_W("[STEP] ramp table full, speed limited");
+    }
+    cfg->rampLen = idx + 1;
+    return tickFreq / (cfg->arr + 1);
+  }
+  speed = Step_Solve_Div(speed, &psc, &period);
+  cfg->psc = psc;
+  cfg->arr = period - 1;
+  cfg->mode = STEP_MODE_CONST;
+  return speed;
+}
+
+/**
+ * @brief 装载运动段的速度配置, 只有整数写入, 可在完成中断中调用
+ * @param  step             步进电机控制结构体
+ * @param  cfg              速度配置
+ * @note 梯形加减速把匀速段周期写入加速表第rampLen项(及减速表对应项),
+ * 加速段的最后一个周期即为匀速段周期; 调用时DMA不能正在读取加速表
+ */
+__ITCM_CODE static void Step_Speed_Load(step_ctrl_t *step,
+                                        const step_speed_t *cfg) {
+  if (step->rampLen > 0) {  // 恢复上一次替换的周期
+    step->rampAccTable[step->rampLen - 1] = step->rampCrossArr;
+    step->rampDecTable[step->rampMax - step->rampLen] = step->rampCrossArr;
+  }
+  step->mode = cfg->mode;
+  step->rampPsc = cfg->psc;
+  step->cruiseArr = cfg->arr;
+  step->rampLen = cfg->mode == STEP_MODE_TRAPZ ? cfg->rampLen : 0;
+  if (step->rampLen > 0) {
+    step->rampCrossArr = step->rampAccTable[step->rampLen - 1];
+    step->rampAccTable[step->rampLen - 1] = cfg->arr;
+    step->rampDecTable[step->rampMax - step->rampLen] = cfg->arr;
+  }
+}
+
+/**
+ * @brief 重新生成S曲线DMA缓冲区中已被读取的一半
+ * @param  hdma             DMA句柄
+ * @param  half             0: 前一半, 1: 后一半
+ */
+__ITCM_CODE static void Step_Profile_Refill(DMA_HandleTypeDef *hdma,
+                                             uint8_t half) {
+  for (uint8_t i = 0; i < step_num; i++) {
+    step_ctrl_t *step = step_list[i];
+    if (step->timMaster->hdma[TIM_DMA_ID_UPDATE] != hdma) continue;
+    SCurve_Fill(&step->scurve, &step->profileBuf[half * STEP_PROFILE_CHUNK],
+                STEP_PROFILE_CHUNK);
+    return;
+  }
+}
+
+static void Step_Profile_HalfCplt(DMA_HandleTypeDef *hdma) {
+  Step_Profile_Refill(hdma, 0);
+}
+
+static void Step_Profile_Cplt(DMA_HandleTypeDef *hdma) {
+  Step_Profile_Refill(hdma, 1);
+}
+
+/**
+ * @brief 启动主定时器更新事件DMA, 每个脉冲结束时写入下一个ARR
+ * @param  step             步进电机控制结构体
+ * @param  table            ARR表
+ * @param  len              表长度
+ * @param  circular         循环模式(S曲线双缓冲)
+ */
+static void Step_Ramp_DMA_Start(step_ctrl_t *step, uint16_t *table,
+                                uint32_t len, uint8_t circular) {
+  DMA_HandleTypeDef *hdma = step->timMaster->hdma[TIM_DMA_ID_UPDATE];
+  ASSERT(hdma != NULL, "[STEP] no ramp DMA", return);
+  if (hdma->State != HAL_DMA_STATE_READY) HAL_DMA_Abort(hdma);
+  // HAL只在初始化时配置CIRC位, 此处数据流已关闭, 直接修改
+  if (circular) {
+    hdma->Init.Mode = DMA_CIRCULAR;
+    ((DMA_Stream_TypeDef *)hdma->Instance)->CR |= DMA_SxCR_CIRC;
+    hdma->XferHalfCpltCallback = Step_Profile_HalfCplt;
+    hdma->XferCpltCallback = Step_Profile_Cplt;
+  } else {
+    hdma->Init.Mode = DMA_NORMAL;
+    ((DMA_Stream_TypeDef *)hdma->Instance)->CR &= ~DMA_SxCR_CIRC;
+    hdma->XferHalfCpltCallback = NULL;
+    hdma->XferCpltCallback = NULL;
+  }
+  HAL_DMA_Start_IT(hdma, (uint32_t)table,
+                   (uint32_t)&step->timMaster->Instance->ARR, len);
+  __HAL_TIM_ENABLE_DMA(step->timMaster, TIM_DMA_UPDATE);
+}
+
+/**
+ * @brief 停止加减速DMA
+ * @param  step             步进电机控制结构体
+ */
+static void Step_Ramp_Halt(step_ctrl_t *step) {
+  DMA_HandleTypeDef *hdma = step->timMaster->hdma[TIM_DMA_ID_UPDATE];
+  __HAL_TIM_DISABLE_IT(step->timSlave, TIM_IT_CC2);
+  __HAL_TIM_DISABLE_DMA(step->timMaster, TIM_DMA_UPDATE);
+  if (hdma != NULL && hdma->State != HAL_DMA_STATE_READY) HAL_DMA_Abort(hdma);
+}
+
+/**
+ * @brief 开始减速段
+ * @param  step             步进电机控制结构体
+ */
+static void Step_Ramp_Decel(step_ctrl_t *step) {
+  uint16_t *table = &step->rampDecTable[step->decelIdx];
+  __HAL_TIM_DISABLE_IT(step->timSlave, TIM_IT_CC2);
+  if (step->decelLen == 0) return;  // 以最高速度衔接下一段
+  __HAL_TIM_SET_AUTORELOAD(step->timMaster, table[0]);
+  if (step->decelLen > 1)
+    Step_Ramp_DMA_Start(step, table + 1, step->decelLen - 1, 0);
+}
+
+/**
+ * @brief 若减速点落在当前从定时器计数段内, 用CC2比较中断触发减速
+ * @param  step             步进电机控制结构体
+ */
+static void Step_Ramp_Arm_Decel(step_ctrl_t *step) {
+  uint32_t offset;
+  if (step->mode != STEP_MODE_TRAPZ) return;  // S曲线减速已在序列中
+  if (step->decelPulse < step->slaveTimBase) return;
+  offset = step->decelPulse - step->slaveTimBase;
+  if (offset == 0) {
+    Step_Ramp_Decel(step);
+  } else if (offset <= __HAL_TIM_GET_AUTORELOAD(step->timSlave)) {
+    __HAL_TIM_SET_COMPARE(step->timSlave, TIM_CHANNEL_2, offset);
+    __HAL_TIM_CLEAR_FLAG(step->timSlave, TIM_FLAG_CC2);
+    __HAL_TIM_ENABLE_IT(step->timSlave, TIM_IT_CC2);
+  }
+}
+
+/**
+ * @brief 装载加速段, 在启动定时器前调用
+ * @param  step             步进电机控制结构体
+ * @param  pulse            总脉冲数
+ * @param  entry            入口速度(加速表下标, 0为静止起步)
+ * @param  exit             出口速度(加速表下标, 0为减速到静止)
+ * @note 加速表下标n对应从静止匀加速n个脉冲后的速度, 每个脉冲下标变化1,
+ * 入口大于0时定时器仍在运行, 只写入预装载寄存器, 不产生更新事件;
+ * 入口高于匀速段(运动中降低了速度)时先沿减速表减速到匀速段;
+ * 脉宽固定为STEP_RAMP_PULSE, 降速衔接时不会超过正在运行的周期
+ */
+static void Step_Ramp_Prepare(step_ctrl_t *step, uint32_t pulse,
+                              uint16_t entry, uint16_t exit) {
+  uint32_t peak, accLen;
+  uint16_t *table = &step->rampAccTable[entry];
+  if (step->rampDirty) {  // 减速表被限距停止改写过, 重新镜像
+    for (uint16_t i = 0; i < step->rampMax; i++)
+      step->rampDecTable[i] = step->rampAccTable[step->rampMax - 1 - i];
+    step->rampDirty = 0;
+  }
+  if (entry > exit + pulse) exit = entry - pulse;  // 减速距离不足
+  if (exit > entry + pulse) exit = entry + pulse;  // 加速距离不足
+  peak = (pulse + entry + exit) / 2;
+  if (peak > step->rampLen) peak = step->rampLen;
+  accLen = entry > peak ? entry - peak : peak - entry;
+  step->rampEntry = entry;
+  step->rampPeak = peak;
+  step->rampAccLen = accLen;
+  step->rampBase = 0;
+  step->decelLen = peak - exit;
+  step->decelIdx = step->rampMax - peak;
+  step->decelPulse = pulse - step->decelLen;
+  step->exitIdx = exit;
+  if (entry > 0) {  // 衔接上一段, 下一个脉冲开始使用新的周期
+    // PSC/CCR同样带预装载, 与ARR在同一个更新事件生效
+    __HAL_TIM_SET_PRESCALER(step->timMaster, step->rampPsc - 1);
+    __HAL_TIM_SET_COMPARE(step->timMaster, step->timMasterCh, STEP_RAMP_PULSE);
+    if (entry > peak) {  // 从减速表中入口速度处开始减速到匀速段
+      table = &step->rampDecTable[step->rampMax - entry];
+      __HAL_TIM_SET_AUTORELOAD(step->timMaster, table[0]);
+      Step_Ramp_DMA_Start(step, table + 1, accLen, 0);
+    } else if (accLen == 0) {
+      __HAL_TIM_SET_AUTORELOAD(step->timMaster, step->rampAccTable[peak - 1]);
+    } else {
+      __HAL_TIM_SET_AUTORELOAD(step->timMaster, table[0]);
+      if (accLen > 1) Step_Ramp_DMA_Start(step, table + 1, accLen - 1, 0);
+    }
+    return;
+  }
+  __HAL_TIM_SET_PRESCALER(step->timMaster, step->rampPsc - 1);
+  __HAL_TIM_SET_AUTORELOAD(step->timMaster, table[0]);
+  __HAL_TIM_SET_COMPARE(step->timMaster, step->timMasterCh, STEP_RAMP_PULSE);
+  step->timMaster->Instance->EGR = TIM_EGR_UG;  // 立即装载PSC/ARR
+  // 预装载寄存器写入第二个周期, DMA从第三个周期开始接管
+  if (accLen > 1) {
+    __HAL_TIM_SET_AUTORELOAD(step->timMaster, table[1]);
+    if (accLen > 2) Step_Ramp_DMA_Start(step, table + 2, accLen - 2, 0);
+  }
+}
+
+/**
+ * @brief 规划S曲线并装载前两个周期, 之后由循环DMA双缓冲实时续写
+ * @param  step             步进电机控制结构体
+ * @param  pulse            总脉冲数
+ */
+static void Step_SCurve_Prepare(step_ctrl_t *step, uint32_t pulse) {
+  uint16_t arr[2];
+  double tickFreq = (double)STEP_TIM_BASE_CLK / step->rampPsc;
+  SCurve_Plan(&step->scurve, pulse, tickFreq / (step->cruiseArr + 1),
+              step->accel, step->jerk, tickFreq, 0x10000);
+  SCurve_Fill(&step->scurve, arr, 2);
+  __HAL_TIM_SET_PRESCALER(step->timMaster, step->rampPsc - 1);
+  __HAL_TIM_SET_AUTORELOAD(step->timMaster, arr[0]);
+  __HAL_TIM_SET_COMPARE(step->timMaster, step->timMasterCh,
+                        (step->cruiseArr + 1) / 2);
+  step->timMaster->Instance->EGR = TIM_EGR_UG;  // 立即装载PSC/ARR
+  __HAL_TIM_SET_AUTORELOAD(step->timMaster, arr[1]);
+  SCurve_Fill(&step->scurve, step->profileBuf, STEP_PROFILE_CHUNK * 2);
+  Step_Ramp_DMA_Start(step, step->profileBuf, STEP_PROFILE_CHUNK * 2, 1);
 }
 
 /**
  * @brief 设置步进电机速度
  * @param  step             步进电机控制结构体
- * @param  speed            速度(单位:度/秒)
+ * @param  speed            速度(单位:脉冲/秒), 等价于pwm频率
+ * @note 只求解配置, 之后开始的运动段使用; 运动中改变速度见Step_Retarget
  */
 void Step_Set_Speed(step_ctrl_t *step, double speed) {
   ASSERT(speed < -0.01 || speed > 0.01, "[STEP] setspeed=0", return);
-  speed = fabs(speed);
-  double pulsePerSec = speed / 360 * STEP_PULSE_PER_ROUND;  // 等价于pwm频率
-  if (pulsePerSec > STEP_PWM_MAX_FREQ) {
-    pulsePerSec = STEP_PWM_MAX_FREQ;
-    speed = pulsePerSec / STEP_PULSE_PER_ROUND * 360;
+  double pulsePerSec = fabs(speed);
+  if (pulsePerSec > STEP_PWM_MAX_FREQ) pulsePerSec = STEP_PWM_MAX_FREQ;
+  step->speedSet = pulsePerSec;
+  Step_Speed_Solve(step, pulsePerSec, &step->speedCfg);
+}
+
+/**
+ * @brief 获取步进电机速度
+ * @param  step             步进电机控制结构体
+ * @retval double           转动时为当前运动段的匀速段频率, 否则为设定速度
+ * 的实际频率, 单位:脉冲/秒
+ */
+double Step_Get_Speed(step_ctrl_t *step) {
+  uint32_t psc, arr;
+  uint8_t off;
+  SAFE_ATOM_CODE {
+    if (step->rotating) {
+      psc = step->rampPsc;
+      arr = step->cruiseArr;
+      off = step->stream &&
+            !(step->timMaster->Instance->CR1 & TIM_CR1_CEN);
+    } else {
+      psc = step->speedCfg.psc;
+      arr = step->speedCfg.arr;
+      off = step->speedSet <= 0;
+    }
   }
-  uint32_t prescaler = STEP_TIM_BASE_CLK / pulsePerSec / 2;
-  uint16_t period = 2;
-  while (prescaler > 0xFFFF) {
-    prescaler /= 2;
-    period *= 2;
+  if (off) return 0;
+  return (double)STEP_TIM_BASE_CLK / ((double)psc * (arr + 1));
+}
+
+/**
+ * @brief 按新的加速度/加加速度重新生成加速表, 并重新求解速度配置
+ * @param  step             步进电机控制结构体
+ * @note 暂停停止后队列中的段同样重新求解, 需在未转动时调用; 生成期间
+ * 再次设置的加速度保留标记, 下次规划任务中重新生成
+ */
+static void Step_Kinematics_Update(step_ctrl_t *step) {
+  step->rampStale = STEP_RAMP_BUILDING;
+  Step_Ramp_Build(step);
+  if (step->speedSet > 0) Step_Set_Speed(step, step->speedSet);
+  for (uint8_t i = step->queueHead; i != step->queueTail; i++) {
+    step_seg_t *seg = &step->queue[i % STEP_QUEUE_SIZE];
+    Step_Speed_Solve(step, seg->speed, &seg->spd);
+    seg->planned = 0;
+  }
+  step->planDirty = 1;
+  SAFE_ATOM_CODE {
+    if (step->rampStale == STEP_RAMP_BUILDING) step->rampStale = 0;
+  }
+}
+
+/**
+ * @brief 设置步进电机加速度, 启停时按梯形曲线加减速
+ * @param  step             步进电机控制结构体
+ * @param  accel            加速度(单位:脉冲/秒^2), 0为不加减速
+ * @note 可在中断中调用, 加速表由Step_Planner_Task重新生成
+ */
+void Step_Set_Accel(step_ctrl_t *step, double accel) {
+  ASSERT(!step->rotating, "[STEP] In busy", return);
+  step->accel = fabs(accel);
+  step->rampStale = 1;
+}
+
+/**
+ * @brief 设置步进电机加加速度, 启停时按七段式S曲线加减速
+ * @param  step             步进电机控制结构体
+ * @param  jerk             加加速度(单位:脉冲/秒^3), 0为梯形加减速
+ * @note 需同时设置加速度才生效; 可在中断中调用, 加速表由
+ * Step_Planner_Task重新生成
+ */
+void Step_Set_Jerk(step_ctrl_t *step, double jerk) {
+  ASSERT(!step->rotating, "[STEP] In busy", return);
+  step->jerk = fabs(jerk);
+  step->rampStale = 1;
+}
+
+/**
+ * @brief 从定时器计数溢出(CC1标志)处理
+ * @param  step             步进电机控制结构体
+ */
+__ITCM_CODE static void Step_On_Wrap(step_ctrl_t *step) {
+  int64_t wrap;
+  if (step->rotating && step->jog) {  // 连续运动, 溢出只累计位置
+    wrap = (int64_t)__HAL_TIM_GET_AUTORELOAD(step->timSlave) + 1;
+    step->pos = step->dir ? step->pos + wrap : step->pos - wrap;
+  } else if (step->rotating) {
+    if (step->slaveTimITCnt == 0) {  // 旋转结束
+      step->pos = step->posTarget;
+      if (Step_Queue_Blend(step)) return;  // 不停止, 直接衔接下一段
+      HAL_TIM_PWM_Stop_IT(step->timMaster, step->timMasterCh);
+      HAL_TIM_Base_Stop_IT(step->timSlave);
+      Step_Ramp_Halt(step);
+      step->rotating = 0;
+      if (Step_Queue_Pop(step)) return;  // 从静止启动下一段
+      // 暂停或等待重新生成加速表时队列未执行完, 不算完成
+      if (step->queueHead != step->queueTail) return;
+      Step_Finished_Callback(step);
+#if STEP_IRQ_PROFILE
+      LOG_D("[STEP] Stop, irq dispatch %d cycles (max %d)", step_irq_cycles,
+            step_irq_cycles_max);
+#else
+      LOG_D("[STEP] Stop");
+#endif
+      return;
+    } else {  // 从定时器溢出
+      step->slaveTimBase += __HAL_TIM_GET_AUTORELOAD(step->timSlave) + 1;
+      step->slaveTimITCnt--;
+      if (step->slaveTimITCnt == 0)  // 最后一段
+        __HAL_TIM_SET_AUTORELOAD(step->timSlave, step->slaveTimReload);
+      else if (step->slaveTimITCnt == 1 && step->slaveTimSplit)
+        __HAL_TIM_SET_AUTORELOAD(step->timSlave, step->slaveTimMaxCnt - 1);
+      Step_Ramp_Arm_Decel(step);
+    }
   }
-  // LOG_D("Step_Set_Speed: speed = %f, pwmFreq = %f, PSC = %d, ARR = %d",
-  // speed,
-  //       pulsePerSec, prescaler, period);
-  __HAL_TIM_SET_PRESCALER(step->timMaster, prescaler - 1);
-  __HAL_TIM_SET_AUTORELOAD(step->timMaster, period - 1);
-  __HAL_TIM_SET_COMPARE(step->timMaster, step->timMasterCh, period / 2);
-  __HAL_TIM_SET_COUNTER(step->timMaster, 0);  // 重置计数器
-  step->speed = speed;
 }
 
 /**
- * @brief 在从定时器中断中调用
+ * @brief 记录从进入中断到开始处理的周期数
+ */
+static inline void Step_IRQ_Profile_End(void) {
+#if STEP_IRQ_PROFILE
+  step_irq_cycles = DWT->CYCCNT - step_irq_cyc_start;
+  if (step_irq_cycles > step_irq_cycles_max)
+    step_irq_cycles_max = step_irq_cycles;
+#endif
+}
+
+/**
+ * @brief 在从定时器中断中调用(经HAL回调分发)
  * @param  step             步进电机控制结构体
  * @param  htim             中断定时器句柄
  */
-void Step_IT_Handler(step_ctrl_t *step, TIM_HandleTypeDef *htim) {
+__ITCM_CODE void Step_IT_Handler(step_ctrl_t *step, TIM_HandleTypeDef *htim) {
   if (htim->Instance == step->timSlave->Instance) {
+    Step_IRQ_Profile_End();
+    if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_2) {  // 到达减速点
+      if (step->rotating) Step_Ramp_Decel(step);
+      return;
+    }
     if (__HAL_TIM_GET_FLAG(step->timSlave, TIM_FLAG_CC1) != RESET) {
       __HAL_TIM_CLEAR_FLAG(step->timSlave, TIM_FLAG_CC1);
-      if (step->rotating) {
-        if (step->slaveTimITCnt == 0) {  // 旋转结束
-        LRotateFinish:
-          HAL_TIM_PWM_Stop_IT(step->timMaster, step->timMasterCh);
-          HAL_TIM_Base_Stop_IT(step->timSlave);
-          step->rotating = 0;
-          step->angle = step->angleTarget;
-          LOG_D("[STEP] Stop");
-          return;
-        } else {  // 从定时器溢出
-          step->slaveTimITCnt--;
-          if (step->slaveTimITCnt == 0) {  // 不存在下一次溢出
-            if (step->slaveTimReload != 0) {
-              __HAL_TIM_SET_AUTORELOAD(step->timSlave, step->slaveTimReload);
-            } else {
-              goto LRotateFinish;
-            }
-          }
-        }
-      }
+      Step_On_Wrap(step);
+    }
+  }
+}
+
+/**
+ * @brief 从定时器中断直接分发, 在TIMx_IRQHandler中调用, 不经过HAL
+ * @param  irqn             中断号
+ * @note 按中断号查表得到控制结构体, 直接读写SR清除标志;
+ * 只处理步进驱动使能的更新和CC2中断
+ */
+__ITCM_CODE void Step_IRQ_Handler(IRQn_Type irqn) {
+  step_ctrl_t *step = step_irq_table[irqn];
+  TIM_TypeDef *tim;
+  uint32_t sr;
+  if (step == NULL) return;
+  Step_IRQ_Profile_End();
+  tim = step->timSlave->Instance;
+  sr = tim->SR;
+  if ((sr & TIM_SR_CC2IF) && (tim->DIER & TIM_DIER_CC2IE)) {  // 到达减速点
+    tim->SR = ~(uint32_t)TIM_SR_CC2IF;
+    if (step->rotating) Step_Ramp_Decel(step);
+  }
+  if (sr & TIM_SR_UIF) {
+    tim->SR = ~(uint32_t)TIM_SR_UIF;
+    if (sr & TIM_SR_CC1IF) {
+      tim->SR = ~(uint32_t)TIM_SR_CC1IF;
+      Step_On_Wrap(step);
     }
   }
 }
 
 /**
- * @brief 旋转步进电机
+ * @brief 按step->dir输出方向控制引脚
  * @param  step             步进电机控制结构体
- * @param  angle            旋转角度(单位:度)(正数:顺时针, 负数:逆时针)
  */
-void Step_Rotate(step_ctrl_t *step, double angle) {
-  ASSERT(!step->rotating, "[STEP] In busy", return);
-  step->dir = angle > 0 ? 1 : 0;
+static void Step_Write_Dir(step_ctrl_t *step) {
   if (!step->dirLogic)
     HAL_GPIO_WritePin(step->dirPort, step->dirPin,
                       step->dir ? GPIO_PIN_RESET : GPIO_PIN_SET);
   else
     HAL_GPIO_WritePin(step->dirPort, step->dirPin,
                       step->dir ? GPIO_PIN_SET : GPIO_PIN_RESET);
-  angle = fabs(angle);
-  uint32_t targetPulse = angle * STEP_PULSE_PER_ROUND / 360;
-  ASSERT(targetPulse > 1, "[STEP] targetPulse<2", return);
-  // step->angleTarget = step->angle + angle; // 存在累加误差
-  step->angleTarget = (double)targetPulse * 360 / STEP_PULSE_PER_ROUND;
-  step->angleTarget = step->dir ? step->angle + step->angleTarget
-                                : step->angle - step->angleTarget;
-  // LOG_D("Step_Rotate: angle = %f, pulse = %ld, dir = %d, angleT = %f", angle,
-  //       targetPulse, step->dir, step->angleTarget);
-  step->slaveTimITCnt = targetPulse / (STEP_SLAVE_TIM_MAX_CNT + 1);
-  if (step->slaveTimITCnt > 0) {
-    step->slaveTimReload = targetPulse % (STEP_SLAVE_TIM_MAX_CNT + 1);
-    targetPulse = STEP_SLAVE_TIM_MAX_CNT;
-    // LOG_D("Step_Rotate: slaveTim ITCnt = %d, Reload = %d",
-    // step->slaveTimITCnt,
-    //       step->slaveTimReload);
+}
+
+/**
+ * @brief 按本段总脉冲数设置从定时器分段计数, 从当前计数段开始计算
+ * @param  step             步进电机控制结构体
+ * @param  total            本段总脉冲数
+ * @note 前ITCnt段每段计满 MaxCnt+1 个脉冲, 最后一段计 Reload+1 个脉冲;
+ * Reload为0时改为最后一段计2个, 之前的最后一个整段少计一个;
+ * 运动中调用时需保证 total 大于已走脉冲数, 新的ARR不会低于当前计数值
+ */
+static void Step_Slave_Setup(step_ctrl_t *step, uint32_t total) {
+  uint64_t chunk = (uint64_t)step->slaveTimMaxCnt + 1;
+  uint32_t remain = total - step->slaveTimBase;
+  step->slaveTimITCnt = (remain - 1) / chunk;
+  step->slaveTimReload = remain - step->slaveTimITCnt * chunk - 1;
+  // ARR为0时从定时器不计数, 最后一段至少2个脉冲, 由前一段少计一个补足
+  step->slaveTimSplit = step->slaveTimReload == 0 && step->slaveTimITCnt > 0;
+  if (step->slaveTimSplit) step->slaveTimReload = 1;
+  if (step->slaveTimITCnt == 0)
+    __HAL_TIM_SET_AUTORELOAD(step->timSlave, step->slaveTimReload);
+  else if (step->slaveTimITCnt == 1 && step->slaveTimSplit)
+    __HAL_TIM_SET_AUTORELOAD(step->timSlave, chunk - 2);
+  else
+    __HAL_TIM_SET_AUTORELOAD(step->timSlave, chunk - 1);
+}
+
+/**
+ * @brief 装载一次旋转(方向, 从定时器计数, 加减速), 不启动定时器
+ * @param  step             步进电机控制结构体
+ * @param  pulse            脉冲数
+ * @param  dir              方向 (0:逆时针, 1:顺时针)
+ * @param  entry            入口速度(加速表下标), 大于0时衔接正在运行的上一段
+ * @param  exit             出口速度(加速表下标)
+ * @retval uint8_t          1: 成功, 0: 失败
+ */
+static uint8_t Step_Rotate_Load(step_ctrl_t *step, uint32_t pulse,
+                                uint8_t dir, uint16_t entry, uint16_t exit) {
+  ASSERT(pulse > 1, "[STEP] targetPulse<2", return 0);
+  step->dir = dir;
+  Step_Write_Dir(step);
+  step->posTarget = step->dir ? step->pos + pulse : step->pos - pulse;
+  // LOG_D("Step_Rotate: pulse = %ld, dir = %d", pulse, step->dir);
+  step->pulseTotal = pulse;
+  if (entry == 0) {  // 衔接时从定时器已在溢出时归零, 不能丢弃新计到的脉冲
+    __HAL_TIM_SET_COUNTER(step->timMaster, 0);
+    __HAL_TIM_SET_COUNTER(step->timSlave, 0);
   }
-  __HAL_TIM_SET_COUNTER(step->timMaster, 0);
-  __HAL_TIM_SET_COUNTER(step->timSlave, 0);
-  __HAL_TIM_SET_AUTORELOAD(step->timSlave, targetPulse - 1);
+  step->slaveTimBase = 0;
+  Step_Slave_Setup(step, pulse);
+  step->exitIdx = 0;
+  if (step->mode == STEP_MODE_SCURVE) {
+    Step_SCurve_Prepare(step, pulse);
+  } else if (step->mode == STEP_MODE_TRAPZ) {
+    Step_Ramp_Prepare(step, pulse, entry, exit);
+    Step_Ramp_Arm_Decel(step);
+  } else {
+    __HAL_TIM_SET_PRESCALER(step->timMaster, step->rampPsc - 1);
+    __HAL_TIM_SET_AUTORELOAD(step->timMaster, step->cruiseArr);
+    __HAL_TIM_SET_COMPARE(step->timMaster, step->timMasterCh,
+                          (step->cruiseArr + 1) / 2);
+    step->timMaster->Instance->EGR = TIM_EGR_UG;  // 立即装载PSC/ARR
+  }
+  return 1;
+}
+
+/**
+ * @brief 设置主定时器输出通道的比较输出模式
+ * @param  step             步进电机控制结构体
+ * @param  mode             TIM_OCMODE_xxx
+ */
+static void Step_OC_Mode(step_ctrl_t *step, uint32_t mode) {
+  TIM_TypeDef *tim = step->timMaster->Instance;
+  __IO uint32_t *ccmr =
+      step->timMasterCh < TIM_CHANNEL_3 ? &tim->CCMR1 : &tim->CCMR2;
+  uint32_t shift = (step->timMasterCh & 0x04U) << 1;  // 通道2/4在高8位
+  *ccmr = (*ccmr & ~(TIM_CCMR1_OC1M << shift)) | (mode << shift);
+}
+
+/**
+ * @brief 使能已装载旋转的从定时器和PWM输出, 但不启动主定时器
+ * @param  step             步进电机控制结构体
+ * @note 与HAL_TIM_PWM_Start_IT相同, 只是不置位CEN,
+ * 主定时器中断未在NVIC中使能, 不需要使能比较中断
+ */
+static void Step_Rotate_Arm(step_ctrl_t *step) {
   HAL_TIM_Base_Start_IT(step->timSlave);
-  HAL_TIM_PWM_Start_IT(step->timMaster, step->timMasterCh);
+  TIM_CHANNEL_STATE_SET(step->timMaster, step->timMasterCh,
+                        HAL_TIM_CHANNEL_STATE_BUSY);
+  TIM_CCxChannelCmd(step->timMaster->Instance, step->timMasterCh,
+                    TIM_CCx_ENABLE);
+  if (IS_TIM_BREAK_INSTANCE(step->timMaster->Instance))
+    __HAL_TIM_MOE_ENABLE(step->timMaster);
   step->rotating = 1;
 }
 
 /**
- * @brief 重设步进电机当前角度
+ * @brief 连续写入各主定时器CR1同时启动, 并测量首末轴的启动偏差
+ * @param  steps            已调用Step_Rotate_Arm的步进电机
+ * @param  num              数量
+ */
+static void Step_Release(step_ctrl_t **steps, uint8_t num) {
+  uint32_t cr1[STEP_MAX_NUM], t0, t1;
+  uint8_t i;
+  for (i = 0; i < num; i++)  // 预先计算, 启动时只有写操作
+    cr1[i] = steps[i]->timMaster->Instance->CR1 | TIM_CR1_CEN;
+  SAFE_ATOM_CODE {
+    t0 = DWT->CYCCNT;
+    for (i = 0; i < num; i++) steps[i]->timMaster->Instance->CR1 = cr1[i];
+    __DSB();  // 等待写入完成
+    t1 = DWT->CYCCNT;
+  }
+  if (num < 2) return;
+  sync_skew_ns = (uint64_t)(t1 - t0) * 1000 / (SystemCoreClock / 1000000);
+#if STEP_SYNC_SKEW_LOG
+  LOG_I("[STEP] sync start %d axes, skew %ldns", num, sync_skew_ns);
+#endif
+}
+
+/**
+ * @brief 启动已装载的旋转
+ * @param  step             步进电机控制结构体
+ */
+static void Step_Rotate_Start(step_ctrl_t *step) {
+  Step_Rotate_Arm(step);
+  Step_Release(&step, 1);
+}
+
+/**
+ * @brief 启动已装载的旋转, 处于多轴分组中时等待Step_Group_End同时启动
+ * @param  step             步进电机控制结构体
+ */
+static void Step_Rotate_Go(step_ctrl_t *step) {
+  Step_Rotate_Arm(step);
+  if (group_active && group_num < STEP_MAX_NUM) {  // 等待Step_Group_End
+    group_list[group_num++] = step;
+    return;
+  }
+  Step_Release(&step, 1);
+}
+
+/**
+ * @brief 执行一个运动段, 正在转动时加入队列
+ * @param  step             步进电机控制结构体
+ * @param  value            相对脉冲数或目标位置(单位:脉冲)
+ * @param  abs              1: value为绝对位置
+ */
+static void Step_Queue_Push(step_ctrl_t *step, int64_t value, uint8_t abs) {
+  uint8_t queued = 0, full = 0;
+  int64_t base, delta;
+  uint32_t pulse;
+  if (step->estop) return;  // 急停后等待规划任务清理
+  ASSERT(!step->stream, "[STEP] In stream", return);
+  if (step->paused && !step->rotating) {  // 新的运动取消暂停的剩余运动
+    step->paused = 0;
+    step->queueHead = step->queueTail;
+  }
+  if (step->jog) {  // 连续运动中直接转为位置运动, 不停止
+    Step_Retarget(step, abs ? value : Step_Get_Pos(step) + value, 0);
+    return;
+  }
+  SAFE_ATOM_CODE {  // 防止检查后完成中断恰好结束运动, 导致段滞留在队列中
+    if (step->rotating) {  // 绝对位置以队列中最后一段的终点为基准
+      queued = 1;
+      base = step->queueHead == step->queueTail ? step->posTarget
+                                                : step->posQueued;
+    } else {
+      base = step->pos;
+    }
+  }
+  delta = abs ? value - base : value;
+  ASSERT(delta > -0x80000000LL && delta < 0x80000000LL, "[STEP] too far",
+         return);
+  pulse = delta > 0 ? delta : -delta;
+  ASSERT(pulse > 1, "[STEP] targetPulse<2", return);
+  if (queued) {
+    SAFE_ATOM_CODE {
+      if (!step->rotating) {  // 计算期间已停止, 直接执行
+        queued = 0;
+      } else if ((uint8_t)(step->queueTail - step->queueHead) >=
+                 STEP_QUEUE_SIZE) {
+        full = 1;
+      } else {
+        step_seg_t *seg = &step->queue[step->queueTail % STEP_QUEUE_SIZE];
+        seg->pulse = pulse;
+        seg->dir = delta > 0 ? 1 : 0;
+        seg->speed = step->speedSet;
+        seg->spd = step->speedCfg;
+        seg->entryIdx = 0;  // 规划前从静止起步, 保证与上一段一致
+        seg->exitIdx = 0;
+        seg->planned = 0;
+        step->posQueued = base + delta;
+        step->queueTail++;
+        step->planDirty = 1;
+      }
+    }
+    ASSERT(!full, "[STEP] queue full", return);
+    if (queued) return;
+    if (abs) {  // 重新以停止位置为基准
+      delta = value - step->pos;
+      pulse = delta > 0 ? delta : -delta;
+      ASSERT(pulse > 1, "[STEP] targetPulse<2", return);
+    }
+  }
+  if (step->rampStale) Step_Kinematics_Update(step);
+  Step_Speed_Load(step, &step->speedCfg);
+  if (!Step_Rotate_Load(step, pulse, delta > 0 ? 1 : 0, 0, 0)) return;
+  Step_Rotate_Go(step);
+}
+
+/**
+ * @brief 在完成中断中检查下一段是否以非零速度衔接, 是则不停止定时器直接装载
  * @param  step             步进电机控制结构体
- * @param  angle            角度(单位:度)
+ * @retval uint8_t          1: 已衔接
  */
-void Step_Set_Angle(step_ctrl_t *step, double angle) {
+static uint8_t Step_Queue_Blend(step_ctrl_t *step) {
+  step_seg_t *seg;
+  if (step->paused || step->queueHead == step->queueTail) return 0;
+  seg = &step->queue[step->queueHead % STEP_QUEUE_SIZE];
+  if (seg->entryIdx == 0) return 0;
+  step->queueHead++;
+  Step_Ramp_Halt(step);
+  Step_Speed_Load(step, &seg->spd);  // 规划保证与当前段的配置相同
+  return Step_Rotate_Load(step, seg->pulse, seg->dir, seg->entryIdx,
+                          seg->exitIdx);
+}
+
+/**
+ * @brief 在完成中断中取出并从静止启动下一个运动段
+ * @param  step             步进电机控制结构体
+ * @retval uint8_t          1: 已启动
+ * @note 加速表按同步运动生成时不在中断中重新生成, 由Step_Planner_Task启动
+ */
+static uint8_t Step_Queue_Pop(step_ctrl_t *step) {
+  step_seg_t *seg;
+  if (step->rampStale) return 0;
+  while (!step->paused && step->queueHead != step->queueTail) {
+    seg = &step->queue[step->queueHead % STEP_QUEUE_SIZE];
+    step->queueHead++;
+    Step_Speed_Load(step, &seg->spd);
+    if (Step_Rotate_Load(step, seg->pulse, seg->dir, 0, seg->exitIdx)) {
+      Step_Rotate_Start(step);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief 两个速度配置是否相同
+ */
+static inline uint8_t Step_Speed_Same(const step_speed_t *a,
+                                      const step_speed_t *b) {
+  return a->mode == b->mode && a->psc == b->psc && a->arr == b->arr &&
+         a->rampLen == b->rampLen;
+}
+
+/**
+ * @brief 正在运行段的出口速度上限, 即队列第一段入口速度的上限
+ * @param  step             步进电机控制结构体
+ * @param  seg              队列第一段
+ * @retval uint32_t         出口速度上限(加速表下标)
+ * @note 未到达减速点时出口速度可以重新规划(Step_Replan_Exit), 上限为
+ * 一直加速到终点的速度; 已开始减速时只能使用已规划的出口速度
+ */
+static uint32_t Step_Exit_Limit(step_ctrl_t *step, const step_seg_t *seg) {
+  step_speed_t cur;
+  uint32_t done, lim = 0;
+  SAFE_ATOM_CODE {
+    cur.psc = step->rampPsc;
+    cur.arr = step->cruiseArr;
+    cur.rampLen = step->rampLen;
+    cur.mode = step->mode;
+    if (step->rotating && !step->jog && !step->paused && !step->rampStale &&
+        step->dir == seg->dir && Step_Speed_Same(&cur, &seg->spd)) {
+      done = step->slaveTimBase + __HAL_TIM_GET_COUNTER(step->timSlave);
+      if (done + 2 >= step->decelPulse)
+        lim = step->exitIdx;
+      else
+        lim = Step_Ramp_Index(step, done) + (step->pulseTotal - done) - 2;
+    }
+  }
+  return lim;
+}
+
+/**
+ * @brief 对一个轴的队列做前瞻规划
+ * @param  step             步进电机控制结构体
+ * @note 反向遍历保证每段都能减速到下一段的入口速度, 末段减速到静止,
+ * 正向遍历保证每段都能从入口速度加速到出口速度; 反向遍历遇到入口速度
+ * 未变化的已规划段即停止, 之前的段不受影响
+ */
+static void Step_Plan(step_ctrl_t *step) {
+  uint16_t entry[STEP_QUEUE_SIZE], exit[STEP_QUEUE_SIZE];
+  uint32_t lim, junction;
+  uint8_t head, n, k, start = 0;
+  step_seg_t *seg, *prev;
+  if (!step->planDirty) return;
+  step->planDirty = 0;  // 先清除, 规划期间入队的段会再次置位
+  head = step->queueHead;
+  n = step->queueTail - head;
+  if (n == 0) return;
+  // 仅同方向, 速度配置相同的梯形加减速段之间衔接, 其余段都从静止起步
+  lim = 0;
+  for (k = n; k > 0; k--) {
+    seg = &step->queue[(uint8_t)(head + k - 1) % STEP_QUEUE_SIZE];
+    exit[k - 1] = lim;
+    if (seg->spd.mode != STEP_MODE_TRAPZ) {
+      junction = 0;
+    } else if (k == 1) {  // 第一段的入口速度为正在运行段的出口速度
+      junction = Step_Exit_Limit(step, seg);
+      if (junction > seg->spd.rampLen - 1u) junction = seg->spd.rampLen - 1;
+    } else {
+      prev = &step->queue[(uint8_t)(head + k - 2) % STEP_QUEUE_SIZE];
+      junction = prev->dir == seg->dir && Step_Speed_Same(&prev->spd, &seg->spd)
+                     ? seg->spd.rampLen - 1
+                     : 0;
+    }
+    lim += seg->pulse;
+    if (lim > junction) lim = junction;
+    entry[k - 1] = lim;
+    if (seg->planned && seg->entryIdx == lim && k > 1) {
+      start = k - 1;
+      break;
+    }
+  }
+  lim = entry[start];
+  for (k = start; k < n; k++) {
+    seg = &step->queue[(uint8_t)(head + k) % STEP_QUEUE_SIZE];
+    entry[k] = lim;
+    lim += seg->pulse;
+    if (lim > exit[k]) lim = exit[k];
+    exit[k] = lim;
+  }
+  SAFE_ATOM_CODE {
+    if (step->queueHead != head) {  // 规划期间已出队, 重新规划
+      step->planDirty = 1;
+    } else if (start == 0 && step->rotating && entry[0] != step->exitIdx &&
+               !Step_Replan_Exit(step, entry[0])) {
+      step->planDirty = 1;  // 规划期间已开始减速, 按已规划的出口速度重新规划
+    } else {
+      for (k = start; k < n; k++) {
+        seg = &step->queue[(uint8_t)(head + k) % STEP_QUEUE_SIZE];
+        seg->entryIdx = entry[k];
+        seg->exitIdx = exit[k];
+      }
+      for (k = 0; k < n; k++)
+        step->queue[(uint8_t)(head + k) % STEP_QUEUE_SIZE].planned = 1;
+    }
+  }
+}
+
+/**
+ * @brief 前瞻规划任务, 在调度器中周期调用
+ * @note 急停的轴跳过, 由Step_EStop_Clear清理
+ */
+void Step_Planner_Task(void) {
+  double vel;
+  uint8_t pop;
+  for (uint8_t i = 0; i < step_num; i++) {
+    if (step_list[i]->estop) continue;  // 由Step_EStop_Clear在后台清理
+    pop = 0;
+    SAFE_ATOM_CODE {  // 加速度改变或同步运动结束后, 重新生成加速表再执行队列
+      pop = step_list[i]->rampStale && !step_list[i]->rotating;
+    }
+    if (pop) {
+      Step_Kinematics_Update(step_list[i]);
+      Step_Plan(step_list[i]);
+      SAFE_ATOM_CODE {  // 重新生成期间可能已由中断启动
+        if (!step_list[i]->rotating) Step_Queue_Pop(step_list[i]);
+      }
+    }
+    Step_Plan(step_list[i]);
+    if (!step_list[i]->rotating && step_list[i]->jogVel != 0) {
+      vel = step_list[i]->jogVel;  // 换向减速已停止, 反向启动
+      Step_Jog(step_list[i], vel);
+    }
+  }
+}
+
+/**
+ * @brief 获取已完成前瞻规划的排队段数
+ * @param  step             步进电机控制结构体
+ * @retval uint8_t          已规划段数
+ */
+uint8_t Step_Queue_Planned(step_ctrl_t *step) {
+  uint8_t cnt = 0;
+  for (uint8_t i = step->queueHead; i != step->queueTail; i++)
+    if (step->queue[i % STEP_QUEUE_SIZE].planned) cnt++;
+  return cnt;
+}
+
+/**
+ * @brief 获取排队等待执行的运动段数
+ * @param  step             步进电机控制结构体
+ * @retval uint8_t          队列深度
+ */
+uint8_t Step_Queue_Depth(step_ctrl_t *step) {
+  return (uint8_t)(step->queueTail - step->queueHead);
+}
+
+/**
+ * @brief 旋转步进电机, 正在转动时排队到当前运动之后执行
+ * @param  step             步进电机控制结构体
+ * @param  pulse            旋转脉冲数(正数:顺时针, 负数:逆时针)
+ */
+void Step_Rotate(step_ctrl_t *step, int32_t pulse) {
+  Step_Queue_Push(step, pulse, 0);
+}
+
+/**
+ * @brief 多轴直线插补: 各轴按位移比例缩放速度, 同时启动并同时到达
+ * @param  steps            步进电机控制结构体数组
+ * @param  pulses           各轴旋转脉冲数(正数:顺时针, 负数:逆时针)
+ * @param  num              轴数
+ * @param  speed            位移最大轴的速度(单位:脉冲/秒)
+ * @note 缩放后的速度/加速度/加加速度只用于本次运动, 各轴的设定值不变;
+ * 加速表按缩放后的加速度生成, 之后的运动开始前重新生成
+ */
+void Step_Rotate_Sync(step_ctrl_t **steps, int64_t *pulses, uint8_t num,
+                      double speed) {
+  uint32_t pulse[STEP_MAX_NUM], pulseMax = 0;
+  step_ctrl_t *loaded[STEP_MAX_NUM], *step;
+  step_speed_t cfg;
+  double ratio, accel, jerk, accelSet, jerkSet;
+  uint8_t i, ok, num_loaded = 0;
+  ASSERT(num > 0 && num <= STEP_MAX_NUM, "[STEP] sync num error", return);
+  ASSERT(speed < -0.01 || speed > 0.01, "[STEP] setspeed=0", return);
+  for (i = 0; i < num; i++) {
+    if (steps[i]->estop) return;
+    ASSERT(!steps[i]->rotating, "[STEP] In busy", return);
+    ASSERT(pulses[i] > -0x80000000LL && pulses[i] < 0x80000000LL,
+           "[STEP] too far", return);
+    pulse[i] = pulses[i] > 0 ? pulses[i] : -pulses[i];
+    if (pulse[i] > pulseMax) pulseMax = pulse[i];
+  }
+  ASSERT(pulseMax > 1, "[STEP] targetPulse<2", return);
+  speed = fabs(speed);  // 先限制主轴速度, 其余轴按限制后的速度缩放
+  if (speed > STEP_PWM_MAX_FREQ) speed = STEP_PWM_MAX_FREQ;
+  // 主轴取位移最大的轴, 其余轴按脉冲数比例缩放, 加减速段时间一致
+  accel = jerk = 0;
+  for (i = 0; i < num; i++) {  // 取各轴中最严格的限制, 0为不限制
+    if (steps[i]->accel > 0 && (accel == 0 || steps[i]->accel < accel))
+      accel = steps[i]->accel;
+    if (steps[i]->jerk > 0 && (jerk == 0 || steps[i]->jerk < jerk))
+      jerk = steps[i]->jerk;
+  }
+  for (i = 0; i < num; i++) {
+    if (pulse[i] < 2) continue;  // 位移过小, 不参与运动
+    step = steps[i];
+    ratio = (double)pulse[i] / pulseMax;
+    accelSet = step->accel;  // 临时使用缩放后的值生成加速表和装载
+    jerkSet = step->jerk;
+    step->accel = accel * ratio;
+    step->jerk = jerk * ratio;
+    Step_Ramp_Build(step);
+    Step_Speed_Solve(step, speed * ratio, &cfg);
+    Step_Speed_Load(step, &cfg);
+    ok = Step_Rotate_Load(step, pulse[i], pulses[i] > 0 ? 1 : 0, 0, 0);
+    step->rampStale = step->accel != accelSet || step->jerk != jerkSet;
+    step->accel = accelSet;
+    step->jerk = jerkSet;
+    if (!ok) continue;
+    Step_Rotate_Arm(step);
+    loaded[num_loaded++] = step;
+  }
+  Step_Release(loaded, num_loaded);  // 同时启动
+}
+
+/**
+ * @brief 开始一组同步启动, 之后从静止开始的旋转只装载不启动
+ */
+void Step_Group_Begin(void) {
+  group_num = 0;
+  group_active = 1;
+}
+
+/**
+ * @brief 同时启动Step_Group_Begin之后装载的所有旋转
+ */
+void Step_Group_End(void) {
+  group_active = 0;
+  if (group_num > 0) Step_Release(group_list, group_num);
+  group_num = 0;
+}
+
+/**
+ * @brief 运动完成回调, 排队的运动段全部执行完毕后在定时器中断中调用
+ * @param  step             步进电机控制结构体
+ * @note 手动停止/急停不触发
+ */
+__weak void Step_Finished_Callback(step_ctrl_t *step) { UNUSED(step); }
+
+/**
+ * @brief 获取最近一次多轴同步启动时首末轴的启动偏差
+ * @retval uint32_t         偏差, ns
+ */
+uint32_t Step_Get_Sync_Skew(void) { return sync_skew_ns; }
+
+/**
+ * @brief 重设步进电机当前位置
+ * @param  step             步进电机控制结构体
+ * @param  pos              位置(单位:脉冲)
+ */
+void Step_Set_Pos(step_ctrl_t *step, int64_t pos) {
   ASSERT(!step->rotating, "[STEP] In busy", return);
-  step->angle = angle;
-  step->angleTarget = angle;
+  step->pos = pos;
+  step->posTarget = pos;
 }
 
 /**
- * @brief 旋转步进电机到指定角度
+ * @brief 旋转步进电机到指定位置
  * @param  step             步进电机控制结构体
- * @param  angle            目标角度(单位:度)
+ * @param  pos              目标位置(单位:脉冲)
  */
-void Step_Rotate_Abs(step_ctrl_t *step, double angle) {
-  Step_Rotate(step, angle - step->angle);
+void Step_Rotate_Abs(step_ctrl_t *step, int64_t pos) {
+  Step_Queue_Push(step, pos, 1);
 }
 
 /**
- * @brief 手动停止步进电机
- * @param  step           步进电机控制结构体
+ * @brief 由已走脉冲数推算当前速度(加速表下标), 需在关中断时调用
+ * @param  step             步进电机控制结构体
+ * @param  done             本段已走脉冲数
  */
-void Step_Stop(step_ctrl_t *step) {
+static uint16_t Step_Ramp_Index(step_ctrl_t *step, uint32_t done) {
+  int32_t idx;
+  uint32_t d = done - step->rampBase;
+  if (d < step->rampAccLen) {
+    idx = step->rampEntry > step->rampPeak ? step->rampEntry - d
+                                           : step->rampEntry + d;
+  } else if (done < step->decelPulse) {
+    idx = step->rampPeak;
+  } else {
+    idx = (int32_t)step->rampPeak - (int32_t)(done - step->decelPulse);
+  }
+  if (idx < 1) idx = 1;
+  if (idx > (int32_t)step->rampMax - 1) idx = step->rampMax - 1;
+  return idx;
+}
+
+/**
+ * @brief 从当前速度重新装载加减速, 终点为step->pulseTotal
+ * @param  step             步进电机控制结构体
+ * @param  done             已走脉冲数
+ * @param  idx              当前速度(加速表下标)
+ * @param  exit             出口速度(加速表下标)
+ */
+static void Step_Ramp_Resume(step_ctrl_t *step, uint32_t done, uint16_t idx,
+                             uint16_t exit) {
+  Step_Ramp_Prepare(step, step->pulseTotal - done, idx, exit);
+  step->rampBase = done;
+  step->decelPulse += done;
+  if (step->decelPulse <= done + 1)
+    Step_Ramp_Decel(step);
+  else
+    Step_Ramp_Arm_Decel(step);
+}
+
+/**
+ * @brief 按新目标重新规划正在运行的运动段, 需在关中断时调用
+ * @param  step             步进电机控制结构体
+ * @param  pos              新的目标位置(单位:脉冲)
+ * @param  keepQueue        保留队列中尚未执行的运动段(暂停/恢复)
+ * @retval uint8_t          1: 来不及到达, 已改为以最短距离减速停止
+ */
+static uint8_t Step_Replan(step_ctrl_t *step, int64_t pos, uint8_t keepQueue) {
+  int64_t dist;
+  uint32_t done, total, minTotal;
+  uint16_t idx = 0;
+  uint8_t overshoot = 0;
+  if (!keepQueue) step->queueHead = step->queueTail;  // 新目标取代队列
+  step->jog = 0;
+  if (step->mode == STEP_MODE_TRAPZ) Step_Ramp_Halt(step);
+  done = step->slaveTimBase + __HAL_TIM_GET_COUNTER(step->timSlave);
+  if (step->mode == STEP_MODE_TRAPZ) idx = Step_Ramp_Index(step, done);
+  // 留出关中断期间可能继续输出的脉冲
+  minTotal = done + idx + 2;
+  dist = step->dir ? pos - step->pos : step->pos - pos;
+  if (dist < (int64_t)minTotal) {
+    total = minTotal;
+    overshoot = 1;
+  } else {
+    total = dist > 0x7FFFFFFF ? 0x7FFFFFFF : dist;
+  }
+  step->pulseTotal = total;
+  step->posTarget = step->dir ? step->pos + total : step->pos - total;
+  if (!keepQueue) step->posQueued = step->posTarget;
+  Step_Slave_Setup(step, total);
+  if (step->mode == STEP_MODE_TRAPZ) Step_Ramp_Resume(step, done, idx, 0);
+  return overshoot;
+}
+
+/**
+ * @brief 重新规划正在运行段的出口速度, 终点不变, 需在关中断时调用
+ * @param  step             步进电机控制结构体
+ * @param  exit             新的出口速度(加速表下标)
+ * @retval uint8_t          1: 成功, 0: 已开始减速或距离不足, 保持原规划
+ * @note 由前瞻规划调用, 使从静止启动的段也能与之后排队的段衔接
+ */
+static uint8_t Step_Replan_Exit(step_ctrl_t *step, uint16_t exit) {
+  uint32_t done, remain;
+  uint16_t idx;
+  if (!step->rotating || step->mode != STEP_MODE_TRAPZ || step->jog)
+    return 0;
+  done = step->slaveTimBase + __HAL_TIM_GET_COUNTER(step->timSlave);
+  if (done + 2 >= step->decelPulse) return 0;
+  idx = Step_Ramp_Index(step, done);
+  remain = step->pulseTotal - done;
+  if (exit + 2 > idx + remain || idx + 2 > exit + remain) return 0;
+  Step_Ramp_Halt(step);
+  done = step->slaveTimBase + __HAL_TIM_GET_COUNTER(step->timSlave);
+  Step_Ramp_Resume(step, done, Step_Ramp_Index(step, done), exit);
+  return 1;
+}
+
+/**
+ * @brief 运动中切换到新速度的配置, 之后由调用者按当前速度重新规划
+ * @param  step             步进电机控制结构体
+ * @param  speed            新的速度(单位:脉冲/秒)
+ * @note 加速表与速度无关, 只需替换匀速段周期; 梯形加减速中新速度低于
+ * 起步频率时以表中最低速度运行, 匀速运动直接写入预装载寄存器,
+ * 下一个脉冲生效, 不重置计数器
+ */
+static void Step_Speed_Change(step_ctrl_t *step, double speed) {
+  step_speed_t cfg;
+  Step_Set_Speed(step, speed);
+  cfg = step->speedCfg;
+  SAFE_ATOM_CODE {
+    if (step->rotating && step->mode == STEP_MODE_TRAPZ) {
+      Step_Ramp_Halt(step);
+      if (cfg.mode != STEP_MODE_TRAPZ) {
+        cfg.mode = STEP_MODE_TRAPZ;
+        cfg.psc = STEP_RAMP_PSC;
+        cfg.arr = 0xFFFF;
+        cfg.rampLen = 1;
+      }
+      Step_Speed_Load(step, &cfg);
+    } else if (step->rotating && cfg.mode == STEP_MODE_TRAPZ) {
+      // 匀速(低于起步频率)切换到加减速, 视为位于加速表起点, 由调用者规划
+      Step_Speed_Load(step, &cfg);
+      step->rampEntry = 1;
+      step->rampPeak = 1;
+      step->rampAccLen = 0;
+      step->rampBase = 0;
+      step->decelPulse = 0xFFFFFFFF;
+    } else if (step->rotating) {
+      Step_Speed_Load(step, &cfg);
+      // 禁止更新事件, 保证PSC/ARR/CCR在同一个更新事件生效
+      step->timMaster->Instance->CR1 |= TIM_CR1_UDIS;
+      __HAL_TIM_SET_PRESCALER(step->timMaster, step->rampPsc - 1);
+      __HAL_TIM_SET_AUTORELOAD(step->timMaster, step->cruiseArr);
+      __HAL_TIM_SET_COMPARE(step->timMaster, step->timMasterCh,
+                            (step->cruiseArr + 1) / 2);
+      step->timMaster->Instance->CR1 &= ~TIM_CR1_UDIS;
+    }
+  }
+}
+
+/**
+ * @brief 在运动中修改目标位置和速度, 不停止电机
+ * @param  step             步进电机控制结构体
+ * @param  pos              新的目标位置(单位:脉冲)
+ * @param  speed            新的速度(单位:脉冲/秒), 0为保持当前速度
+ * @note 从定时器按已走脉冲数重新分段, 加减速从当前速度重新规划;
+ * 新目标在反方向或来不及减速时先以最短距离减速停止, 再反向运动到目标,
+ * 队列中尚未执行的运动段被丢弃; 连续速度模式下调用时切换回位置模式;
+ * S曲线模式不支持
+ */
+void Step_Retarget(step_ctrl_t *step, int64_t pos, double speed) {
+  uint8_t running = 1, overshoot = 0;
+  if (step->estop) return;
+  ASSERT(!step->stream, "[STEP] In stream", return);
+  step->jogVel = 0;
+  step->paused = 0;
+  if (!step->rotating) {
+    if (speed > 0) Step_Set_Speed(step, speed);
+    if (pos != step->pos) Step_Rotate_Abs(step, pos);
+    return;
+  }
+  ASSERT(step->accel <= 0 || step->jerk <= 0, "[STEP] S-curve retarget",
+         return);
+  if (speed > 0) Step_Speed_Change(step, speed);
+  SAFE_ATOM_CODE {
+    if (!step->rotating) {  // 重建加减速表期间已走完
+      running = 0;
+    } else {
+      overshoot = Step_Replan(step, pos, 0);
+    }
+  }
+  // 减速停止后排队反向运动, 或已走完时直接运动到新目标
+  if (overshoot || (!running && pos != step->pos)) Step_Rotate_Abs(step, pos);
+}
+
+/**
+ * @brief 切换为连续速度模式的计数方式, 需在关中断或未启动时调用
+ * @param  step             步进电机控制结构体
+ * @note 从定时器每次溢出只把计满的脉冲累计到位置中, 不会到达终点;
+ * 32位从定时器约2^32个脉冲才溢出一次
+ */
+static void Step_Jog_Enter(step_ctrl_t *step) {
+  step->pos = step->dir ? step->pos + step->slaveTimBase
+                        : step->pos - step->slaveTimBase;
+  step->slaveTimBase = 0;
+  step->slaveTimITCnt = 1;
+  __HAL_TIM_SET_AUTORELOAD(step->timSlave, step->slaveTimMaxCnt);
+  __HAL_TIM_DISABLE_IT(step->timSlave, TIM_IT_CC2);
+  step->decelPulse = 0xFFFFFFFF;  // 不减速
+  step->posTarget = step->pos;
+  step->posQueued = step->pos;
+  step->jog = 1;
+}
+
+/**
+ * @brief 设置连续速度(点动)模式的速度
+ * @param  step             步进电机控制结构体
+ * @param  velocity         速度(单位:脉冲/秒), 符号为方向, 0为减速停止
+ * @note 主定时器连续输出, 从定时器只用于位置计数; 同向时从当前速度
+ * 加减速到新速度, 正在进行的位置运动直接转为连续运动;
+ * 反向时先减速停止, 停止后由Step_Planner_Task反向启动
+ */
+void Step_Jog(step_ctrl_t *step, double velocity) {
+  double speed = fabs(velocity);
+  uint8_t dir = velocity > 0 ? 1 : 0;
+  uint8_t start = 0;
+  uint32_t done;
+  if (step->estop) return;
+  ASSERT(step->accel <= 0 || step->jerk <= 0, "[STEP] S-curve jog", return);
+  ASSERT(!step->stream, "[STEP] In stream", return);
+  step->jogVel = 0;
+  step->paused = 0;
+  if (speed > STEP_PWM_MAX_FREQ) speed = STEP_PWM_MAX_FREQ;
+  if (!step->rotating) {
+    if (speed < 0.01) return;
+    start = 1;
+  } else if (speed < 0.01 || dir != step->dir) {  // 减速停止
+    SAFE_ATOM_CODE {
+      if (step->rotating) Step_Replan(step, step->pos, 0);
+    }
+    if (speed >= 0.01) step->jogVel = velocity;  // 停止后反向启动
+    return;
+  } else {
+    Step_Speed_Change(step, speed);
+    SAFE_ATOM_CODE {
+      if (!step->rotating) {  // 重建加减速表期间已走完
+        start = 1;
+      } else {
+        step->queueHead = step->queueTail;  // 丢弃排队的位置运动
+        if (step->mode == STEP_MODE_TRAPZ) {
+          Step_Ramp_Halt(step);
+          done = step->slaveTimBase + __HAL_TIM_GET_COUNTER(step->timSlave);
+          Step_Ramp_Prepare(step, 0x7FFFFFFF, Step_Ramp_Index(step, done), 0);
+          step->rampBase = done - step->slaveTimBase;  // 切换计数方式后的值
+        }
+        Step_Jog_Enter(step);
+      }
+    }
+  }
+  if (!start) return;
+  if (step->rampStale) Step_Kinematics_Update(step);
+  Step_Set_Speed(step, speed);
+  Step_Speed_Load(step, &step->speedCfg);
+  if (!Step_Rotate_Load(step, 0x7FFFFFFF, dir, 0, 0)) return;
+  Step_Jog_Enter(step);
+  Step_Rotate_Go(step);
+}
+
+/**
+ * @brief 进入流式速度模式, 主定时器以固定分频连续运行, 速度由
+ * Step_Stream_Velocity实时写入
+ * @param  step             步进电机控制结构体
+ * @note 从定时器与连续速度模式相同, 只用于位置计数; 初始不输出脉冲
+ */
+void Step_Stream_Begin(step_ctrl_t *step) {
+  step_speed_t cfg = {0, 0xFFFF, 0, STEP_MODE_CONST};
+  if (step->estop) return;
+  ASSERT(!step->rotating, "[STEP] In busy", return);
+  step->queueHead = step->queueTail;
+  step->jogVel = 0;
+  step->paused = 0;
+  // 固定分频, 运动中不再需要更新事件装载PSC
+  cfg.psc = STEP_TIM_BASE_CLK / STEP_STREAM_MIN_FREQ / 0x10000 + 1;
+  Step_Speed_Load(step, &cfg);
+  __HAL_TIM_SET_PRESCALER(step->timMaster, step->rampPsc - 1);
+  __HAL_TIM_SET_AUTORELOAD(step->timMaster, 0xFFFF);
+  __HAL_TIM_SET_COMPARE(step->timMaster, step->timMasterCh,
+                        STEP_TIM_BASE_CLK / step->rampPsc /
+                            STEP_PWM_MAX_FREQ / 2);
+  __HAL_TIM_SET_COUNTER(step->timMaster, 0);
+  __HAL_TIM_SET_COUNTER(step->timSlave, 0);
+  step->timMaster->Instance->EGR = TIM_EGR_UG;
+  Step_Write_Dir(step);
+  step->slaveTimBase = 0;
+  Step_Jog_Enter(step);
+  step->stream = 1;
+  Step_Rotate_Arm(step);  // 主定时器保持停止, 第一次设置速度时启动
+}
+
+/**
+ * @brief 流式速度模式下停止输出, 需在关中断时调用
+ * @param  step             步进电机控制结构体
+ * @note 主定时器停止后不再产生TRGO, 从定时器不会多计数(TIM4输出在CH4,
+ * CCR1为0, 每个周期起始都产生TRGO); 正在输出脉冲时等待脉冲结束
+ * (最长为最高频率下的半个周期)再停止, 输出保持低电平
+ */
+static void Step_Stream_Halt(step_ctrl_t *step) {
+  uint32_t ccr = __HAL_TIM_GET_COMPARE(step->timMaster, step->timMasterCh);
+  while ((step->timMaster->Instance->CR1 & TIM_CR1_CEN) &&
+         __HAL_TIM_GET_COUNTER(step->timMaster) < ccr) {
+  }
+  step->timMaster->Instance->CR1 &= ~TIM_CR1_CEN;
+}
+
+/**
+ * @brief 流式速度模式下立即更新速度
+ * @param  step             步进电机控制结构体
+ * @param  velocity         速度(单位:脉冲/秒), 符号为方向
+ * @note 新周期短于当前周期已计时间时立即产生更新事件开始新脉冲,
+ * 否则直接写入当前周期, 不必等待上一个较长的周期结束;
+ * 脉宽固定为最高频率下的半个周期; 低于STEP_STREAM_MIN_FREQ时停止
+ * 主定时器, 恢复时从新的周期开始
+ */
+void Step_Stream_Velocity(step_ctrl_t *step, double velocity) {
+  double speed = fabs(velocity);
+  double tickFreq = (double)STEP_TIM_BASE_CLK / step->rampPsc;
+  uint8_t dir = velocity > 0 ? 1 : 0;
+  uint32_t ticks, cnt;
+  int64_t cur;
+  if (!step->stream || step->estop) return;  // 急停后等待规划任务清理
+  if (speed < STEP_STREAM_MIN_FREQ) {
+    SAFE_ATOM_CODE { Step_Stream_Halt(step); }
+    return;
+  }
+  if (speed > STEP_PWM_MAX_FREQ) speed = STEP_PWM_MAX_FREQ;
+  ticks = tickFreq / speed + 0.5;
+  if (ticks > 0x10000) ticks = 0x10000;
+  SAFE_ATOM_CODE {
+    if (dir != step->dir) {  // 换向, 已计脉冲按原方向折算到位置中
+      cnt = __HAL_TIM_GET_COUNTER(step->timSlave);
+      cur = step->dir ? step->pos + step->slaveTimBase + cnt
+                      : step->pos - step->slaveTimBase - cnt;
+      step->pos = dir ? cur - cnt : cur + cnt;
+      step->slaveTimBase = 0;
+      step->dir = dir;
+      Step_Write_Dir(step);
+    }
+    step->timMaster->Instance->CR1 &= ~TIM_CR1_ARPE;
+    __HAL_TIM_SET_AUTORELOAD(step->timMaster, ticks - 1);
+    if (!(step->timMaster->Instance->CR1 & TIM_CR1_CEN)) {  // 从停止恢复
+      step->timMaster->Instance->EGR = TIM_EGR_UG;
+      step->timMaster->Instance->CR1 |= TIM_CR1_CEN;
+    } else if (__HAL_TIM_GET_COUNTER(step->timMaster) >= ticks - 1) {
+      step->timMaster->Instance->EGR = TIM_EGR_UG;
+    }
+    step->timMaster->Instance->CR1 |= TIM_CR1_ARPE;
+    step->cruiseArr = ticks - 1;
+  }
+}
+
+/**
+ * @brief 退出流式速度模式并停止
+ * @param  step             步进电机控制结构体
+ */
+void Step_Stream_End(step_ctrl_t *step) {
+  if (!step->stream) return;
+  Step_Stop(step);  // 位置模式的分频和周期在下一段启动时重新装载
+}
+
+/**
+ * @brief 立即停止定时器并记录停止位置, 不处理队列
+ * @param  step             步进电机控制结构体
+ */
+static void Step_Halt(step_ctrl_t *step) {
   HAL_TIM_PWM_Stop_IT(step->timMaster, step->timMasterCh);
   HAL_TIM_Base_Stop_IT(step->timSlave);
-  step->angle = Step_Get_Angle(step);
+  Step_Ramp_Halt(step);
+  step->pos = Step_Get_Pos(step);
   __HAL_TIM_SET_COUNTER(step->timSlave, 0);
   step->rotating = 0;
+  step->jog = 0;
+  step->stream = 0;
+}
+
+/**
+ * @brief 减速停止, 在指定距离内停下
+ * @param  step             步进电机控制结构体
+ * @param  dist             最大停止距离(单位:脉冲), 0为按设定加速度减速
+ * @note 距离小于按设定加速度减速所需距离时, 按比例压缩减速表,
+ * 等效于按 当前速度下标/距离 倍的加速度减速; 不使用加减速时立即停止,
+ * S曲线模式没有加减速表, 同样立即停止; 队列中的运动段被丢弃
+ */
+void Step_Stop_Ramp(step_ctrl_t *step, uint32_t dist) {
+  uint32_t done;
+  uint16_t idx, k;
+  uint8_t hard = 0;
+  if (!step->rotating || step->estop) return;
+  if (step->mode != STEP_MODE_TRAPZ || step->stream) {
+    Step_Stop(step);
+    return;
+  }
+  step->jogVel = 0;
+  step->paused = 0;
+  SAFE_ATOM_CODE {
+    if (step->rotating) {
+      Step_Ramp_Halt(step);
+      done = step->slaveTimBase + __HAL_TIM_GET_COUNTER(step->timSlave);
+      idx = Step_Ramp_Index(step, done);
+      if (dist == 0 || dist >= idx + 2u) {
+        Step_Replan(step, step->pos, 0);
+      } else if (dist < 2) {
+        hard = 1;
+      } else {
+        step->queueHead = step->queueTail;
+        step->jog = 0;
+        step->pulseTotal = done + dist;
+        step->posTarget = step->dir ? step->pos + step->pulseTotal
+                                    : step->pos - step->pulseTotal;
+        step->posQueued = step->posTarget;
+        Step_Slave_Setup(step, step->pulseTotal);
+        // 第k个脉冲的速度下标按 idx*(dist-k)/dist 线性下降
+        for (k = 0; k < dist; k++) {
+          uint32_t j = (uint32_t)idx * (dist - 1 - k) / dist;
+          step->rampDecTable[k] = step->rampAccTable[j];
+        }
+        step->rampDirty = 1;
+        step->rampEntry = idx;
+        step->rampPeak = idx;
+        step->rampAccLen = 0;
+        step->rampBase = done;
+        step->decelPulse = done;
+        step->decelIdx = 0;
+        step->decelLen = dist;
+        step->exitIdx = 0;
+        Step_Ramp_Decel(step);
+      }
+    }
+  }
+  if (hard) Step_Stop(step);
+}
+
+/**
+ * @brief 暂停运动, 按设定加速度减速停止, 保留剩余距离和队列
+ * @param  step             步进电机控制结构体
+ * @note 连续速度模式下记录速度, 恢复时重新加速到该速度
+ */
+void Step_Pause(step_ctrl_t *step) {
+  if (!step->rotating || step->paused || step->stream) return;
+  if (step->jog) {
+    Step_Jog(step, 0);
+    step->pauseVel = step->dir ? step->speedSet : -step->speedSet;
+    step->paused = 1;
+    return;
+  }
+  SAFE_ATOM_CODE {
+    if (step->rotating) {
+      step->pauseTarget = step->posTarget;
+      step->pauseVel = 0;
+      step->paused = 1;
+      // 队列中的段按原来的衔接规划, 恢复后从静止开始重新规划
+      for (uint8_t i = step->queueHead; i != step->queueTail; i++) {
+        step_seg_t *seg = &step->queue[i % STEP_QUEUE_SIZE];
+        seg->entryIdx = 0;
+        seg->exitIdx = 0;
+        seg->planned = 0;
+      }
+      step->planDirty = 1;
+      if (step->mode == STEP_MODE_TRAPZ) Step_Replan(step, step->pos, 1);
+    }
+  }
+  // 不使用加减速或S曲线模式时立即停止, 保留队列
+  if (step->paused && step->rotating && step->mode != STEP_MODE_TRAPZ)
+    Step_Halt(step);
+  LOG_D("[STEP] Pause");
+}
+
+/**
+ * @brief 恢复暂停的运动, 从当前位置加速走完剩余距离后继续执行队列
+ * @param  step             步进电机控制结构体
+ */
+void Step_Resume(step_ctrl_t *step) {
+  int64_t delta;
+  uint8_t running = 0;
+  if (!step->paused || step->estop) return;
+  if (step->pauseVel != 0) {  // 连续速度模式
+    step->paused = 0;
+    Step_Jog(step, step->pauseVel);
+    step->pauseVel = 0;
+    return;
+  }
+  SAFE_ATOM_CODE {
+    step->paused = 0;
+    if (step->rotating) {  // 仍在减速, 直接改回原目标
+      running = 1;
+      if (step->mode == STEP_MODE_TRAPZ)
+        Step_Replan(step, step->pauseTarget, 1);
+    }
+  }
+  LOG_D("[STEP] Resume");
+  if (running) return;
+  delta = step->pauseTarget - step->pos;
+  if (delta > 1 || delta < -1) {
+    if (Step_Rotate_Load(step, delta > 0 ? delta : -delta, delta > 0 ? 1 : 0,
+                         0, 0))
+      Step_Rotate_Start(step);
+  } else {
+    Step_Queue_Pop(step);
+  }
+}
+
+/**
+ * @brief 急停, 可在任意上下文(包括中断)中调用
+ * @note 在同一个关中断区间内清除所有主定时器的CEN, 立即停止脉冲输出,
+ * 不调用HAL和日志; 正在输出的脉冲被强制为无效电平(STEP低电平);
+ * 各轴置暂停和急停标志, 完成中断和运动指令不再启动,
+ * 由Step_EStop_Clear停止, 恢复PWM模式并清理状态
+ */
+void Step_EStop(void) {
+  SAFE_ATOM_CODE {
+    for (uint8_t i = 0; i < step_num; i++) {
+      step_list[i]->timMaster->Instance->CR1 &= ~TIM_CR1_CEN;
+      Step_OC_Mode(step_list[i], TIM_OCMODE_FORCED_INACTIVE);
+      step_list[i]->paused = 1;
+      step_list[i]->estop = 1;
+    }
+  }
+  Step_EStop_Callback();
+}
+
+/**
+ * @brief 急停回调, 在Step_EStop中调用(可能在中断中), 用于唤醒调用
+ * Step_EStop_Clear的后台任务
+ */
+__weak void Step_EStop_Callback(void) {}
+
+/**
+ * @brief 急停后停止各轴并清理状态, 记录停止位置, 在后台任务中调用
+ * @note Step_Stop中HAL_DMA_Abort和日志依赖HAL_GetTick超时, 不可在实时任务
+ * (PendSV)中调用
+ */
+void Step_EStop_Clear(void) {
+  for (uint8_t i = 0; i < step_num; i++) {
+    if (!step_list[i]->estop) continue;
+    Step_Stop(step_list[i]);
+    Step_OC_Mode(step_list[i], TIM_OCMODE_PWM1);  // 与tim.c中的配置一致
+    step_list[i]->estop = 0;
+    LOG_W("[STEP] Emergency stop, axis %d", i);
+  }
+}
+
+/**
+ * @brief 手动停止步进电机
+ * @param  step           步进电机控制结构体
+ */
+void Step_Stop(step_ctrl_t *step) {
+  step->queueHead = step->queueTail;  // 先清空队列, 防止完成中断启动下一段
+  step->jogVel = 0;
+  step->paused = 0;
+  Step_Halt(step);
   LOG_D("[STEP] Manual stop");
 }
+/**
+ * @brief 获取从定时器中断分发的周期数(STEP_IRQ_PROFILE为1时有效)
+ * @param  last             最近一次
+ * @param  max              最大值
+ */
+void Step_Get_IRQ_Cycles(uint32_t *last, uint32_t *max) {
+#if STEP_IRQ_PROFILE
+  *last = step_irq_cycles;
+  *max = step_irq_cycles_max;
+#else
+  *last = 0;
+  *max = 0;
+#endif
+}
 
 /**
- * @brief 获取步进电机当前角度
+ * @brief 获取步进电机当前位置
  * @param  step             步进电机控制结构体
- * @retval
+ * @retval int64_t          当前位置(单位:脉冲), 由从定时器计数精确得到
  */
-double Step_Get_Angle(step_ctrl_t *step) {
-  if (!step->rotating) return step->angle;
-  double progress = (double)__HAL_TIM_GET_COUNTER(step->timSlave) /
-                    (double)__HAL_TIM_GET_AUTORELOAD(step->timSlave);
-  return (step->angleTarget - step->angle) * progress + step->angle;
+int64_t Step_Get_Pos(step_ctrl_t *step) {
+  int64_t pos, done = 0;
+  uint8_t dir = 0;
+  SAFE_ATOM_CODE {
+    pos = step->pos;
+    if (step->rotating) {
+      dir = step->dir;
+      if (step->slaveTimITCnt == 0 &&
+          __HAL_TIM_GET_FLAG(step->timSlave, TIM_FLAG_CC1) != RESET) {
+        pos = step->posTarget;  // 已走完, 完成中断尚未处理
+      } else {
+        done = step->slaveTimBase + __HAL_TIM_GET_COUNTER(step->timSlave);
+        if (step->jog &&
+            __HAL_TIM_GET_FLAG(step->timSlave, TIM_FLAG_CC1) != RESET &&
+            __HAL_TIM_GET_COUNTER(step->timSlave) < step->slaveTimMaxCnt / 2)
+          done += (int64_t)step->slaveTimMaxCnt + 1;  // 溢出中断尚未处理
+      }
+    }
+  }
+  return dir ? pos + done : pos - done;
 }
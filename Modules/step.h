@@ -13,6 +13,8 @@
 #include <main.h>
 #include <tim.h>
 
+#include "step_profile.h"
+
 /****************** 常量定义 ******************/
 // 电机参数相关
 #define STEP_BASE_PULSE 200  // 零细分脉冲数
@@ -23,25 +25,103 @@
 // 功能相关
 #define STEP_TIM_BASE_CLK 240000000  // 定时器时钟频率
 #define STEP_PWM_MAX_FREQ 20000      // PWM最大频率(防止丢步)
-// 从定时器 16bit=65535 32bit=4294967295
-#define STEP_SLAVE_TIM_MAX_CNT 65535
+
+// 加减速相关
+#define STEP_RAMP_TABLE_SIZE 1024  // 加减速表最大长度(脉冲数)
+#define STEP_RAMP_START_FREQ 100   // 加减速起步最低频率(Hz), 决定预分频
+#define STEP_PROFILE_CHUNK 64      // S曲线每次生成的脉冲数(双缓冲的一半)
+#define STEP_MAX_NUM 3             // 步进电机最大数量
+#define STEP_QUEUE_SIZE 16         // 运动段队列长度(必须为2的幂)
+#define STEP_SYNC_SKEW_LOG 0       // 打印多轴同步启动偏差
+#define STEP_STREAM_MIN_FREQ 25    // 流式速度模式最低输出频率(Hz), 决定预分频
+#define STEP_IRQ_DIRECT 1          // 从定时器中断直接分发(0:经HAL回调)
+#define STEP_IRQ_PROFILE 0         // 用DWT测量进入中断到开始处理的周期数
+#define STEP_IRQ_TABLE_SIZE 64     // 中断分发表长度(覆盖从定时器中断号)
+
+// 加减速表的分频系数, 与速度无关, 低于起步频率的速度不加减速
+#define STEP_RAMP_PSC (STEP_TIM_BASE_CLK / STEP_RAMP_START_FREQ / 0x10000 + 1)
+// 加减速时的脉宽, 最高频率下的半个周期, 不会超过任何一个周期
+#define STEP_RAMP_PULSE \
+  (STEP_TIM_BASE_CLK / STEP_RAMP_PSC / STEP_PWM_MAX_FREQ / 2)
+
+// 运动的加减速方式
+#define STEP_MODE_CONST 0   // 匀速
+#define STEP_MODE_TRAPZ 1   // 梯形加减速(加速表)
+#define STEP_MODE_SCURVE 2  // S曲线
 
 /****************** 数据类型定义 ******************/
 
+typedef struct {     // 主定时器速度配置, 在线程中求解, 中断中只做整数写入
+  uint32_t psc;      // 分频系数(PSC+1)
+  uint16_t arr;      // 匀速段重装载值
+  uint16_t rampLen;  // 加速到匀速段的长度(加速表下标), 梯形加减速有效
+  uint8_t mode;      // 加减速方式
+} step_speed_t;
+
+typedef struct {      // 排队等待执行的运动段
+  uint32_t pulse;     // 脉冲数
+  double speed;       // 入队时的设定速度, pulse/s, 只在线程中用于重新求解
+  step_speed_t spd;   // 入队时求解的速度配置
+  uint16_t entryIdx;  // 入口速度(加速表下标), 由前瞻规划计算
+  uint16_t exitIdx;   // 出口速度(加速表下标), 由前瞻规划计算
+  uint8_t dir;        // 转动方向
+  uint8_t planned;    // 已完成前瞻规划
+} step_seg_t;
+
 typedef struct {                 // 步进电机控制结构体
-  double speed;                  // 速度, deg/s
-  double angle;                  // 当前角度, deg
-  double angleTarget;            // 目标角度, deg
+  double speedSet;               // 设定速度, pulse/s
+  step_speed_t speedCfg;         // 设定速度的配置, 新的运动段使用
+  int64_t pos;                   // 当前位置, pulse
+  int64_t posTarget;             // 目标位置, pulse
   uint8_t rotating;              // 是否正在转动
   uint8_t dir;                   // 转动方向 (0:逆时针, 1:顺时针)
-  uint32_t slaveTimReload;       // 从定时器重装载值
+  uint32_t slaveTimMaxCnt;       // 从定时器最大计数值(由计数器位宽决定)
+  uint32_t slaveTimReload;       // 从定时器最后一段重装载值
   uint32_t slaveTimITCnt;        // 从定时器溢出中断计数
+  uint8_t slaveTimSplit;         // 最后一段不足2个脉冲, 前一段少计一个
+  uint32_t slaveTimBase;         // 当前计数段起始脉冲数
+  double accel;                  // 加速度, pulse/s^2 (0:不使用加减速)
+  double jerk;                   // 加加速度, pulse/s^3 (0:梯形加减速)
+  uint8_t mode;                  // 当前运动的加减速方式
+  uint16_t rampLen;              // 加减速表中加速到匀速段的长度
+  uint16_t rampMax;              // 加减速表有效长度(到最高频率为止)
+  double rampAccel;              // 加减速表对应的加速度
+  uint8_t rampStale;             // 加减速表需按设定加速度重新生成
+  uint16_t rampCrossArr;         // 加速表中被匀速段周期替换的原值
+  uint32_t rampPsc;              // 当前运动的主定时器分频系数
+  uint16_t cruiseArr;            // 当前运动的匀速段主定时器重装载值
+  uint32_t decelPulse;           // 开始减速的脉冲位置
+  uint32_t decelLen;             // 减速段脉冲数
+  uint16_t decelIdx;             // 减速段在减速表中的起始下标
+  uint16_t exitIdx;              // 当前段出口速度(加速表下标)
+  uint16_t rampEntry;            // 当前加减速规划的入口速度(加速表下标)
+  uint16_t rampPeak;             // 当前加减速规划的最高速度(加速表下标)
+  uint32_t rampAccLen;           // 入口变速到最高速度的脉冲数
+  uint32_t rampBase;             // 当前加减速规划开始时已走的脉冲数
+  uint32_t pulseTotal;           // 当前段总脉冲数
+  uint8_t jog;                   // 连续速度模式(从定时器只用于位置计数)
+  double jogVel;                 // 换向停止后待启动的连续速度, pulse/s
+  uint8_t stream;                // 流式速度模式(由上层实时写入速度)
+  uint8_t rampDirty;             // 减速表被限距停止改写, 需重新镜像
+  uint8_t paused;                // 已暂停, 完成中断不启动队列中的下一段
+  uint8_t estop;                 // 已急停, 等待规划任务清理状态
+  int64_t pauseTarget;           // 暂停时当前段的目标位置, pulse
+  double pauseVel;               // 暂停时连续速度模式的速度, pulse/s
+  uint16_t *rampAccTable;        // 加速段ARR表(DMA写入, 位于DMA缓冲区)
+  uint16_t *rampDecTable;        // 减速段ARR表(DMA写入, 位于DMA缓冲区)
+  step_scurve_t scurve;          // S曲线规划器
+  uint16_t *profileBuf;          // S曲线ARR双缓冲(DMA循环, 位于DMA缓冲区)
   TIM_HandleTypeDef *timMaster;  // 主定时器句柄(用于PWM输出)
   TIM_HandleTypeDef *timSlave;   // 从定时器句柄(用于脉冲计数)
   uint32_t timMasterCh;          // 主定时器通道
   GPIO_TypeDef *dirPort;         // 方向控制端口
   uint16_t dirPin;               // 方向控制引脚
   uint8_t dirLogic;              // 方向控制逻辑
+  step_seg_t queue[STEP_QUEUE_SIZE];  // 运动段队列(完成中断中出队)
+  volatile uint8_t queueHead;         // 出队位置
+  volatile uint8_t queueTail;         // 入队位置(仅主循环修改)
+  volatile uint8_t planDirty;         // 队列有变化, 需要重新规划
+  int64_t posQueued;                  // 队列中最后一段的终点位置, pulse
 } step_ctrl_t;
 
 /****************** 宏函数声明 ******************/
@@ -51,16 +131,55 @@ typedef struct {                 // 步进电机控制结构体
 #define __STEP_STOP_PWM(step) \
   HAL_TIM_PWM_Stop_IT(step->timMaster, step->timMasterCh)
 
+// 在TIMx_IRQHandler入口记录DWT周期计数, 用于比较两种中断分发方式
+#if STEP_IRQ_PROFILE
+extern uint32_t step_irq_cyc_start;
+#define STEP_IRQ_PROFILE_BEGIN() (step_irq_cyc_start = DWT->CYCCNT)
+#else
+#define STEP_IRQ_PROFILE_BEGIN()
+#endif
+
+// 角度与脉冲换算, 只在通信协议等对外接口处使用
+#define STEP_DEG_TO_PULSE(deg) ((deg) * STEP_PULSE_PER_ROUND / 360.0)
+#define STEP_DEG_TO_POS(deg) \
+  ((int64_t)(STEP_DEG_TO_PULSE(deg) + ((deg) < 0 ? -0.5 : 0.5)))
+#define STEP_POS_TO_DEG(pos) ((double)(pos) * 360.0 / STEP_PULSE_PER_ROUND)
+
 /****************** 函数声明 ******************/
 
 void Step_Init(step_ctrl_t *step, TIM_HandleTypeDef *timMaster,
                TIM_HandleTypeDef *timSlave, uint32_t timMasterCh,
                GPIO_TypeDef *dirPort, uint16_t dirPin, uint8_t dirLogic);
 void Step_IT_Handler(step_ctrl_t *step, TIM_HandleTypeDef *htim);
+void Step_IRQ_Handler(IRQn_Type irqn);
+void Step_Get_IRQ_Cycles(uint32_t *last, uint32_t *max);
 void Step_Set_Speed(step_ctrl_t *step, double speed);
-void Step_Rotate(step_ctrl_t *step, double angle);
-void Step_Rotate_Abs(step_ctrl_t *step, double angle);
-void Step_Set_Angle(step_ctrl_t *step, double angle);
-double Step_Get_Angle(step_ctrl_t *step);
+double Step_Get_Speed(step_ctrl_t *step);
+void Step_Set_Accel(step_ctrl_t *step, double accel);
+void Step_Set_Jerk(step_ctrl_t *step, double jerk);
+void Step_Rotate(step_ctrl_t *step, int32_t pulse);
+void Step_Rotate_Abs(step_ctrl_t *step, int64_t pos);
+void Step_Rotate_Sync(step_ctrl_t **steps, int64_t *pulses, uint8_t num,
+                      double speed);
+void Step_Set_Pos(step_ctrl_t *step, int64_t pos);
+int64_t Step_Get_Pos(step_ctrl_t *step);
+uint8_t Step_Queue_Depth(step_ctrl_t *step);
+uint8_t Step_Queue_Planned(step_ctrl_t *step);
+void Step_Planner_Task(void);
+void Step_Group_Begin(void);
+void Step_Group_End(void);
+uint32_t Step_Get_Sync_Skew(void);
+void Step_Retarget(step_ctrl_t *step, int64_t pos, double speed);
+void Step_Jog(step_ctrl_t *step, double velocity);
+void Step_Stream_Begin(step_ctrl_t *step);
+void Step_Stream_Velocity(step_ctrl_t *step, double velocity);
+void Step_Stream_End(step_ctrl_t *step);
+void Step_Stop_Ramp(step_ctrl_t *step, uint32_t dist);
+void Step_Pause(step_ctrl_t *step);
+void Step_Resume(step_ctrl_t *step);
+void Step_EStop(void);
+void Step_EStop_Clear(void);
+void Step_EStop_Callback(void);
 void Step_Stop(step_ctrl_t *step);
+void Step_Finished_Callback(step_ctrl_t *step);
 #endif
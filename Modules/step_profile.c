@@ -0,0 +1,227 @@
+/**
+ * @file step_profile.c
+ * @brief 步进电机加减速曲线: 梯形加速表与七段式S曲线(限制加加速度)
+ * 梯形加速表与加速度以外的参数无关, 在线程中一次生成;
+ * S曲线规划只保存各段边界状态, 每个脉冲的时刻在需要时用牛顿迭代反解,
+ * 按块生成ARR序列, 不需要在内存中保存完整的周期表
+ * @author Ellu (lutaoyu@163.com)
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include "step_profile.h"
+
+#include <math.h>
+
+/**
+ * @brief 段内位置
+ */
+static inline double SCurve_Pos(step_scurve_t *sc, uint8_t seg, double tau) {
+  double j = sc->segJ[seg] * sc->jerk;
+  return sc->segS[seg] +
+         tau * (sc->segV[seg] + tau * (sc->segA[seg] / 2 + tau * j / 6));
+}
+
+/**
+ * @brief 段内速度
+ */
+static inline double SCurve_Vel(step_scurve_t *sc, uint8_t seg, double tau) {
+  double j = sc->segJ[seg] * sc->jerk;
+  return sc->segV[seg] + tau * (sc->segA[seg] + tau * j / 2);
+}
+
+/**
+ * @brief 规划一段从静止到静止的S曲线运动
+ * @param  sc               规划器
+ * @param  pulse            总脉冲数
+ * @param  vmax             最大速度, pulse/s
+ * @param  amax             最大加速度, pulse/s^2
+ * @param  jmax             最大加加速度, pulse/s^3
+ * @param  tickFreq         定时器计数频率
+ * @param  maxTicks         单个脉冲最大计数值
+ * @retval double           实际峰值速度(距离不足时低于vmax)
+ */
+double SCurve_Plan(step_scurve_t *sc, uint32_t pulse, double vmax,
+                   double amax, double jmax, double tickFreq,
+                   uint32_t maxTicks) {
+  double tj, ta, tv, v, j;
+  uint8_t i;
+  // 加速段: tj为加加速时间, ta为整个加速段时间
+  if (vmax * jmax >= amax * amax) {
+    tj = amax / jmax;
+    ta = tj + vmax / amax;
+  } else {  // 达不到最大加速度
+    tj = sqrt(vmax / jmax);
+    ta = 2 * tj;
+  }
+  if (vmax * ta > pulse) {  // 距离不足以达到最大速度
+    j = amax * amax / jmax;
+    v = (-j + sqrt(j * j + 4.0 * pulse * amax)) / 2;
+    if (v * jmax >= amax * amax) {
+      tj = amax / jmax;
+      ta = tj + v / amax;
+    } else {
+      v = cbrt((double)pulse * pulse * jmax / 4);
+      tj = sqrt(v / jmax);
+      ta = 2 * tj;
+    }
+    vmax = v;
+  }
+  tv = (pulse - vmax * ta) / vmax;
+  if (tv < 0) tv = 0;
+
+  sc->jerk = jmax;
+  sc->segT[0] = sc->segT[2] = sc->segT[4] = sc->segT[6] = tj;
+  sc->segT[1] = sc->segT[5] = ta - 2 * tj;
+  sc->segT[3] = tv;
+  sc->segJ[0] = 1;
+  sc->segJ[1] = 0;
+  sc->segJ[2] = -1;
+  sc->segJ[3] = 0;
+  sc->segJ[4] = -1;
+  sc->segJ[5] = 0;
+  sc->segJ[6] = 1;
+  sc->segT0[0] = sc->segS[0] = sc->segV[0] = sc->segA[0] = 0;
+  for (i = 0; i < 7; i++) {
+    double t = sc->segT[i];
+    sc->segT0[i + 1] = sc->segT0[i] + t;
+    sc->segS[i + 1] = SCurve_Pos(sc, i, t);
+    sc->segV[i + 1] = SCurve_Vel(sc, i, t);
+    sc->segA[i + 1] = sc->segA[i] + sc->segJ[i] * jmax * t;
+  }
+  sc->seg = 0;
+  sc->tau = 0;
+  sc->tickFreq = tickFreq;
+  sc->maxTicks = maxTicks;
+  sc->ticksLast = 0;
+  sc->arrLast = maxTicks - 1;
+  sc->pulse = 0;
+  sc->total = pulse;
+  return vmax;
+}
+
+/**
+ * @brief 求解下一个脉冲的绝对时刻
+ * @param  sc               规划器
+ * @retval double           时刻, s
+ */
+static double SCurve_Next_Time(step_scurve_t *sc) {
+  double target = sc->pulse + 1;
+  double tau = sc->tau;
+  double f, v;
+  uint8_t i;
+  if (target >= sc->segS[7]) {  // 末端速度为0, 直接取终点
+    sc->seg = 6;
+    sc->tau = sc->segT[6];
+    return sc->segT0[7];
+  }
+  while (sc->seg < 6 && target > sc->segS[sc->seg + 1]) {
+    sc->seg++;
+    tau = 0;
+  }
+  if (sc->segV[sc->seg] <= 0 && sc->segA[sc->seg] <= 0) {
+    // 起步段从静止开始, s = j*t^3/6 有解析解
+    tau = cbrt(6 * (target - sc->segS[sc->seg]) / sc->jerk);
+  } else {
+    for (i = 0; i < 4; i++) {
+      f = SCurve_Pos(sc, sc->seg, tau) - target;
+      v = SCurve_Vel(sc, sc->seg, tau);
+      if (v < 1e-9) break;
+      tau -= f / v;
+      if (tau < 0) tau = 0;
+      if (tau > sc->segT[sc->seg]) tau = sc->segT[sc->seg];
+      if (f < 1e-6 && f > -1e-6) break;
+    }
+  }
+  sc->tau = tau;
+  return sc->segT0[sc->seg] + tau;
+}
+
+/**
+ * @brief 生成接下来的ARR序列, 规划结束后用最后一个值填充
+ * @param  sc               规划器
+ * @param  buf              输出缓冲区
+ * @param  len              缓冲区长度
+ * @retval uint32_t         实际生成的脉冲数
+ */
+uint32_t SCurve_Fill(step_scurve_t *sc, uint16_t *buf, uint32_t len) {
+  uint32_t i, ticks;
+  uint64_t ticksNow;
+  for (i = 0; i < len && sc->pulse < sc->total; i++) {
+    // 对绝对时刻取整后差分, 量化误差不会累积
+    ticksNow = SCurve_Next_Time(sc) * sc->tickFreq + 0.5;
+    ticks = ticksNow - sc->ticksLast;
+    sc->ticksLast = ticksNow;
+    if (ticks > sc->maxTicks) ticks = sc->maxTicks;  // 起步频率限制
+    if (ticks < 2) ticks = 2;
+    sc->arrLast = ticks - 1;
+    buf[i] = sc->arrLast;
+    sc->pulse++;
+  }
+  for (uint32_t k = i; k < len; k++) buf[k] = sc->arrLast;
+  return i;
+}
+
+/**
+ * @brief 匀加速从静止开始第i个脉冲的周期计数值
+ * @param  accel            加速度, pulse/s^2
+ * @param  tickFreq         定时器计数频率
+ * @param  i                脉冲序号, 从0开始
+ * @retval uint32_t         计数值(ARR+1), 未限制上限
+ * @note 第n个脉冲的时刻 t(n) = sqrt(2n/a), 对绝对时刻取整后差分,
+ * 前n个周期之和与理想时刻的误差不超过半个计数
+ */
+uint32_t Ramp_Ticks(double accel, double tickFreq, uint32_t i) {
+  uint64_t now = sqrt(2.0 * (i + 1) / accel) * tickFreq + 0.5;
+  uint64_t last = i ? sqrt(2.0 * i / accel) * tickFreq + 0.5 : 0;
+  return now - last;
+}
+
+/**
+ * @brief 生成匀加速ARR表, 第i项为从静止开始第i个脉冲的ARR
+ * @param  table            输出表
+ * @param  size             表容量
+ * @param  accel            加速度, pulse/s^2
+ * @param  tickFreq         定时器计数频率
+ * @param  minTicks         最小计数值(最高频率), 超过最高频率时停止
+ * @retval uint16_t         表有效长度
+ * @note 低于起步频率的周期限制为0x10000
+ */
+uint16_t Ramp_Build(uint16_t *table, uint16_t size, double accel,
+                    double tickFreq, uint32_t minTicks) {
+  uint32_t ticks;
+  uint16_t i;
+  for (i = 0; i < size; i++) {
+    ticks = Ramp_Ticks(accel, tickFreq, i);
+    if (ticks < minTicks) break;
+    table[i] = ticks > 0x10000 ? 0xFFFF : ticks - 1;
+  }
+  return i;
+}
+
+/**
+ * @brief 查找加速表中第一个不长于指定计数值的周期
+ * @param  accel            加速度, pulse/s^2
+ * @param  tickFreq         定时器计数频率
+ * @param  len              表有效长度
+ * @param  ticks            计数值(ARR+1)
+ * @retval uint16_t         下标, 表中没有时返回len
+ * @note 直接由Ramp_Ticks二分查找, 不读取表(表的内容可能正被中断修改)
+ */
+uint16_t Ramp_Find(double accel, double tickFreq, uint16_t len,
+                   uint32_t ticks) {
+  uint16_t lo = 0, hi = len, mid;
+  uint32_t t;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    t = Ramp_Ticks(accel, tickFreq, mid);
+    if (t > 0x10000) t = 0x10000;
+    if (t <= ticks)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file step_profile.h
+ * @brief see step_profile.c
+ * @author Ellu (lutaoyu@163.com)
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * THINK DIFFERENTLY
+ */
+
+#ifndef __STEP_PROFILE_H
+#define __STEP_PROFILE_H
+#include <stdint.h>
+
+/****************** 数据类型定义 ******************/
+
+typedef struct {        // 七段式S曲线规划器(单位: 脉冲, 秒)
+  double jerk;          // 加加速度, pulse/s^3
+  double segT[7];       // 各段时长
+  double segT0[8];      // 各段起始时刻
+  double segS[8];       // 各段起点位置
+  double segV[8];       // 各段起点速度
+  double segA[8];       // 各段起点加速度
+  int8_t segJ[7];       // 各段加加速度方向
+  uint8_t seg;          // 当前段
+  double tau;           // 上一个脉冲在当前段内的时刻
+  double tickFreq;      // 定时器计数频率
+  uint32_t maxTicks;    // 单个脉冲最大计数值(起步频率限制)
+  uint64_t ticksLast;   // 上一个脉冲的绝对计数值
+  uint16_t arrLast;     // 上一个输出的ARR
+  uint32_t pulse;       // 已生成脉冲数
+  uint32_t total;       // 总脉冲数
+} step_scurve_t;
+
+/****************** 函数声明 ******************/
+
+double SCurve_Plan(step_scurve_t *sc, uint32_t pulse, double vmax,
+                   double amax, double jmax, double tickFreq,
+                   uint32_t maxTicks);
+uint32_t SCurve_Fill(step_scurve_t *sc, uint16_t *buf, uint32_t len);
+uint32_t Ramp_Ticks(double accel, double tickFreq, uint32_t i);
+uint16_t Ramp_Build(uint16_t *table, uint16_t size, double accel,
+                    double tickFreq, uint32_t minTicks);
+uint16_t Ramp_Find(double accel, double tickFreq, uint16_t len,
+                   uint32_t ticks);
+
+#endif
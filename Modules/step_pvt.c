@@ -0,0 +1,196 @@
+/**
+ * @file step_pvt.c
+ * @brief 步进电机位置-时间(PT)/位置-速度-时间(PVT)轨迹点流式执行
+ * 主机连续发送带时间戳的轨迹点, 串口中断中写入环形缓冲, 插补任务按本地
+ * 时钟在相邻两点间插值, 以"前馈速度+位置误差修正"写入各轴流式速度;
+ * 缓冲预填充若干点吸收串口延迟抖动, 缓冲取空时冻结轨迹时钟并计数
+ * @author Ellu (lutaoyu@163.com)
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include "step_pvt.h"
+
+#include "uart_pack.h"
+
+enum {
+  PVT_IDLE = 0,  // 未启用
+  PVT_FILL,      // 预填充抖动缓冲
+  PVT_RUN,       // 执行中
+};
+
+static step_ctrl_t *pvt_steps[STEP_MAX_NUM];  // 参与的步进电机
+static uint8_t pvt_num = 0;
+static pvt_point_t pvt_buf[PVT_BUF_SIZE];  // 轨迹点环形缓冲
+static volatile uint8_t pvt_head = 0;      // 出队位置(仅插补任务修改)
+static volatile uint8_t pvt_tail = 0;      // 入队位置(仅串口中断修改)
+static volatile uint8_t pvt_state = PVT_IDLE;
+static volatile uint8_t pvt_ending = 0;  // 主机已发送结束, 取空后停止
+static uint8_t pvt_starved = 0;          // 缓冲已取空, 等待新的点
+static uint16_t pvt_underrun = 0;        // 缓冲取空次数
+static double pvt_now = 0;               // 当前轨迹时刻, ms
+
+/**
+ * @brief 开始接收轨迹点, 各轴需处于静止状态
+ * @param  steps            参与的步进电机, 顺序与轨迹点中各轴对应
+ * @param  num              电机数量
+ */
+void PVT_Begin(step_ctrl_t **steps, uint8_t num) {
+  ASSERT(num > 0 && num <= STEP_MAX_NUM, "[PVT] bad axis num", return);
+  if (pvt_state != PVT_IDLE) PVT_Abort();
+  for (uint8_t i = 0; i < num; i++) {
+    ASSERT(!steps[i]->rotating, "[PVT] axis busy", return);
+    pvt_steps[i] = steps[i];
+  }
+  pvt_num = num;
+  pvt_head = pvt_tail;
+  pvt_ending = 0;
+  pvt_starved = 0;
+  pvt_underrun = 0;
+  pvt_state = PVT_FILL;
+  LOG_D("[PVT] begin, %d axis", num);
+}
+
+/**
+ * @brief 写入一个轨迹点, 可在串口中断中调用
+ * @param  point            轨迹点, 位置单位为脉冲
+ * @retval uint8_t          1: 成功, 0: 未启用/缓冲已满/时间戳未递增
+ */
+uint8_t PVT_Push(const pvt_point_t *point) {
+  pvt_point_t *last;
+  if (pvt_state == PVT_IDLE || pvt_ending) return 0;
+  if ((uint8_t)(pvt_tail - pvt_head) >= PVT_BUF_SIZE) return 0;
+  if (pvt_tail != pvt_head) {
+    last = &pvt_buf[(uint8_t)(pvt_tail - 1) % PVT_BUF_SIZE];
+    if ((int32_t)(point->time - last->time) <= 0) return 0;
+  }
+  pvt_buf[pvt_tail % PVT_BUF_SIZE] = *point;
+  pvt_tail++;
+  return 1;
+}
+
+/**
+ * @brief 主机轨迹发送完毕, 执行完缓冲中的点并到达终点后停止
+ */
+void PVT_End(void) {
+  if (pvt_state != PVT_IDLE) pvt_ending = 1;
+}
+
+/**
+ * @brief 立即停止流式执行, 丢弃缓冲中的点
+ */
+void PVT_Abort(void) {
+  if (pvt_state == PVT_RUN) {
+    for (uint8_t i = 0; i < pvt_num; i++) Step_Stream_End(pvt_steps[i]);
+  }
+  pvt_state = PVT_IDLE;
+  pvt_head = pvt_tail;
+  pvt_ending = 0;
+}
+
+/**
+ * @brief 获取缓冲中的轨迹点数
+ */
+uint8_t PVT_Depth(void) { return (uint8_t)(pvt_tail - pvt_head); }
+
+/**
+ * @brief 获取缓冲取空次数
+ */
+uint16_t PVT_Underrun(void) { return pvt_underrun; }
+
+/**
+ * @brief 在两点间插值
+ * @param  p0               区间起点
+ * @param  p1               区间终点
+ * @param  axis             轴序号
+ * @param  t                区间内时刻, ms
+ * @param  vel              输出速度, pulse/s
+ * @retval double           相对起点的位置, pulse
+ */
+static double PVT_Interp(pvt_point_t *p0, pvt_point_t *p1, uint8_t axis,
+                         double t, double *vel) {
+  double T = (p1->time - p0->time) / 1000.0;
+  double s = t / (p1->time - p0->time);
+  double d = p1->pos[axis] - p0->pos[axis];
+  double v0, v1;
+  if (s < 0) s = 0;
+  if (s > 1) s = 1;
+  if (!p0->hasVel || !p1->hasVel) {  // PT点线性插值
+    *vel = d / T;
+    return d * s;
+  }
+  // 三次Hermite插值, 端点位置和速度连续
+  v0 = p0->vel[axis] * T;
+  v1 = p1->vel[axis] * T;
+  *vel = ((6 * s * s - 6 * s) * -d + (3 * s * s - 4 * s + 1) * v0 +
+          (3 * s * s - 2 * s) * v1) /
+         T;
+  return s * s * (3 - 2 * s) * d + s * (s - 1) * (s - 1) * v0 +
+         s * s * (s - 1) * v1;
+}
+
+/**
+ * @brief 插补任务, 在调度器中以1kHz调用
+ * @param  dtS              距上次调用的实测时间, s
+ */
+void PVT_Task(float dtS) {
+  double dt = dtS * 1000.0;  // ms
+  double target, vel;
+  int64_t err;
+  pvt_point_t *p0, *p1;
+  uint8_t depth, done = 1;
+  if (pvt_state == PVT_IDLE) return;
+  depth = pvt_tail - pvt_head;
+  if (pvt_state == PVT_FILL) {
+    if (depth == 0 || (depth < PVT_PREFILL && !pvt_ending)) return;
+    for (uint8_t i = 0; i < pvt_num; i++) Step_Stream_Begin(pvt_steps[i]);
+    pvt_now = pvt_buf[pvt_head % PVT_BUF_SIZE].time;
+    pvt_state = PVT_RUN;
+    dt = 0;
+  }
+  for (uint8_t i = 0; i < pvt_num; i++) {
+    if (!pvt_steps[i]->stream) {  // 被急停或手动停止
+      PVT_Abort();
+      LOG_W("[PVT] axis stopped, abort");
+      return;
+    }
+  }
+  pvt_now += dt;
+  // 丢弃已经过去的点, 保留当前区间的起点
+  while (depth >= 2 &&
+         pvt_buf[(uint8_t)(pvt_head + 1) % PVT_BUF_SIZE].time <= pvt_now) {
+    pvt_head++;
+    depth--;
+  }
+  p0 = &pvt_buf[pvt_head % PVT_BUF_SIZE];
+  p1 = &pvt_buf[(uint8_t)(pvt_head + 1) % PVT_BUF_SIZE];
+  if (depth < 2) {  // 只剩最后一个点, 冻结轨迹时钟并保持位置
+    if (!pvt_ending && !pvt_starved) {
+      pvt_starved = 1;
+      pvt_underrun++;
+      LOG_W("[PVT] buffer underrun");
+    }
+    pvt_now = p0->time;
+  } else {
+    pvt_starved = 0;
+  }
+  for (uint8_t i = 0; i < pvt_num; i++) {
+    if (depth < 2) {
+      target = 0;
+      vel = 0;
+    } else {
+      target = PVT_Interp(p0, p1, i, pvt_now - p0->time, &vel);
+    }
+    err = p0->pos[i] + (int64_t)target - Step_Get_Pos(pvt_steps[i]);
+    if (err > PVT_FINISH_ERR || err < -PVT_FINISH_ERR) done = 0;
+    Step_Stream_Velocity(pvt_steps[i], vel + PVT_KP * err);
+  }
+  if (depth < 2 && pvt_ending && done) {
+    for (uint8_t i = 0; i < pvt_num; i++) Step_Stream_End(pvt_steps[i]);
+    pvt_head = pvt_tail;
+    pvt_state = PVT_IDLE;
+    LOG_D("[PVT] finished, underrun %d", pvt_underrun);
+  }
+}
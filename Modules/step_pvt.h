@@ -0,0 +1,42 @@
+/**
+ * @file step_pvt.h
+ * @brief see step_pvt.c
+ * @author Ellu (lutaoyu@163.com)
+ * @version 1.0
+ * @date 2026-10-17
+ *
+ * THINK DIFFERENTLY
+ */
+
+#ifndef __STEP_PVT_H
+#define __STEP_PVT_H
+#include "step.h"
+
+/****************** 常量定义 ******************/
+
+#define PVT_BUF_SIZE 64      // 轨迹点缓冲长度(必须为2的幂)
+#define PVT_PREFILL 10       // 开始执行前预先缓冲的点数(抖动缓冲)
+#define PVT_KP 30.0          // 位置误差修正增益, 1/s
+#define PVT_FINISH_ERR 1     // 结束时允许的位置误差, pulse
+#define PVT_MAX_PER_FRAME 4  // 每帧最多携带的轨迹点数
+
+/****************** 数据类型定义 ******************/
+
+typedef struct {               // 轨迹点
+  uint32_t time;               // 时间戳, ms (主机时钟)
+  int64_t pos[STEP_MAX_NUM];   // 各轴位置, pulse
+  float vel[STEP_MAX_NUM];     // 各轴速度, pulse/s (仅PVT点)
+  uint8_t hasVel;              // 1:PVT点(三次Hermite插值), 0:PT点(线性)
+} pvt_point_t;
+
+/****************** 函数声明 ******************/
+
+void PVT_Begin(step_ctrl_t **steps, uint8_t num);
+uint8_t PVT_Push(const pvt_point_t *point);
+void PVT_End(void);
+void PVT_Abort(void);
+void PVT_Task(float dtS);
+uint8_t PVT_Depth(void);
+uint16_t PVT_Underrun(void);
+
+#endif
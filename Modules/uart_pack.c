@@ -16,10 +16,10 @@
 #include "string.h"
 
 #if _UART_PRINT_PINGPONG
-char sendBuff1[_UART_SEND_BUFFER_SIZE];  // 发送缓冲区1
-char sendBuff2[_UART_SEND_BUFFER_SIZE];  // 发送缓冲区2
+char sendBuff1[_UART_SEND_BUFFER_SIZE] __DMA_BUFFER;  // 发送缓冲区1
+char sendBuff2[_UART_SEND_BUFFER_SIZE] __DMA_BUFFER;  // 发送缓冲区2
 #else
-char sendBuff[_UART_SEND_BUFFER_SIZE];  // 发送缓冲区
+char sendBuff[_UART_SEND_BUFFER_SIZE] __DMA_BUFFER;  // 发送缓冲区
 #endif
 
 #if _UART_PRINT_DMA
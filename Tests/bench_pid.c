@@ -0,0 +1,129 @@
+/**
+ * @file bench_pid.c
+ * @brief 浮点/Q15/Q31 PID每次计算的耗时, 以及定点版本与浮点版本的偏差
+ * 主机上测得的是主机耗时(x86上同时给出TSC周期数), 只用于比较三种实现和
+ * 改动前后, 不等于H750上的周期数; 偏差检查使用大小相差悬殊的系数
+ * (kb按共用移位数量化会变为0), 闭环运行并经过输出饱和
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "pid.h"
+
+#define DT 1e-4f  // 控制周期, s
+#define KP 4.0f
+#define KI 20.0f     // 1/s
+#define KD 0.002f    // s
+#define OUT_MAX 0.5f
+#define TAU 0.01     // 被控对象时间常数, s
+#define STEPS 6000   // 闭环仿真步数
+#define REPEAT 1000000
+
+#define Q15 32768.0
+#define Q31 2147483648.0
+
+static double Now_Ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t Now_Cyc(void) {
+#if HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static float Set_Point(int i) {
+  if (i < STEPS / 3) return 0.3f;
+  if (i < STEPS * 2 / 3) return 0.9f;  // 超出输出上限, 积分饱和
+  return 0.2f;
+}
+
+/**
+ * @brief 三种实现各自闭环控制一阶对象, 比较定点与浮点的输出
+ */
+static void Check_Accuracy(void) {
+  pid_f32_t pf;
+  pid_q15_t p15;
+  pid_q31_t p31;
+  double yf = 0, y15 = 0, y31 = 0, uf, u15, u31, e15 = 0, e31 = 0;
+  PID_F32_Init(&pf, KP, KI, KD, -OUT_MAX, OUT_MAX);
+  PID_Q15_Init(&p15, KP, KI, KD, DT, -OUT_MAX * Q15, OUT_MAX * Q15);
+  PID_Q31_Init(&p31, KP, KI, KD, DT, -OUT_MAX * Q31, OUT_MAX * Q31);
+  assert(p15.kb != 0 && p31.kb != 0);
+  for (int i = 0; i < STEPS; i++) {
+    uf = PID_F32_Update(&pf, Set_Point(i), yf, DT);
+    u15 = PID_Q15_Update(&p15, Set_Point(i) * Q15, y15 * Q15) / Q15;
+    u31 = PID_Q31_Update(&p31, Set_Point(i) * Q31, y31 * Q31) / Q31;
+    yf += (uf - yf) * DT / TAU;
+    y15 += (u15 - y15) * DT / TAU;
+    y31 += (u31 - y31) * DT / TAU;
+    if (fabs(u15 - uf) > e15) e15 = fabs(u15 - uf);
+    if (fabs(u31 - uf) > e31) e31 = fabs(u31 - uf);
+  }
+  printf("max |u - u_f32|: q15 %.2e, q31 %.2e\n", e15, e31);
+  assert(e15 < 2e-3);
+  assert(e31 < 1e-3);  // 主要是浮点版本积分项的舍入误差
+}
+
+/**
+ * @brief 测量每次计算的耗时, 设定值和测量值每次都变化
+ */
+static void Bench(void) {
+  pid_f32_t pf;
+  pid_q15_t p15;
+  pid_q31_t p31;
+  volatile float sf = 0;
+  volatile int32_t s15 = 0, s31 = 0;
+  double t0, tf, t15, t31;
+  uint64_t c0, cf, c15, c31;
+  PID_F32_Init(&pf, KP, KI, KD, -OUT_MAX, OUT_MAX);
+  PID_Q15_Init(&p15, KP, KI, KD, DT, -OUT_MAX * Q15, OUT_MAX * Q15);
+  PID_Q31_Init(&p31, KP, KI, KD, DT, -OUT_MAX * Q31, OUT_MAX * Q31);
+  t0 = Now_Ns();
+  c0 = Now_Cyc();
+  for (int i = 0; i < REPEAT; i++)
+    sf += PID_F32_Update(&pf, (i & 0xFF) * 1e-3f, (i & 0x7F) * 1e-3f, DT);
+  cf = Now_Cyc() - c0;
+  tf = Now_Ns() - t0;
+  t0 = Now_Ns();
+  c0 = Now_Cyc();
+  for (int i = 0; i < REPEAT; i++)
+    s15 += PID_Q15_Update(&p15, (i & 0xFF) << 5, (i & 0x7F) << 5);
+  c15 = Now_Cyc() - c0;
+  t15 = Now_Ns() - t0;
+  t0 = Now_Ns();
+  c0 = Now_Cyc();
+  for (int i = 0; i < REPEAT; i++)
+    s31 += PID_Q31_Update(&p31, (i & 0xFF) << 21, (i & 0x7F) << 21);
+  c31 = Now_Cyc() - c0;
+  t31 = Now_Ns() - t0;
+  printf("f32 %5.1f ns %5.1f cyc, q15 %5.1f ns %5.1f cyc, "
+         "q31 %5.1f ns %5.1f cyc per update\n",
+         tf / REPEAT, (double)cf / REPEAT, t15 / REPEAT,
+         (double)c15 / REPEAT, t31 / REPEAT, (double)c31 / REPEAT);
+}
+
+int main(void) {
+#if !HAVE_TSC
+  printf("no TSC on this host, cycles reported as 0\n");
+#endif
+  Check_Accuracy();
+  Bench();
+  printf("bench_pid passed\n");
+  return 0;
+}
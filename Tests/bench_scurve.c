@@ -0,0 +1,94 @@
+/**
+ * @file bench_scurve.c
+ * @brief SCurve_Plan/SCurve_Fill 每脉冲耗时
+ * 主机上测得的是主机耗时(x86上同时给出TSC周期数), 只用于比较改动前后,
+ * 不等于H750上的周期数; 同时检查生成的周期序列总时长与规划一致
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "step_profile.h"
+
+#define TICK_FREQ (240000000.0 / 37)
+#define CHUNK 64
+#define REPEAT 20
+
+static uint16_t buf[CHUNK];
+
+static double Now_Ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t Now_Cyc(void) {
+#if HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief 规划并生成一整段运动, 返回总计数值
+ */
+static uint64_t Run_Once(step_scurve_t *sc, uint32_t pulse) {
+  uint64_t sum = 0;
+  uint32_t n, i;
+  SCurve_Plan(sc, pulse, 20000, 200000, 4000000, TICK_FREQ, 0x10000);
+  do {
+    n = SCurve_Fill(sc, buf, CHUNK);
+    for (i = 0; i < n; i++) sum += (uint64_t)buf[i] + 1;
+  } while (n == CHUNK);
+  return sum;
+}
+
+static void Bench(uint32_t pulse) {
+  step_scurve_t sc;
+  double t0, tPlan = 0, tFill = 0;
+  uint64_t c0, cPlan = 0, cFill = 0, sum = 0;
+  uint32_t n, r;
+  for (r = 0; r < REPEAT; r++) {
+    t0 = Now_Ns();
+    c0 = Now_Cyc();
+    SCurve_Plan(&sc, pulse, 20000, 200000, 4000000, TICK_FREQ, 0x10000);
+    cPlan += Now_Cyc() - c0;
+    tPlan += Now_Ns() - t0;
+    t0 = Now_Ns();
+    c0 = Now_Cyc();
+    do {
+      n = SCurve_Fill(&sc, buf, CHUNK);
+    } while (n == CHUNK);
+    cFill += Now_Cyc() - c0;
+    tFill += Now_Ns() - t0;
+  }
+  // 总时长: 各周期之和等于规划终点时刻(起步限频只会缩短)
+  sum = Run_Once(&sc, pulse);
+  assert(sum <= sc.segT0[7] * TICK_FREQ + 1);
+  assert(sum > sc.segT0[7] * TICK_FREQ * 0.95);
+  printf("pulse %7u: plan %7.0f ns %8.0f cyc, fill %6.1f ns %6.1f cyc/pulse\n",
+         pulse, tPlan / REPEAT, (double)cPlan / REPEAT,
+         tFill / REPEAT / pulse, (double)cFill / REPEAT / pulse);
+}
+
+int main(void) {
+#if !HAVE_TSC
+  printf("no TSC on this host, cycles reported as 0\n");
+#endif
+  Bench(1000);
+  Bench(20000);
+  Bench(200000);
+  printf("bench_scurve passed\n");
+  return 0;
+}
@@ -0,0 +1,416 @@
+/**
+ * @file host_hal.c
+ * @brief 主机测试用的HAL替身和定时器/DMA行为模型, 见host_hal.h
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include "host_hal.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "usart.h"
+
+DWT_Type host_dwt;
+SCB_Type host_scb;
+CoreDebug_Type host_core_debug;
+uint32_t host_primask = 0;
+uint32_t host_basepri = 0;
+uint32_t SystemCoreClock = 480000000;
+GPIO_TypeDef host_gpio[4];
+TIM_TypeDef host_tim[18];
+UART_HandleTypeDef huart1;
+
+typedef struct {               // 定时器模型状态
+  TIM_HandleTypeDef *htim;     // 句柄(主定时器用于查找DMA)
+  TIM_TypeDef *slave;          // 主定时器TRGO连接的从定时器
+  IRQn_Type slaveIrqn;         // 从定时器中断号
+  uint32_t outCh;              // 主定时器输出通道
+  uint32_t arr, psc, ccr[4];   // 影子寄存器
+  uint32_t sr;                 // 实际的SR标志
+  uint8_t started;             // 当前周期起始事件已处理
+  uint8_t pulseNow;            // 当前周期有输出脉冲
+  host_tim_stat_t stat;        // 统计
+} host_tim_t;
+
+static host_tim_t host_sim[18];
+static void (*host_irq_handler)(IRQn_Type irqn) = NULL;
+static uint64_t host_dma_hi = 0;
+static uint32_t host_assert_cnt = 0;
+static uint32_t host_tick = 0;
+
+static host_tim_t *Host_Of(TIM_TypeDef *tim) {
+  return &host_sim[tim - host_tim];
+}
+
+static uint32_t Host_Max_Cnt(TIM_TypeDef *tim) {
+  return IS_TIM_32B_COUNTER_INSTANCE(tim) ? 0xFFFFFFFF : 0xFFFF;
+}
+
+/****************** 内核/GPIO/串口 ******************/
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority,
+                          uint32_t SubPriority) {
+  (void)IRQn;
+  (void)PreemptPriority;
+  (void)SubPriority;
+}
+
+uint32_t HAL_GetTick(void) { return host_tick++; }
+
+void Error_Handler(void) { abort(); }
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState) {
+  if (PinState == GPIO_PIN_SET)
+    GPIOx->ODR |= GPIO_Pin;
+  else
+    GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  GPIOx->ODR ^= GPIO_Pin;
+}
+
+int printft(UART_HandleTypeDef *huart, char *fmt, ...) {
+  va_list ap;
+  int n;
+  (void)huart;
+  if (strstr(fmt, "[A]") != NULL) host_assert_cnt++;
+  va_start(ap, fmt);
+  n = vprintf(fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+void Assert_Failed_Handler(char *file, uint32_t line) {
+  fprintf(stderr, "assert failed at %s:%u\n", file, line);
+  abort();
+}
+
+uint32_t Host_Assert_Count(void) { return host_assert_cnt; }
+
+/****************** DMA ******************/
+
+void Host_Set_DMA_Base(const void *anyDmaBuffer) {
+  host_dma_hi = (uint64_t)(uintptr_t)anyDmaBuffer & ~0xFFFFFFFFULL;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress,
+                                   uint32_t DstAddress, uint32_t DataLength) {
+  DMA_Stream_TypeDef *s = hdma->Instance;
+  if (hdma->State != HAL_DMA_STATE_READY) return HAL_BUSY;
+  hdma->State = HAL_DMA_STATE_BUSY;
+  s->M0AR = SrcAddress;
+  s->PAR = DstAddress;
+  s->NDTR = DataLength;
+  s->len = DataLength;
+  s->pos = 0;
+  s->CR |= DMA_SxCR_EN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma) {
+  DMA_Stream_TypeDef *s = hdma->Instance;
+  s->CR &= ~DMA_SxCR_EN;
+  hdma->State = HAL_DMA_STATE_READY;
+  return HAL_OK;
+}
+
+/**
+ * @brief 更新事件DMA请求: 把下一个值写入ARR预装载寄存器
+ */
+static void Host_DMA_Request(host_tim_t *m, TIM_TypeDef *tim) {
+  DMA_HandleTypeDef *hdma = m->htim ? m->htim->hdma[TIM_DMA_ID_UPDATE] : NULL;
+  DMA_Stream_TypeDef *s;
+  const uint16_t *src;
+  if (hdma == NULL || !(tim->DIER & TIM_DIER_UDE)) return;
+  s = hdma->Instance;
+  if (!(s->CR & DMA_SxCR_EN)) return;
+  src = (const uint16_t *)(uintptr_t)(host_dma_hi | s->M0AR);
+  tim->ARR = src[s->pos++];
+  s->NDTR--;
+  if ((s->CR & DMA_SxCR_CIRC) && s->pos == s->len / 2 &&
+      hdma->XferHalfCpltCallback)
+    hdma->XferHalfCpltCallback(hdma);
+  if (s->pos < s->len) return;
+  if (s->CR & DMA_SxCR_CIRC) {
+    s->pos = 0;
+    s->NDTR = s->len;
+  } else {
+    s->CR &= ~DMA_SxCR_EN;
+    hdma->State = HAL_DMA_STATE_READY;
+  }
+  if (hdma->XferCpltCallback) hdma->XferCpltCallback(hdma);
+}
+
+/****************** TIM ******************/
+
+void Host_TIM_Link(TIM_HandleTypeDef *master, TIM_HandleTypeDef *slave,
+                   uint32_t outCh, IRQn_Type slaveIrqn) {
+  host_tim_t *m = Host_Of(master->Instance);
+  m->htim = master;
+  m->slave = slave->Instance;
+  m->slaveIrqn = slaveIrqn;
+  m->outCh = outCh >> 2;
+  Host_Of(slave->Instance)->htim = slave;
+  Host_TIM_Reset_Stat(master->Instance);
+}
+
+void Host_Set_IRQ_Handler(void (*handler)(IRQn_Type irqn)) {
+  host_irq_handler = handler;
+}
+
+host_tim_stat_t *Host_TIM_Stat(TIM_TypeDef *tim) {
+  return &Host_Of(tim)->stat;
+}
+
+void Host_TIM_Reset_Stat(TIM_TypeDef *tim) {
+  memset(&Host_Of(tim)->stat, 0, sizeof(host_tim_stat_t));
+  Host_Of(tim)->stat.arrMin = 0xFFFFFFFF;
+}
+
+/**
+ * @brief 更新事件: 预装载寄存器转入影子寄存器, 计数器归零
+ */
+static void Host_Update(TIM_TypeDef *tim, uint8_t ug) {
+  host_tim_t *m = Host_Of(tim);
+  tim->CNT = 0;
+  if (!ug && (tim->CR1 & TIM_CR1_UDIS)) {  // 禁止更新: 只回绕计数器
+    m->started = 0;
+    return;
+  }
+  m->arr = tim->ARR;
+  m->psc = tim->PSC;
+  m->ccr[0] = tim->CCR1;
+  m->ccr[1] = tim->CCR2;
+  m->ccr[2] = tim->CCR3;
+  m->ccr[3] = tim->CCR4;
+  m->started = 0;
+  Host_DMA_Request(m, tim);
+  if (!ug && (tim->CR1 & TIM_CR1_OPM)) tim->CR1 &= ~TIM_CR1_CEN;
+}
+
+void Host_TIM_Sync(TIM_TypeDef *tim) {
+  host_tim_t *m = Host_Of(tim);
+  if (tim->SR != m->sr) m->sr &= tim->SR;  // 写0清除, 写1无效
+  tim->SR = m->sr;
+  if (tim->EGR & TIM_EGR_UG) {
+    tim->EGR = 0;
+    Host_Update(tim, 1);
+  }
+}
+
+static void Host_Set_Flag(TIM_TypeDef *tim, uint32_t flag) {
+  host_tim_t *m = Host_Of(tim);
+  Host_TIM_Sync(tim);
+  m->sr |= flag;
+  tim->SR = m->sr;
+}
+
+/**
+ * @brief 开中断时分发从定时器中断
+ */
+static void Host_Deliver(void) {
+  uint8_t again = 1;
+  if (host_primask || host_irq_handler == NULL) return;
+  while (again) {
+    again = 0;
+    for (int i = 0; i < 18; i++) {
+      host_tim_t *m = &host_sim[i];
+      if (m->slave == NULL) continue;
+      Host_TIM_Sync(m->slave);
+      if (m->slave->SR & m->slave->DIER & (TIM_SR_UIF | TIM_SR_CC2IF)) {
+        host_irq_handler(m->slaveIrqn);
+        Host_TIM_Sync(m->slave);
+        again = 1;
+      }
+    }
+  }
+}
+
+/**
+ * @brief 从定时器收到一个触发
+ */
+static void Host_Slave_Count(TIM_TypeDef *tim) {
+  uint32_t max = Host_Max_Cnt(tim);
+  if (!(tim->CR1 & TIM_CR1_CEN)) return;
+  if (tim->ARR == 0) return;  // ARR为0时计数器不计数
+  if (tim->CNT == tim->ARR) {
+    tim->CNT = 0;
+    Host_Set_Flag(tim, TIM_SR_UIF | TIM_SR_CC1IF);
+  } else {
+    tim->CNT = tim->CNT == max ? 0 : tim->CNT + 1;
+  }
+  if (tim->CNT == tim->CCR2 && tim->CNT != 0) Host_Set_Flag(tim, TIM_SR_CC2IF);
+}
+
+static void Host_Trgo(host_tim_t *m) {
+  m->stat.trgo++;
+  if (!m->pulseNow) m->stat.phantom++;
+  if (m->slave) Host_Slave_Count(m->slave);
+}
+
+/**
+ * @brief 周期起始(计数器为0): 输出通道上升沿, CCR1为0时产生TRGO
+ */
+static void Host_Period_Start(host_tim_t *m) {
+  uint32_t out = m->ccr[m->outCh];
+  m->started = 1;
+  m->pulseNow = 0;
+  if (out > m->arr) {
+    m->stat.stall++;
+  } else if (out > 0) {
+    m->pulseNow = 1;
+    m->stat.pulses++;
+    if (out > m->stat.ccrMax) m->stat.ccrMax = out;
+    if (m->arr < m->stat.arrMin) m->stat.arrMin = m->arr;
+  }
+  if (m->ccr[0] == 0) Host_Trgo(m);
+}
+
+/**
+ * @brief 主定时器到下一个事件(比较匹配或更新)还需的计数值
+ */
+static uint32_t Host_Next_Event(TIM_TypeDef *tim) {
+  host_tim_t *m = Host_Of(tim);
+  uint32_t c1 = m->ccr[0];
+  if (!(tim->CR1 & TIM_CR1_ARPE)) m->arr = tim->ARR;
+  if (tim->CNT > m->arr) {  // 越过ARR, 计到最大值回绕
+    m->stat.overrun++;
+    m->arr = tim->CNT;
+  }
+  if (c1 > tim->CNT && c1 <= m->arr) return c1 - tim->CNT;
+  return m->arr - tim->CNT + 1;
+}
+
+/**
+ * @brief 主定时器前进n个计数
+ */
+static void Host_Advance(TIM_TypeDef *tim, uint32_t n) {
+  host_tim_t *m = Host_Of(tim);
+  uint32_t step;
+  Host_TIM_Sync(tim);
+  while (n > 0 && (tim->CR1 & TIM_CR1_CEN)) {
+    if (!m->started && tim->CNT == 0) Host_Period_Start(m);
+    step = Host_Next_Event(tim);
+    if (step > n) step = n;
+    n -= step;
+    tim->CNT += step;
+    m->stat.clk += (uint64_t)step * (m->psc + 1);
+    if (tim->CNT == m->ccr[0] && m->ccr[0] > 0) Host_Trgo(m);
+    if (tim->CNT > m->arr) {
+      Host_Update(tim, 0);
+      if (tim->CR1 & TIM_CR1_CEN) Host_Period_Start(m);
+    }
+  }
+}
+
+uint32_t Host_TIM_Get_Counter(TIM_TypeDef *tim) {
+  host_tim_t *m = Host_Of(tim);
+  Host_TIM_Sync(tim);
+  if (m->slave != NULL) Host_Advance(tim, 1);  // 读取期间主定时器继续计数
+  return tim->CNT;
+}
+
+/**
+ * @brief 按时间顺序运行所有主定时器, 直到全部停止或超时
+ * @param  maxClk           最长运行的定时器时钟数(分频前)
+ * @retval uint8_t          1: 全部停止, 0: 超时
+ */
+uint8_t Host_Run(uint64_t maxClk) {
+  uint64_t t, tMin, start[18], dist[18];
+  int i, next;
+  for (i = 0; i < 18; i++) start[i] = host_sim[i].stat.clk;
+  for (;;) {
+    Host_Deliver();
+    next = -1;
+    tMin = 0;
+    for (i = 0; i < 18; i++) {
+      host_tim_t *m = &host_sim[i];
+      TIM_TypeDef *tim = &host_tim[i];
+      if (m->slave == NULL) continue;
+      Host_TIM_Sync(tim);
+      if (!(tim->CR1 & TIM_CR1_CEN)) continue;
+      if (!m->started && tim->CNT == 0) Host_Period_Start(m);
+      dist[i] = Host_Next_Event(tim);
+      t = m->stat.clk - start[i] + dist[i] * (m->psc + 1);
+      if (next < 0 || t < tMin) {
+        tMin = t;
+        next = i;
+      }
+    }
+    if (next < 0) return 1;
+    if (tMin > maxClk) break;
+    Host_Advance(&host_tim[next], dist[next]);
+  }
+  // 超时: 各定时器前进到maxClk时刻, 途中没有事件
+  for (i = 0; i < 18; i++) {
+    host_tim_t *m = &host_sim[i];
+    if (m->slave == NULL || !(host_tim[i].CR1 & TIM_CR1_CEN)) continue;
+    t = m->stat.clk - start[i];
+    if (t < maxClk) Host_Advance(&host_tim[i], (maxClk - t) / (m->psc + 1));
+  }
+  return 0;
+}
+
+void TIM_CCxChannelCmd(TIM_TypeDef *TIMx, uint32_t Channel,
+                       uint32_t ChannelState) {
+  uint32_t bit = 1UL << Channel;
+  TIMx->CCER = ChannelState ? TIMx->CCER | bit : TIMx->CCER & ~bit;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+  Host_TIM_Sync(htim->Instance);
+  htim->Instance->DIER |= TIM_DIER_UIE;
+  htim->Instance->CR1 |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim) {
+  Host_TIM_Sync(htim->Instance);
+  htim->Instance->DIER &= ~TIM_DIER_UIE;
+  htim->Instance->CR1 &= ~TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  Host_TIM_Sync(htim->Instance);
+  TIM_CCxChannelCmd(htim->Instance, Channel, TIM_CCx_ENABLE);
+  htim->Instance->CR1 |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  Host_TIM_Sync(htim->Instance);
+  TIM_CCxChannelCmd(htim->Instance, Channel, TIM_CCx_DISABLE);
+  htim->Instance->CR1 &= ~TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start_IT(TIM_HandleTypeDef *htim,
+                                       uint32_t Channel) {
+  return HAL_TIM_PWM_Start(htim, Channel);
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_IT(TIM_HandleTypeDef *htim,
+                                      uint32_t Channel) {
+  return HAL_TIM_PWM_Stop(htim, Channel);
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  return HAL_TIM_PWM_Start(htim, Channel);
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef *htim,
+                                        uint32_t Channel) {
+  (void)Channel;
+  htim->Instance->CR1 |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+uint32_t HAL_TIM_ReadCapturedValue(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  return __HAL_TIM_GET_COMPARE(htim, Channel);
+}
@@ -0,0 +1,35 @@
+/**
+ * @file host_hal.h
+ * @brief 主机测试用的定时器/DMA行为模型
+ * 主定时器: PWM1模式, ARR/PSC/CCR预装载, TRGO=OC1(比较匹配时输出触发),
+ * 更新事件DMA写ARR; 从定时器: 外部时钟模式, 每个TRGO计数一次,
+ * 计满溢出时置UIF和CC1IF(CCR1=0), 计到CCR2时置CC2IF
+ *
+ * THINK DIFFERENTLY
+ */
+
+#ifndef __HOST_HAL_H
+#define __HOST_HAL_H
+#include "main.h"
+
+typedef struct {        // 主定时器模型统计
+  uint64_t clk;         // 已运行的定时器时钟数(分频前)
+  uint32_t pulses;      // 输出通道的有效脉冲数
+  uint32_t trgo;        // TRGO次数(从定时器计数的来源)
+  uint32_t phantom;     // 没有输出脉冲的TRGO次数
+  uint32_t stall;       // 输出通道CCR大于ARR(输出一直为高)的周期数
+  uint32_t overrun;     // 计数值越过ARR(未预装载时改小ARR)的次数
+  uint32_t ccrMax;      // 输出通道CCR最大值
+  uint32_t arrMin;      // 有效周期中ARR最小值
+} host_tim_stat_t;
+
+void Host_TIM_Link(TIM_HandleTypeDef *master, TIM_HandleTypeDef *slave,
+                   uint32_t outCh, IRQn_Type slaveIrqn);
+void Host_Set_IRQ_Handler(void (*handler)(IRQn_Type irqn));
+void Host_Set_DMA_Base(const void *anyDmaBuffer);
+host_tim_stat_t *Host_TIM_Stat(TIM_TypeDef *tim);
+void Host_TIM_Reset_Stat(TIM_TypeDef *tim);
+uint8_t Host_Run(uint64_t maxClk);
+uint32_t Host_Assert_Count(void);
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ * @file host_step.c
+ * @brief 主机测试用的三轴步进电机装配, 见host_step.h
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include "host_step.h"
+
+TIM_HandleTypeDef htim1, htim2, htim3, htim4, htim5, htim8;
+step_ctrl_t step_1, step_2, step_3;
+
+static DMA_Stream_TypeDef host_stream[3];
+static DMA_HandleTypeDef host_hdma[3];
+
+static void Host_Master_Init(TIM_HandleTypeDef *htim, TIM_TypeDef *tim,
+                             uint8_t i) {
+  htim->Instance = tim;
+  host_hdma[i].Instance = &host_stream[i];
+  host_hdma[i].State = HAL_DMA_STATE_READY;
+  htim->hdma[TIM_DMA_ID_UPDATE] = &host_hdma[i];
+}
+
+/**
+ * @brief 初始化定时器句柄和三个电机, 只能调用一次
+ */
+void Host_Step_Init(void) {
+  Host_Master_Init(&htim1, TIM1, 0);
+  Host_Master_Init(&htim4, TIM4, 1);
+  Host_Master_Init(&htim8, TIM8, 2);
+  htim2.Instance = TIM2;
+  htim3.Instance = TIM3;
+  htim5.Instance = TIM5;
+  Step_Init(&step_1, &htim1, &htim2, TIM_CHANNEL_1, GPIOA, GPIO_PIN_0, 0);
+  Step_Init(&step_2, &htim4, &htim3, TIM_CHANNEL_4, GPIOA, GPIO_PIN_1, 0);
+  Step_Init(&step_3, &htim8, &htim5, TIM_CHANNEL_1, GPIOA, GPIO_PIN_2, 0);
+  Host_TIM_Link(&htim1, &htim2, TIM_CHANNEL_1, TIM2_IRQn);
+  Host_TIM_Link(&htim4, &htim3, TIM_CHANNEL_4, TIM3_IRQn);
+  Host_TIM_Link(&htim8, &htim5, TIM_CHANNEL_1, TIM5_IRQn);
+  Host_Set_IRQ_Handler(Step_IRQ_Handler);
+  Host_Set_DMA_Base(step_1.rampAccTable);
+}
+
+/**
+ * @brief 运行到所有电机停止, 每隔一段时间执行一次规划任务
+ * @param  maxClk           最长运行的定时器时钟数(分频前)
+ * @retval uint8_t          1: 全部停止, 0: 超时
+ */
+uint8_t Host_Step_Run(uint64_t maxClk) {
+  uint64_t t;
+  for (t = 0; t < maxClk; t += STEP_TIM_BASE_CLK / 1000) {
+    Step_Planner_Task();
+    if (Host_Run(STEP_TIM_BASE_CLK / 1000)) {
+      Step_Planner_Task();  // 停止后由规划任务启动的运动
+      if (Host_Run(0)) return 1;
+    }
+  }
+  return 0;
+}
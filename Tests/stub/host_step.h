@@ -0,0 +1,21 @@
+/**
+ * @file host_step.h
+ * @brief 主机测试用的三轴步进电机装配, 与main.c中的定时器连接一致
+ * step_1: TIM1(CH1)->TIM2, step_2: TIM4(CH4)->TIM3(16位),
+ * step_3: TIM8(CH1)->TIM5
+ *
+ * THINK DIFFERENTLY
+ */
+
+#ifndef __HOST_STEP_H
+#define __HOST_STEP_H
+#include "host_hal.h"
+#include "step.h"
+
+extern TIM_HandleTypeDef htim1, htim2, htim3, htim4, htim5, htim8;
+extern step_ctrl_t step_1, step_2, step_3;
+
+void Host_Step_Init(void);
+uint8_t Host_Step_Run(uint64_t maxClk);
+
+#endif
@@ -0,0 +1,297 @@
+/**
+ * @file main.h
+ * @brief 主机测试用的HAL替身, 只提供Modules中用到的类型, 寄存器和函数,
+ * 外设寄存器是普通内存, 由host_hal.c模拟硬件行为
+ *
+ * THINK DIFFERENTLY
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define __IO volatile
+#define __weak __attribute__((weak))
+#define UNUSED(X) (void)X
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+typedef enum {
+  HAL_OK = 0x00,
+  HAL_ERROR = 0x01,
+  HAL_BUSY = 0x02,
+  HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum {
+  PendSV_IRQn = -2,
+  SysTick_IRQn = -1,
+  TIM1_UP_IRQn = 25,
+  TIM2_IRQn = 28,
+  TIM3_IRQn = 29,
+  TIM4_IRQn = 30,
+  TIM5_IRQn = 50,
+  TIM7_IRQn = 55,
+  TIM15_IRQn = 116,
+  TIM16_IRQn = 117,
+  TIM17_IRQn = 118,
+} IRQn_Type;
+
+/****************** 内核 ******************/
+
+#define __NVIC_PRIO_BITS 4
+
+typedef struct {
+  __IO uint32_t CTRL;
+  __IO uint32_t CYCCNT;
+  __IO uint32_t LAR;
+} DWT_Type;
+
+typedef struct {
+  __IO uint32_t ICSR;
+} SCB_Type;
+
+typedef struct {
+  __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type host_dwt;
+extern SCB_Type host_scb;
+extern CoreDebug_Type host_core_debug;
+extern uint32_t host_primask;
+extern uint32_t host_basepri;
+extern uint32_t SystemCoreClock;
+
+#define DWT (&host_dwt)
+#define SCB (&host_scb)
+#define CoreDebug (&host_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define SCB_ICSR_PENDSVSET_Msk (1UL << 28)
+
+static inline uint32_t __get_PRIMASK(void) { return host_primask; }
+static inline void __set_PRIMASK(uint32_t v) { host_primask = v; }
+static inline void __disable_irq(void) { host_primask = 1; }
+static inline void __enable_irq(void) { host_primask = 0; }
+static inline uint32_t __get_BASEPRI(void) { return host_basepri; }
+static inline void __set_BASEPRI(uint32_t v) { host_basepri = v; }
+static inline void __set_BASEPRI_MAX(uint32_t v) {
+  if (host_basepri == 0 || v < host_basepri) host_basepri = v;
+}
+static inline uint32_t __CLZ(uint32_t v) {
+  return v ? (uint32_t)__builtin_clz(v) : 32;
+}
+#define __DSB() ((void)0)
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority,
+                          uint32_t SubPriority);
+uint32_t HAL_GetTick(void);
+void Error_Handler(void);
+
+/****************** GPIO ******************/
+
+typedef struct {
+  __IO uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+extern GPIO_TypeDef host_gpio[4];
+#define GPIOA (&host_gpio[0])
+#define GPIOC (&host_gpio[2])
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define LED_R_Pin GPIO_PIN_1
+#define LED_R_GPIO_Port GPIOC
+#define LED_G_Pin GPIO_PIN_2
+#define LED_G_GPIO_Port GPIOC
+#define LED_B_Pin GPIO_PIN_3
+#define LED_B_GPIO_Port GPIOC
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+/****************** DMA ******************/
+
+typedef struct {
+  __IO uint32_t CR;
+  __IO uint32_t NDTR;
+  __IO uint32_t PAR;
+  __IO uint32_t M0AR;
+  uint32_t len;  // 模型: 传输长度
+  uint32_t pos;  // 模型: 已传输个数
+} DMA_Stream_TypeDef;
+
+typedef enum {
+  HAL_DMA_STATE_RESET = 0x00,
+  HAL_DMA_STATE_READY = 0x01,
+  HAL_DMA_STATE_BUSY = 0x02,
+} HAL_DMA_StateTypeDef;
+
+typedef struct {
+  uint32_t Mode;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+  void *Instance;
+  DMA_InitTypeDef Init;
+  __IO HAL_DMA_StateTypeDef State;
+  void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+  void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+} DMA_HandleTypeDef;
+
+#define DMA_NORMAL 0x00000000U
+#define DMA_CIRCULAR 0x00000100U
+#define DMA_SxCR_CIRC (1UL << 8)
+#define DMA_SxCR_EN (1UL)
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress,
+                                   uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+
+/****************** TIM ******************/
+
+typedef struct {
+  __IO uint32_t CR1;
+  __IO uint32_t CR2;
+  __IO uint32_t SMCR;
+  __IO uint32_t DIER;
+  __IO uint32_t SR;
+  __IO uint32_t EGR;
+  __IO uint32_t CCMR1;
+  __IO uint32_t CCMR2;
+  __IO uint32_t CCER;
+  __IO uint32_t CNT;
+  __IO uint32_t PSC;
+  __IO uint32_t ARR;
+  __IO uint32_t RCR;
+  __IO uint32_t CCR1;
+  __IO uint32_t CCR2;
+  __IO uint32_t CCR3;
+  __IO uint32_t CCR4;
+  __IO uint32_t BDTR;
+} TIM_TypeDef;
+
+typedef enum {
+  HAL_TIM_ACTIVE_CHANNEL_1 = 0x01,
+  HAL_TIM_ACTIVE_CHANNEL_2 = 0x02,
+  HAL_TIM_ACTIVE_CHANNEL_3 = 0x04,
+  HAL_TIM_ACTIVE_CHANNEL_4 = 0x08,
+  HAL_TIM_ACTIVE_CHANNEL_CLEARED = 0x00
+} HAL_TIM_ActiveChannel;
+
+typedef enum {
+  HAL_TIM_CHANNEL_STATE_RESET = 0x00,
+  HAL_TIM_CHANNEL_STATE_READY = 0x01,
+  HAL_TIM_CHANNEL_STATE_BUSY = 0x02,
+} HAL_TIM_ChannelStateTypeDef;
+
+typedef struct {
+  TIM_TypeDef *Instance;
+  HAL_TIM_ActiveChannel Channel;
+  DMA_HandleTypeDef *hdma[7];
+  HAL_TIM_ChannelStateTypeDef ChannelState[6];
+} TIM_HandleTypeDef;
+
+extern TIM_TypeDef host_tim[18];
+#define TIM1 (&host_tim[1])
+#define TIM2 (&host_tim[2])
+#define TIM3 (&host_tim[3])
+#define TIM4 (&host_tim[4])
+#define TIM5 (&host_tim[5])
+#define TIM7 (&host_tim[7])
+#define TIM8 (&host_tim[8])
+#define TIM15 (&host_tim[15])
+#define TIM16 (&host_tim[16])
+#define TIM17 (&host_tim[17])
+
+#define IS_TIM_32B_COUNTER_INSTANCE(x) ((x) == TIM2 || (x) == TIM5)
+#define IS_TIM_BREAK_INSTANCE(x) ((x) == TIM1 || (x) == TIM8)
+
+#define TIM_CR1_CEN (1UL << 0)
+#define TIM_CR1_UDIS (1UL << 1)
+#define TIM_CR1_OPM (1UL << 3)
+#define TIM_CR1_ARPE (1UL << 7)
+#define TIM_SR_UIF (1UL << 0)
+#define TIM_SR_CC1IF (1UL << 1)
+#define TIM_SR_CC2IF (1UL << 2)
+#define TIM_DIER_UIE (1UL << 0)
+#define TIM_DIER_CC1IE (1UL << 1)
+#define TIM_DIER_CC2IE (1UL << 2)
+#define TIM_DIER_UDE (1UL << 8)
+#define TIM_EGR_UG (1UL << 0)
+#define TIM_BDTR_MOE (1UL << 15)
+#define TIM_CCMR1_OC1M (0x7UL << 4 | 1UL << 16)
+
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_CHANNEL_2 0x00000004U
+#define TIM_CHANNEL_3 0x00000008U
+#define TIM_CHANNEL_4 0x0000000CU
+#define TIM_CHANNEL_ALL 0x0000003CU
+#define TIM_FLAG_UPDATE TIM_SR_UIF
+#define TIM_FLAG_CC1 TIM_SR_CC1IF
+#define TIM_FLAG_CC2 TIM_SR_CC2IF
+#define TIM_IT_UPDATE TIM_DIER_UIE
+#define TIM_IT_CC1 TIM_DIER_CC1IE
+#define TIM_IT_CC2 TIM_DIER_CC2IE
+#define TIM_DMA_UPDATE TIM_DIER_UDE
+#define TIM_DMA_ID_UPDATE 0
+#define TIM_CCx_ENABLE 1U
+#define TIM_CCx_DISABLE 0U
+#define TIM_OCMODE_PWM1 (0x6UL << 4)
+#define TIM_OCMODE_FORCED_INACTIVE (0x4UL << 4)
+
+// 寄存器访问先处理软件更新事件和SR写0清除, 见host_hal.c
+void Host_TIM_Sync(TIM_TypeDef *tim);
+uint32_t Host_TIM_Get_Counter(TIM_TypeDef *tim);
+#define __HOST_TIM_WRITE(h, reg, v) \
+  (Host_TIM_Sync((h)->Instance), (h)->Instance->reg = (v))
+#define __HAL_TIM_SET_COUNTER(h, v) __HOST_TIM_WRITE(h, CNT, v)
+#define __HAL_TIM_GET_COUNTER(h) Host_TIM_Get_Counter((h)->Instance)
+#define __HAL_TIM_SET_AUTORELOAD(h, v) __HOST_TIM_WRITE(h, ARR, v)
+#define __HAL_TIM_GET_AUTORELOAD(h) ((h)->Instance->ARR)
+#define __HAL_TIM_SET_PRESCALER(h, v) __HOST_TIM_WRITE(h, PSC, v)
+#define __HAL_TIM_SET_COMPARE(h, ch, v) \
+  (Host_TIM_Sync((h)->Instance), *(&(h)->Instance->CCR1 + ((ch) >> 2)) = (v))
+#define __HAL_TIM_GET_COMPARE(h, ch) (*(&(h)->Instance->CCR1 + ((ch) >> 2)))
+#define __HAL_TIM_GET_FLAG(h, f) \
+  (Host_TIM_Sync((h)->Instance), ((h)->Instance->SR & (f)) == (f))
+#define __HAL_TIM_CLEAR_FLAG(h, f)                        \
+  (Host_TIM_Sync((h)->Instance), (h)->Instance->SR = (uint32_t)~(f), \
+   Host_TIM_Sync((h)->Instance))
+#define __HAL_TIM_ENABLE_IT(h, i) ((h)->Instance->DIER |= (i))
+#define __HAL_TIM_DISABLE_IT(h, i) ((h)->Instance->DIER &= ~(i))
+#define __HAL_TIM_ENABLE_DMA(h, d) ((h)->Instance->DIER |= (d))
+#define __HAL_TIM_DISABLE_DMA(h, d) ((h)->Instance->DIER &= ~(d))
+#define __HAL_TIM_MOE_ENABLE(h) ((h)->Instance->BDTR |= TIM_BDTR_MOE)
+#define TIM_CHANNEL_STATE_SET(h, ch, s) \
+  ((h)->ChannelState[(ch) >> 2] = (s))
+
+void TIM_CCxChannelCmd(TIM_TypeDef *TIMx, uint32_t Channel,
+                       uint32_t ChannelState);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Start_IT(TIM_HandleTypeDef *htim,
+                                       uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_IT(TIM_HandleTypeDef *htim,
+                                      uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef *htim,
+                                        uint32_t Channel);
+uint32_t HAL_TIM_ReadCapturedValue(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+/****************** UART ******************/
+
+typedef struct {
+  void *Instance;
+} UART_HandleTypeDef;
+
+#endif /* __MAIN_H */
@@ -0,0 +1,8 @@
+/**
+ * @file tim.h
+ * @brief 主机测试用, 定时器句柄由测试自行定义
+ */
+#ifndef __TIM_H__
+#define __TIM_H__
+#include "main.h"
+#endif
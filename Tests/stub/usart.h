@@ -0,0 +1,12 @@
+/**
+ * @file usart.h
+ * @brief 主机测试用, 调试串口输出到标准输出
+ */
+#ifndef __USART_H__
+#define __USART_H__
+#include "main.h"
+
+extern UART_HandleTypeDef huart1;
+
+int printft(UART_HandleTypeDef *huart, char *fmt, ...);
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file test_motor_tune.c
+ * @brief 继电反馈自整定: 速度环驱动一阶惯性加纯滞后(FOPDT)对象,
+ * 由Motor_Autotune_Run完成振荡测量和Motor_Autotune_Finish计算参数,
+ * 检查振荡周期/幅值与继电振荡的精确解一致, 临界增益与描述函数法在该振荡
+ * 上的结果一致; 整定后的PI闭环稳定且无静差;
+ * 振荡幅值不超过滞环时整定失败, 保留原参数
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "host_hal.h"
+#include "motor.h"
+
+#define DT 1e-4         // 控制周期, s
+#define PLANT_K 10.0    // 对象增益, rpm/%
+#define PLANT_T 0.05    // 对象时间常数, s
+#define PLANT_L 0.01    // 对象纯滞后, s
+#define DELAY_N 100     // 纯滞后对应的控制周期数
+#define WORK_SPD 300.0  // 工作点速度, rpm
+#define RELAY_AMP 10.0  // 继电幅值, %
+#define RELAY_HYST 1.0  // 继电滞环, rpm
+
+TIM_HandleTypeDef htim15, htim16;
+static motor_t motor;
+static double plant_y, plant_buf[DELAY_N];
+static uint32_t plant_idx;
+
+/**
+ * @brief 对象前进一个控制周期
+ * @note 驱动器在启动占空比以下电机不转, Motor_Set_Output的映射正好抵消,
+ * 对象输入等效为速度环输出
+ */
+static void Plant_Step(void) {
+  double duty = motor.pwmDuty, u = 0;
+  if (duty > MOTOR_LAUNCH_PWM_DUTY)
+    u = (duty - MOTOR_LAUNCH_PWM_DUTY) * 100 / (100 - MOTOR_LAUNCH_PWM_DUTY);
+  else if (duty < -MOTOR_LAUNCH_PWM_DUTY)
+    u = (duty + MOTOR_LAUNCH_PWM_DUTY) * 100 / (100 - MOTOR_LAUNCH_PWM_DUTY);
+  plant_y += (PLANT_K * plant_buf[plant_idx] - plant_y) * DT / PLANT_T;
+  plant_buf[plant_idx] = u;
+  plant_idx = (plant_idx + 1) % DELAY_N;
+  motor.speed = plant_y;
+}
+
+/**
+ * @brief 按控制环中断的顺序运行, 自整定期间代替速度环
+ * @param  time             运行时间, s
+ * @param  spdMax           最后0.5s内速度偏离设定值的最大值
+ */
+static void Run(double time, double *spdMax) {
+  double err;
+  *spdMax = 0;
+  for (double t = 0; t < time; t += DT) {
+    if (motor.tune.state == MOTOR_TUNE_RUN)
+      Motor_Autotune_Run(&motor, DT);
+    else
+      Motor_Spd_PID_Run(&motor, DT);
+    Plant_Step();
+    err = fabs(motor.speed - motor.spdSet);
+    if (t > time - 0.5 && err > *spdMax) *spdMax = err;
+  }
+}
+
+/**
+ * @brief 不经过速度死区运行PI, 检查积分通路
+ * @param  time             运行时间, s
+ * @param  spdMax           最后0.5s内速度偏离设定值的最大值
+ * @param  peak             速度最大值
+ */
+static void Run_PI(double time, double *spdMax, double *peak) {
+  double err;
+  *spdMax = 0;
+  *peak = motor.speed;
+  for (double t = 0; t < time; t += DT) {
+    Motor_Set_Output(&motor, PID_F32_Update(&motor.spdPID, motor.spdSet,
+                                            motor.speed, DT));
+    Plant_Step();
+    err = fabs(motor.speed - motor.spdSet);
+    if (t > time - 0.5 && err > *spdMax) *spdMax = err;
+    if (motor.speed > *peak) *peak = motor.speed;
+  }
+}
+
+/**
+ * @brief 带滞环的对称继电器作用于FOPDT对象的精确极限环(Astrom-Hagglund):
+ * 切换后经过纯滞后L输出达到峰值 a = Kd(1-e^(-L/T)) + e*e^(-L/T),
+ * 半周期 h = T*ln((2Kd*e^(L/T) - Kd + e) / (Kd - e))
+ * @param  a                输出振荡幅值
+ * @param  p                振荡周期
+ */
+static void Relay_Cycle(double *a, double *p) {
+  double kd = PLANT_K * RELAY_AMP, r = exp(-PLANT_L / PLANT_T);
+  *a = kd * (1 - r) + RELAY_HYST * r;
+  *p = 2 * PLANT_T * log((2 * kd / r - kd + RELAY_HYST) / (kd - RELAY_HYST));
+}
+
+/**
+ * @brief 解析求临界频率: 相位 -atan(wT) - wL = -pi
+ */
+static void Ultimate(double *ku, double *pu) {
+  double lo = 0, hi = 3.14159265 / PLANT_L, w = 0;
+  for (int i = 0; i < 100; i++) {
+    w = (lo + hi) / 2;
+    if (atan(w * PLANT_T) + w * PLANT_L < 3.14159265)
+      lo = w;
+    else
+      hi = w;
+  }
+  *ku = sqrt(1 + w * PLANT_T * w * PLANT_T) / PLANT_K;
+  *pu = 2 * 3.14159265 / w;
+}
+
+static void Test_Tune(void) {
+  double ku, pu, a, p, kuDf, dev, peak;
+  Ultimate(&ku, &pu);
+  Relay_Cycle(&a, &p);
+  kuDf = 4 * RELAY_AMP /
+         (3.14159265 * sqrt(a * a - RELAY_HYST * RELAY_HYST));
+  Motor_Set_Gains(&motor, MOTOR_TUNE_SPD, 0.2, 4, 0);  // 保守的初始参数
+  Motor_Set_Speed(&motor, WORK_SPD);
+  Run(3, &dev);
+  assert(dev < SPD_DEAD_BAND + 1);  // 原参数下已稳定在工作点
+  Motor_Autotune_Start(&motor, MOTOR_TUNE_SPD, RELAY_AMP, RELAY_HYST, 4);
+  Run(MOTOR_TUNE_TIMEOUT, &dev);
+  assert(motor.tune.state == MOTOR_TUNE_DONE);
+  printf("ku %.4f (relay %.4f, exact %.4f), pu %.4f s (relay %.4f s, exact "
+         "%.4f s)\n",
+         motor.tune.ku, kuDf, ku, motor.tune.pu, p, pu);
+  // 与精确极限环上的结果只差控制周期的离散化(DT = L/100)
+  assert(fabs(motor.tune.pu - p) < 0.02 * p);
+  assert(fabs(motor.tune.ku - kuDf) < 0.02 * kuDf);
+  // 描述函数法忽略了高次谐波, 滞后小的对象振荡波形偏离正弦, 临界增益偏小
+  assert(kuDf < ku && fabs(p - pu) < 0.05 * pu);
+  assert(fabs(motor.spdPID.kp - 0.45 * motor.tune.ku) < 1e-6);
+  // 新参数下阶跃响应, PI对FOPDT对象无静差
+  motor.spdSet = WORK_SPD + 100;
+  Run_PI(2.5, &dev, &peak);
+  printf("step 100 rpm: overshoot %.1f%%, final error %.4f rpm\n",
+         peak - WORK_SPD - 100, dev);
+  assert(peak - WORK_SPD < 100 * 1.6);
+  assert(dev < 0.01);
+}
+
+static void Test_Fail(void) {
+  double kp = motor.spdPID.kp, dev;
+  Motor_Autotune_Start(&motor, MOTOR_TUNE_SPD, 1, 100, 4);  // 滞环过大
+  Run(MOTOR_TUNE_TIMEOUT + 1, &dev);
+  assert(motor.tune.state == MOTOR_TUNE_FAIL);
+  assert(motor.spdPID.kp == kp);
+}
+
+int main(void) {
+  htim15.Instance = TIM15;
+  htim16.Instance = TIM16;
+  Motor_Setup(&motor, &htim15, &htim16, TIM_CHANNEL_1, TIM_CHANNEL_2);
+  Test_Tune();
+  Test_Fail();
+  assert(Host_Assert_Count() == 0);
+  printf("test_motor_tune passed\n");
+  return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file test_ramp.c
+ * @brief 梯形加速表与理想速度曲线对比
+ * 理想曲线: 第n个脉冲的时刻 t(n) = sqrt(2n/a), 瞬时速度 v = a*t
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "step_profile.h"
+
+#define TABLE_SIZE 1024
+#define TIM_CLK 240000000.0
+#define START_FREQ 100.0
+#define MAX_FREQ 20000.0
+
+static uint16_t table[TABLE_SIZE];
+
+/**
+ * @brief 逐项对比加速表与理想曲线
+ * @param  accel            加速度, pulse/s^2
+ */
+static void Check_Ramp(double accel) {
+  uint32_t psc = TIM_CLK / START_FREQ / 0x10000 + 1;
+  double tickFreq = TIM_CLK / psc;
+  uint32_t minTicks = tickFreq / MAX_FREQ;
+  uint16_t len = Ramp_Build(table, TABLE_SIZE, accel, tickFreq, minTicks);
+  uint64_t sum = 0;
+  uint16_t i;
+  double t, v, vIdeal, err, errMax = 0;
+  assert(len > 0);
+  for (i = 0; i < len; i++) {
+    sum += (uint64_t)table[i] + 1;
+    t = sqrt(2.0 * (i + 1) / accel);
+    assert(table[i] + 1 >= minTicks);
+    if (table[i] == 0xFFFF) continue;  // 低于起步频率, 被限制
+    // 累计时刻误差不超过半个计数, 不随脉冲数累积
+    assert(fabs(sum - t * tickFreq) <= 0.5 + 1e-6);
+    // 周期对应的速度与该周期中点时刻的理想速度一致
+    v = tickFreq / (table[i] + 1);
+    vIdeal = accel * (t + sqrt(2.0 * i / accel)) / 2;
+    err = fabs(v - vIdeal) / vIdeal;
+    if (i >= 8 && err > errMax) errMax = err;
+  }
+  assert(errMax < 0.01);
+  // 表长不足1024时, 下一个周期已超过最高频率
+  if (len < TABLE_SIZE) assert(Ramp_Ticks(accel, tickFreq, len) < minTicks);
+  printf("accel %8.0f: len %4d, end %6.0f Hz, vel err %.4f%%\n", accel, len,
+         tickFreq / (table[len - 1] + 1), errMax * 100);
+}
+
+int main(void) {
+  Check_Ramp(20000);
+  Check_Ramp(100000);
+  Check_Ramp(400000);
+  Check_Ramp(2000000);
+  printf("test_ramp passed\n");
+  return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file test_sch_drift.c
+ * @brief 调度器周期不漂移: SysTick带随机中断延迟, 偶尔被长时间锁定,
+ * 实时任务在PendSV中运行; 100s(DWT计数多次溢出)后运行次数等于已到期的
+ * 周期数, 带dt任务收到的dt之和等于实际经过时间
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scheduler.h"
+
+#define SIM_MS 100000              // 仿真时长, ms
+#define CYC_MS (480000000 / 1000)  // 每ms的DWT周期数
+#define JITTER_CYC 20000           // SysTick中断延迟上限, 周期
+#define STALL_MS 3                 // 锁定时长, 少于SCH_MAX_CATCHUP个周期
+#define EXEC_CYC 3000              // 任务执行时间, 周期
+
+static uint64_t sim_cyc;  // 仿真时刻, DWT周期
+static uint32_t cnt_fast, cnt_slow;
+static uint64_t first_slow, last_fast, last_slow;
+static double sum_dt;
+
+static void Exec(void) {
+  sim_cyc += EXEC_CYC;
+  DWT->CYCCNT = (uint32_t)sim_cyc;
+}
+
+static void Task_Fast(void) {  // 1kHz, 与SysTick同频
+  cnt_fast++;
+  last_fast = sim_cyc;
+  Exec();
+}
+
+static void Task_Slow(float dt) {  // 300Hz, 周期不是SysTick的整数倍
+  if (cnt_slow++ == 0)
+    first_slow = sim_cyc;
+  else
+    sum_dt += dt;
+  last_slow = sim_cyc;
+  Exec();
+}
+
+int main(void) {
+  scheduler_task_t info;
+  uint8_t fast, slow;
+  uint64_t tick, slots;
+  srand(1);
+  fast = Add_SchTask(Task_Fast, 1000, 1);
+  slow = Add_SchTask_Dt(Task_Slow, 300, 1);
+  _Set_SchTask_Prio_Id(fast, SCH_PRIO_RT);
+  _Set_SchTask_Prio_Id(slow, SCH_PRIO_RT);
+  for (tick = 1; tick <= SIM_MS; tick++) {
+    if (tick % 1000 < STALL_MS) continue;  // 被锁定, SysTick和PendSV挂起
+    if (sim_cyc < tick * CYC_MS) sim_cyc = tick * CYC_MS;
+    sim_cyc += rand() % JITTER_CYC;
+    DWT->CYCCNT = (uint32_t)sim_cyc;
+    Sch_Tick_IRQ_Handler();
+    if (SCB->ICSR & SCB_ICSR_PENDSVSET_Msk) {
+      SCB->ICSR = 0;
+      Sch_PendSV_IRQ_Handler();
+    }
+  }
+  // 任务添加时(时刻0)到期, 最后一次运行时已到期的周期都应已运行
+  slots = last_fast / CYC_MS + 1;
+  printf("1kHz: %u runs, %llu periods due\n", cnt_fast,
+         (unsigned long long)slots);
+  assert(cnt_fast == slots);
+  slots = last_slow / (480000000 / 300) + 1;
+  printf("300Hz: %u runs, %llu periods due, sum dt %.6f s\n", cnt_slow,
+         (unsigned long long)slots, sum_dt);
+  assert(cnt_slow == slots);
+  assert(fabs(sum_dt - (double)(last_slow - first_slow) / 480000000.0) <
+         1e-3);
+  assert(cnt_fast > SIM_MS - 2 && cnt_slow > SIM_MS * 3 / 10 - 2);
+  // 锁定期间错过的周期在解锁后补跑
+  assert(Sch_Get_Stat(fast, &info) && info.stat.overrun > 0);
+  return 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * @file test_sch_event.c
+ * @brief 事件任务投递到运行的延迟(仿真): 中断随机时刻调用Sch_Post,
+ * 实时事件任务在PendSV中先于到期的周期任务运行, 高事件优先级先运行,
+ * 未运行前的重复投递被合并; 延迟上限为正在运行的实时任务剩余时间或
+ * 调度锁剩余时间. 仿真的DWT只在任务和锁内前进, 不含中断进出和PendSV
+ * 切换的硬件开销, 给出的是调度逻辑造成的延迟, 不是H750上的实测值
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scheduler.h"
+
+#define CYC_US 480                 // 每us的DWT周期数
+#define RT_EXEC_CYC (50 * CYC_US)  // 周期实时任务执行时间
+#define LOCK_CYC (20 * CYC_US)     // 后台任务持有调度锁的时间
+#define EVT_EXEC_CYC (2 * CYC_US)  // 事件任务执行时间
+#define POSTS 10000                // 每种场景的投递次数
+
+static uint64_t sim_cyc;  // 仿真时刻, DWT周期
+static uint8_t evt_hi, evt_lo, periodic;
+static uint32_t post_at, post_cnt;
+static uint32_t lat_max, lat_sum, lat_num;
+static uint8_t order[4], order_num;
+static uint32_t evt_bits;
+
+static void Advance(uint32_t cyc) {
+  sim_cyc += cyc;
+  DWT->CYCCNT = (uint32_t)sim_cyc;
+}
+
+/**
+ * @brief PendSV挂起且未被调度锁屏蔽时运行(中断返回后咬尾进入)
+ */
+static void PendSV(void) {
+  uint32_t basepri = __get_BASEPRI();
+  if (!(SCB->ICSR & SCB_ICSR_PENDSVSET_Msk)) return;
+  if (basepri != 0 && basepri <= SCH_RT_IRQ_PRIO << (8U - __NVIC_PRIO_BITS))
+    return;
+  SCB->ICSR = 0;
+  Sch_PendSV_IRQ_Handler();
+}
+
+static void Record(uint8_t id) {
+  uint32_t lat = DWT->CYCCNT - post_at;
+  if (order_num < sizeof(order)) order[order_num++] = id;
+  if (id != evt_hi) return;
+  if (lat > lat_max) lat_max = lat;
+  lat_sum += lat;
+  lat_num++;
+}
+
+static void Event_Hi(uint32_t events) {
+  Record(evt_hi);
+  evt_bits |= events;
+  Advance(EVT_EXEC_CYC);
+}
+
+static void Event_Lo(uint32_t events) {
+  Record(evt_lo);
+  Advance(EVT_EXEC_CYC);
+}
+
+/**
+ * @brief 周期实时任务, 执行期间随机时刻发生中断投递事件
+ */
+static void Task_Periodic(void) {
+  uint32_t at = rand() % RT_EXEC_CYC;
+  if (order_num < sizeof(order)) order[order_num++] = periodic;
+  Advance(at);
+  if (post_cnt > 0) {
+    post_cnt--;
+    post_at = DWT->CYCCNT;
+    Sch_Post(evt_hi, 1);
+  }
+  Advance(RT_EXEC_CYC - at);
+}
+
+static void Reset_Latency(void) {
+  lat_max = 0;
+  lat_sum = 0;
+  lat_num = 0;
+  Sch_Reset_Stat(SCH_INVALID_ID);
+}
+
+static void Report(const char *name, uint32_t bound) {
+  scheduler_task_t info;
+  assert(Sch_Get_Stat(evt_hi, &info));
+  printf("%s: %u posts, mean %.2f us, max %.2f us (bound %.2f us)\n", name,
+         lat_num, (double)lat_sum / lat_num / CYC_US,
+         (double)lat_max / CYC_US, (double)bound / CYC_US);
+  assert(lat_num == POSTS);
+  assert(lat_max <= bound);
+  assert(info.stat.maxLateCyc == lat_max);  // 调度器统计与实测一致
+}
+
+/**
+ * @brief 空闲时投递: 立即运行
+ */
+static void Test_Idle(void) {
+  Reset_Latency();
+  for (int i = 0; i < POSTS; i++) {
+    Advance(rand() % (1000 * CYC_US));
+    post_at = DWT->CYCCNT;
+    Sch_Post(evt_hi, 1);
+    PendSV();
+  }
+  Report("idle", 0);
+}
+
+/**
+ * @brief 周期实时任务运行时投递: 任务结束后先于其他到期任务运行
+ */
+static void Test_Busy_RT(void) {
+  Reset_Latency();
+  post_cnt = POSTS;
+  while (post_cnt > 0) {
+    Advance(1000 * CYC_US);  // 下一个SysTick
+    Sch_Tick_IRQ_Handler();
+    order_num = 0;
+    PendSV();
+    assert(order_num == 0 || order[0] == periodic);
+    assert(order_num < 2 || order[1] == evt_hi);
+  }
+  Report("during RT task", RT_EXEC_CYC);
+}
+
+/**
+ * @brief 后台任务持有调度锁时投递: 解锁后立即运行
+ */
+static void Test_Locked(void) {
+  uint32_t at, basepri;
+  Reset_Latency();
+  for (int i = 0; i < POSTS; i++) {
+    at = rand() % LOCK_CYC;
+    basepri = Sch_Lock();
+    Advance(at);
+    post_at = DWT->CYCCNT;
+    Sch_Post(evt_hi, 1);
+    PendSV();  // 投递中断返回时PendSV被调度锁屏蔽
+    assert(lat_num == (uint32_t)i);
+    Advance(LOCK_CYC - at);
+    Sch_Unlock(basepri);
+    PendSV();
+  }
+  Report("scheduler locked", LOCK_CYC);
+}
+
+/**
+ * @brief 同时就绪时高事件优先级先运行, 运行前的重复投递合并
+ */
+static void Test_Order(void) {
+  scheduler_task_t info;
+  Sch_Reset_Stat(SCH_INVALID_ID);
+  order_num = 0;
+  evt_bits = 0;
+  Sch_Post(evt_lo, 1);
+  Sch_Post(evt_hi, 1);
+  Sch_Post(evt_hi, 4);
+  PendSV();
+  assert(order_num == 2 && order[0] == evt_hi && order[1] == evt_lo);
+  assert(evt_bits == 5);
+  assert(Sch_Get_Stat(evt_hi, &info) && info.stat.overrun == 1);
+}
+
+int main(void) {
+  srand(1);
+  evt_hi = Add_SchEvent(Event_Hi, SCH_PRIO_RT, 10);
+  evt_lo = Add_SchEvent(Event_Lo, SCH_PRIO_RT, 2);
+  periodic = Add_SchTask(Task_Periodic, 1000, 1);
+  _Set_SchTask_Prio_Id(periodic, SCH_PRIO_RT);
+  assert(evt_hi != SCH_INVALID_ID && evt_lo != SCH_INVALID_ID);
+  _Disable_SchTask_Id(periodic);
+  Test_Order();
+  Test_Idle();
+  Test_Locked();
+  _Enable_SchTask_Id(periodic);
+  Test_Busy_RT();
+  printf("host simulation only, on-target latency adds interrupt entry/exit "
+         "and PendSV tail-chaining\n");
+  return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file test_step_change.c
+ * @brief 运动中修改速度(重新规划目标, 连续速度, 流式速度)和急停: 输出通道的
+ * CCR在任何周期都不超过ARR(否则输出一直为高, 该周期没有脉冲), 位置准确
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "host_step.h"
+
+static host_tim_stat_t *st;
+
+/**
+ * @brief 检查输出没有丢失的脉冲
+ */
+static void Check_Output(int64_t target) {
+  assert(Step_Get_Pos(&step_1) == target);
+  assert(st->stall == 0 && st->phantom == 0);
+}
+
+/**
+ * @brief 主定时器输出通道的比较输出模式
+ */
+static uint32_t OC_Mode(step_ctrl_t *step) {
+  TIM_TypeDef *tim = step->timMaster->Instance;
+  uint32_t ccmr = step->timMasterCh < TIM_CHANNEL_3 ? tim->CCMR1 : tim->CCMR2;
+  return (ccmr >> ((step->timMasterCh & 0x04U) << 1)) & TIM_CCMR1_OC1M;
+}
+
+/**
+ * @brief 高速运动中降速, 从当前速度沿减速表减速到新的匀速段
+ */
+static void Test_Retarget_Slowdown(void) {
+  int64_t target = Step_Get_Pos(&step_1) + 30000;
+  Host_TIM_Reset_Stat(TIM1);
+  Step_Set_Speed(&step_1, STEP_PWM_MAX_FREQ);
+  Step_Rotate(&step_1, 30000);
+  assert(Host_Run(STEP_TIM_BASE_CLK / 4) == 0);
+  Step_Retarget(&step_1, target, 2000);
+  assert(Host_Run(STEP_TIM_BASE_CLK / 10) == 0);
+  Step_Retarget(&step_1, target, 15000);  // 再次加速
+  assert(Host_Run(STEP_TIM_BASE_CLK / 10) == 0);
+  Step_Retarget(&step_1, target, 5000);
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 20));
+  Check_Output(target);
+  assert(st->ccrMax <= st->arrMin);  // 加减速表的分频系数相同
+  printf("retarget: ccr max %u, arr min %u\n", st->ccrMax, st->arrMin);
+}
+
+/**
+ * @brief 连续速度模式中反复改变速度, 最后减速停止
+ */
+static void Jog_Sequence(const double *vel, uint8_t n) {
+  int64_t start = Step_Get_Pos(&step_1);
+  Host_TIM_Reset_Stat(TIM1);
+  for (uint8_t i = 0; i < n; i++) {
+    Step_Jog(&step_1, vel[i]);
+    assert(Host_Run(STEP_TIM_BASE_CLK / 10) == 0);
+  }
+  Step_Jog(&step_1, 0);
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 20));
+  Check_Output(start + st->pulses);
+}
+
+/**
+ * @brief 连续速度模式中改变速度: 加减速时沿表过渡, 不加减速时新的
+ * PSC/ARR/CCR在同一个更新事件生效, 不重置计数器
+ */
+static void Test_Jog_Change(void) {
+  const double vel[] = {STEP_PWM_MAX_FREQ, 3000, 12000, 50, 8000, 1000};
+  Jog_Sequence(vel, sizeof(vel) / sizeof(vel[0]));
+  Step_Set_Accel(&step_1, 0);
+  Jog_Sequence(vel, sizeof(vel) / sizeof(vel[0]));
+  Step_Set_Accel(&step_1, 400000);
+  printf("jog: %u pulses, pos %lld\n", st->pulses,
+         (long long)Step_Get_Pos(&step_1));
+}
+
+/**
+ * @brief 流式速度模式停止输出期间从定时器不计数, 恢复后位置准确
+ * @param  step             步进电机(step_2的输出在TIM4_CH4, CCR1为0)
+ */
+static void Test_Stream_Stop(step_ctrl_t *step) {
+  host_tim_stat_t *s = Host_TIM_Stat(step->timMaster->Instance);
+  const double vel[] = {0, 5000, 0, -3000, 10, 20000, 0};
+  int64_t pos = Step_Get_Pos(step);
+  uint32_t last = 0;
+  uint8_t stop;
+  int8_t dir = 1;
+  Host_TIM_Reset_Stat(step->timMaster->Instance);
+  Step_Stream_Begin(step);
+  for (uint8_t i = 0; i < sizeof(vel) / sizeof(vel[0]); i++) {
+    Step_Stream_Velocity(step, vel[i]);
+    stop = fabs(vel[i]) < STEP_STREAM_MIN_FREQ;
+    assert(!stop || Step_Get_Speed(step) == 0);
+    assert(Host_Run(STEP_TIM_BASE_CLK / 5) == stop);  // 停止时主定时器不运行
+    if (!stop) dir = vel[i] > 0 ? 1 : -1;  // 停止时补完的脉冲沿用原方向
+    pos += dir * (int64_t)(s->trgo - last);
+    last = s->trgo;
+    assert(Step_Get_Pos(step) == pos);
+    assert(!stop || s->trgo == s->pulses);  // 停止在完整的脉冲之后
+  }
+  Step_Stream_End(step);
+  assert(Step_Get_Pos(step) == pos);
+  assert(s->phantom == 0 && s->stall == 0);
+  printf("stream: %u pulses, pos %lld\n", s->pulses, (long long)pos);
+}
+
+/**
+ * @brief 急停立即停止所有轴并强制输出低电平, 通知后台清理; 状态由
+ * Step_EStop_Clear清理前不能恢复输出, 也不接受新的运动指令
+ */
+static uint32_t estop_cb;
+void Step_EStop_Callback(void) { estop_cb++; }
+
+static void Test_EStop(void) {
+  step_ctrl_t *steps[3] = {&step_1, &step_2, &step_3};
+  int64_t pos[3], moves[1] = {1000};
+  uint8_t i;
+  Step_Set_Speed(&step_1, 20000);
+  Step_Rotate(&step_1, 100000);
+  Step_Rotate(&step_1, 5000);
+  Step_Stream_Begin(&step_2);
+  Step_Stream_Velocity(&step_2, 5000);
+  Step_Jog(&step_3, -8000);
+  assert(Host_Run(STEP_TIM_BASE_CLK / 20) == 0);
+  Step_EStop();
+  assert(estop_cb == 1);
+  for (i = 0; i < 3; i++) {
+    pos[i] = Step_Get_Pos(steps[i]);
+    Host_TIM_Reset_Stat(steps[i]->timMaster->Instance);
+    assert(OC_Mode(steps[i]) == TIM_OCMODE_FORCED_INACTIVE);
+  }
+  Step_Stream_Velocity(&step_2, 3000);  // 清理前拒绝恢复和新的运动指令
+  Step_Resume(&step_1);
+  Step_Jog(&step_3, 8000);
+  Step_Retarget(&step_1, pos[0] + 20000, 10000);
+  Step_Stop_Ramp(&step_1, 0);
+  Step_Rotate(&step_1, 1000);
+  Step_Rotate_Sync(steps, moves, 1, 10000);
+  for (i = 0; i < 3; i++) assert(steps[i]->paused && steps[i]->estop);
+  assert(Host_Run(STEP_TIM_BASE_CLK / 10) == 1);
+  Step_Planner_Task();  // 实时规划任务不做清理
+  for (i = 0; i < 3; i++) assert(steps[i]->paused && steps[i]->estop);
+  Step_EStop_Clear();
+  for (i = 0; i < 3; i++) {
+    assert(Host_TIM_Stat(steps[i]->timMaster->Instance)->pulses == 0);
+    assert(!steps[i]->rotating && !steps[i]->stream && !steps[i]->jog);
+    assert(!steps[i]->paused && !steps[i]->estop);
+    assert(Step_Queue_Depth(steps[i]) == 0);
+    assert(Step_Get_Pos(steps[i]) == pos[i]);
+    assert(OC_Mode(steps[i]) == TIM_OCMODE_PWM1);
+  }
+  Step_Rotate(&step_1, 1000);  // 清理后可以正常运动
+  assert(Host_Step_Run(STEP_TIM_BASE_CLK));
+  assert(Step_Get_Pos(&step_1) == pos[0] + 1000);
+  printf("estop: pos %lld %lld %lld\n", (long long)pos[0], (long long)pos[1],
+         (long long)pos[2]);
+}
+
+int main(void) {
+  Host_Step_Init();
+  st = Host_TIM_Stat(TIM1);
+  Step_Set_Accel(&step_1, 400000);
+  Test_Retarget_Slowdown();
+  Test_Jog_Change();
+  Test_Stream_Stop(&step_1);
+  Test_Stream_Stop(&step_2);
+  Test_EStop();
+  assert(Host_Assert_Count() == 0);
+  return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file test_step_drift.c
+ * @brief 位置漂移: 10^6次随机相对/绝对运动后, 位置与累计的目标完全一致,
+ * 输出的脉冲数与各段脉冲数之和一致
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_step.h"
+
+#define MOVES 1000000
+#define BATCH 8  // 每批排队的段数, 不超过队列长度
+
+int main(void) {
+  host_tim_stat_t *st;
+  int64_t target = 0;
+  uint64_t pulses = 0, done = 0;
+  uint32_t n, batch;
+  int32_t d;
+  Host_Step_Init();
+  st = Host_TIM_Stat(TIM1);
+  Step_Set_Accel(&step_1, 1000000);
+  Step_Set_Speed(&step_1, STEP_PWM_MAX_FREQ);
+  srand(1);
+  while (done < MOVES) {
+    Host_TIM_Reset_Stat(TIM1);
+    batch = 0;
+    for (n = 0; n < BATCH && done < MOVES; n++, done++) {
+      do {
+        d = rand() % 41 - 20;
+      } while (d > -2 && d < 2);
+      if (rand() & 1) {
+        Step_Rotate(&step_1, d);
+      } else {
+        Step_Rotate_Abs(&step_1, target + d);
+      }
+      target += d;
+      batch += d > 0 ? d : -d;
+    }
+    pulses += batch;
+    assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK));
+    assert(Step_Get_Pos(&step_1) == target);
+    assert(st->pulses == batch && st->trgo == batch && st->phantom == 0);
+  }
+  assert(Host_Assert_Count() == 0);
+  printf("drift: %d moves, %llu pulses, pos %lld\n", MOVES,
+         (unsigned long long)pulses, (long long)target);
+  return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file test_step_queue.c
+ * @brief 运动段队列: 运动中排队不同速度的运动段, 检查位置, 脉冲数和每段的
+ * 匀速周期(速度配置在入队时求解, 完成中断中只装载整数配置);
+ * 从静止启动的段在减速点之前排入同向同速的段时, 重新规划出口速度直接衔接;
+ * 设置加速度(串口中断中)不生成加速表, 由规划任务生成
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "host_step.h"
+
+#define TICK_FREQ ((double)STEP_TIM_BASE_CLK / STEP_RAMP_PSC)
+
+static host_tim_stat_t *st;
+
+/**
+ * @brief 运动中修改速度只影响之后入队的段
+ */
+static void Test_Mixed_Speed(void) {
+  int32_t moves[] = {3000, 5000, 2000, -4000, 200, 6000};
+  double speeds[] = {5000, 20000, 800, 12000, 80, 15000};
+  int64_t target = Step_Get_Pos(&step_1);
+  uint8_t i, n = sizeof(moves) / sizeof(moves[0]);
+  Host_TIM_Reset_Stat(TIM1);
+  for (i = 0; i < n; i++) {
+    Step_Set_Speed(&step_1, speeds[i]);  // 运动中设置速度不报错
+    Step_Rotate(&step_1, moves[i]);
+    target += moves[i];
+    if (i == 0) assert(fabs(Step_Get_Speed(&step_1) - 5000) < 5);
+  }
+  assert(step_1.rotating);
+  assert(Step_Queue_Depth(&step_1) == n - 1);
+  assert(fabs(step_1.speedSet - 15000) < 1e-9);
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 20));
+  assert(Step_Get_Pos(&step_1) == target);
+  assert(st->pulses == 3000 + 5000 + 2000 + 4000 + 200 + 6000);
+  assert(st->trgo == st->pulses && st->phantom == 0);
+  assert(st->stall == 0);
+  // 最快一段的匀速周期来自入队时求解的配置
+  assert(st->arrMin == (uint32_t)(TICK_FREQ / 20000 + 0.5) - 1);
+  printf("mixed: %u pulses, pos %lld, min arr %u\n", st->pulses,
+         (long long)Step_Get_Pos(&step_1), st->arrMin);
+}
+
+/**
+ * @brief 运行n个同向同速的段(第一段从静止启动), 返回总时间
+ */
+static double Run_Segments(int32_t pulse, uint8_t n) {
+  int64_t target = Step_Get_Pos(&step_1) + (int64_t)pulse * n;
+  Host_TIM_Reset_Stat(TIM1);
+  for (uint8_t i = 0; i < n; i++) Step_Rotate(&step_1, pulse);
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 20));
+  assert(Step_Get_Pos(&step_1) == target);
+  assert(st->pulses == (uint32_t)pulse * n && st->stall == 0);
+  return (double)st->clk / STEP_TIM_BASE_CLK;
+}
+
+/**
+ * @brief 正在运行的第一段与排队段衔接, 中间不减速到静止
+ */
+static void Test_Blend_Running(void) {
+  double single, queued;
+  Step_Set_Speed(&step_1, 10000);
+  single = Run_Segments(12000, 1);
+  queued = Run_Segments(4000, 3);
+  // 不衔接时每段多出一次减速和加速(约0.1s)
+  assert(fabs(queued - single) < 0.002);
+  printf("blend: single %.4f s, 3 queued %.4f s\n", single, queued);
+}
+
+/**
+ * @brief 设置加速度只记录数值, 加速表在规划任务中重新生成
+ */
+static void Test_Deferred_Ramp(void) {
+  Step_Set_Accel(&step_1, 100000);
+  assert(step_1.rampStale && step_1.rampAccel == 200000);
+  Step_Planner_Task();
+  assert(!step_1.rampStale && step_1.rampAccel == 100000);
+  assert(step_1.rampMax > 0);
+  // 规划任务运行之前启动的运动同样使用新的加速度
+  Step_Set_Accel(&step_1, 200000);
+  Step_Rotate(&step_1, 3000);
+  assert(step_1.rotating && step_1.rampAccel == 200000);
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 20));
+  printf("deferred ramp: rebuilt %u entries\n", step_1.rampMax);
+}
+
+int main(void) {
+  Host_Step_Init();
+  st = Host_TIM_Stat(TIM1);
+  Step_Set_Accel(&step_1, 200000);
+  Test_Mixed_Speed();
+  Test_Blend_Running();
+  Test_Deferred_Ramp();
+  assert(Host_Assert_Count() == 0);
+  return 0;
+}
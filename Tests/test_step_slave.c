@@ -0,0 +1,41 @@
+/**
+ * @file test_step_slave.c
+ * @brief 16位从定时器(TIM3)分段计数: 脉冲数为 k*65536+1 时最后一段
+ * 不能为ARR=0(计数器不计数, 运动无法结束), 各种分段边界的位置都准确
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "host_step.h"
+
+int main(void) {
+  host_tim_stat_t *st;
+  int32_t moves[] = {65537, -131073, 65536, 65538, -2, 196609, -65535};
+  int64_t target = 0;
+  uint8_t i, n = sizeof(moves) / sizeof(moves[0]);
+  Host_Step_Init();
+  st = Host_TIM_Stat(TIM4);
+  Step_Set_Speed(&step_2, STEP_PWM_MAX_FREQ);
+  for (i = 0; i < n; i++) {
+    Host_TIM_Reset_Stat(TIM4);
+    Step_Rotate(&step_2, moves[i]);
+    target += moves[i];
+    assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 20));
+    assert(Step_Get_Pos(&step_2) == target);
+    assert(st->pulses == (uint32_t)(moves[i] > 0 ? moves[i] : -moves[i]));
+  }
+  // 加减速运动中重新规划到 k*65536+1 的终点
+  Step_Set_Accel(&step_2, 400000);
+  Step_Rotate(&step_2, 100000);
+  assert(Host_Run(STEP_TIM_BASE_CLK / 2) == 0);
+  Step_Retarget(&step_2, target + 131073, 0);
+  target += 131073;
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 20));
+  assert(Step_Get_Pos(&step_2) == target);
+  assert(Host_Assert_Count() == 0);
+  printf("slave: pos %lld\n", (long long)target);
+  return 0;
+}
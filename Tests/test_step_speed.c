@@ -0,0 +1,44 @@
+/**
+ * @file test_step_speed.c
+ * @brief 1Hz到STEP_PWM_MAX_FREQ扫频, 检查求解的PSC/ARR:
+ * 频率误差不超过半个计数, 分频系数接近使ARR不溢出的最小值(占空比分辨率高)
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "host_step.h"
+
+int main(void) {
+  double f, real, err, errMax = 0, fMax = 0;
+  double n;
+  uint32_t psc, arr, cnt = 0;
+  Host_Step_Init();
+  for (f = 1; f <= STEP_PWM_MAX_FREQ; f += f < 100 ? 0.25 : f / 2000) {
+    Step_Set_Speed(&step_1, f);
+    psc = step_1.speedCfg.psc;
+    arr = step_1.speedCfg.arr + 1;
+    assert(step_1.speedCfg.mode == STEP_MODE_CONST);
+    assert(psc >= 1 && psc <= 0x10000 && arr >= 2 && arr <= 0x10000);
+    real = Step_Get_Speed(&step_1);
+    assert(fabs(real - (double)STEP_TIM_BASE_CLK / psc / arr) < 1e-9 * real);
+    n = (double)STEP_TIM_BASE_CLK / f;
+    // 总分频误差不超过半个计数(按所选分频系数)
+    assert(fabs((double)psc * arr - n) <= psc / 2.0 + 1e-6);
+    // 分频系数不超过使ARR不溢出的最小值+2
+    assert(psc <= ceil(n / 0x10000) + 2);
+    err = fabs(real - f) / f;
+    if (err > errMax) {
+      errMax = err;
+      fMax = f;
+    }
+    cnt++;
+  }
+  assert(errMax < 0.5 * STEP_PWM_MAX_FREQ / STEP_TIM_BASE_CLK);
+  assert(Host_Assert_Count() == 0);
+  printf("speed sweep: %u set-points, max error %.2e at %.2f Hz\n", cnt,
+         errMax, fMax);
+  return 0;
+}
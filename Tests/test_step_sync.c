@@ -0,0 +1,77 @@
+/**
+ * @file test_step_sync.c
+ * @brief 多轴同步运动: 各轴同时到达, 主轴速度先限制再缩放,
+ * 各轴的设定速度/加速度不被改写, 之后的运动按设定值重新生成加速表;
+ * 超出32位的位移被拒绝, 不截断
+ *
+ * THINK DIFFERENTLY
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "host_step.h"
+
+#define TICK_FREQ ((double)STEP_TIM_BASE_CLK / STEP_RAMP_PSC)
+
+static uint32_t Cruise_Arr(double speed) {
+  return (uint32_t)(TICK_FREQ / speed + 0.5) - 1;
+}
+
+int main(void) {
+  step_ctrl_t *steps[3] = {&step_1, &step_2, &step_3};
+  int64_t pulses[3] = {40000, -20000, 10000};
+  double accel[3] = {400000, 800000, 300000};
+  double speed[3] = {5000, 8000, 3000};
+  host_tim_stat_t *st[3];
+  uint64_t clk[3];
+  uint8_t i;
+  Host_Step_Init();
+  st[0] = Host_TIM_Stat(TIM1);
+  st[1] = Host_TIM_Stat(TIM4);
+  st[2] = Host_TIM_Stat(TIM8);
+  for (i = 0; i < 3; i++) {
+    Step_Set_Accel(steps[i], accel[i]);
+    Step_Set_Speed(steps[i], speed[i]);
+  }
+  // 主轴速度超过最高频率, 限制后其余轴按限制后的速度缩放
+  Step_Rotate_Sync(steps, pulses, 3, 50000);
+  for (i = 0; i < 3; i++) {
+    assert(steps[i]->accel == accel[i] && steps[i]->jerk == 0);
+    assert(steps[i]->speedSet == speed[i]);
+  }
+  assert(fabs(Step_Get_Speed(&step_2) - STEP_PWM_MAX_FREQ / 2) < 30);
+  Step_Rotate(&step_2, 3000);  // 同步运动结束后按设定值执行
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 10));
+  assert(Step_Get_Pos(&step_1) == 40000);
+  assert(Step_Get_Pos(&step_2) == -17000);
+  assert(Step_Get_Pos(&step_3) == 10000);
+  for (i = 0; i < 3; i++) {
+    assert(st[i]->stall == 0 && st[i]->phantom == 0);
+    clk[i] = st[i]->clk;
+  }
+  assert(st[0]->arrMin == Cruise_Arr(STEP_PWM_MAX_FREQ));
+  // 各轴的运动时间一致(步进轴2之后还有一段排队的运动)
+  assert(fabs((double)clk[2] / clk[0] - 1) < 0.01);
+  assert(clk[1] > clk[0]);
+  // 之后的运动使用设定的速度和加速度
+  for (i = 0; i < 3; i++) Host_TIM_Reset_Stat(steps[i]->timMaster->Instance);
+  Step_Rotate(&step_1, 5000);
+  assert(Host_Step_Run((uint64_t)STEP_TIM_BASE_CLK * 10));
+  assert(Step_Get_Pos(&step_1) == 45000);
+  assert(st[0]->arrMin == Cruise_Arr(speed[0]));
+  // 加速到5000Hz需要 v^2/2a 个脉冲, 与按设定加速度生成的表一致
+  assert(step_1.rampLen == (uint16_t)(speed[0] * speed[0] / 2 / accel[0]) ||
+         step_1.rampLen == (uint16_t)(speed[0] * speed[0] / 2 / accel[0]) + 1);
+  assert(Host_Assert_Count() == 0);
+  // 截断为int32后会变为反方向的小位移
+  pulses[0] = 0x100000000LL - 1000;
+  Step_Rotate_Sync(steps, pulses, 3, 5000);
+  assert(Host_Assert_Count() == 1);
+  assert(!step_1.rotating && !step_2.rotating && !step_3.rotating);
+  assert(Step_Get_Pos(&step_1) == 45000);
+  printf("sync: time %.4f/%.4f/%.4f s\n", clk[0] / (double)STEP_TIM_BASE_CLK,
+         clk[1] / (double)STEP_TIM_BASE_CLK,
+         clk[2] / (double)STEP_TIM_BASE_CLK);
+  return 0;
+}
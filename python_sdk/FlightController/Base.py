@@ -125,23 +125,62 @@ class FC_State_Struct:
     step1_target_angle = Byte_Var("s32", float, 0.001)  # deg
     step1_rotating = Byte_Var("u8", bool)  # bool
     step1_dir = Byte_Var("u8", int)  # 0:逆时针 1:顺时针
+    step1_queue = Byte_Var("u8", int)  # 排队中的运动段数
+    step1_planned = Byte_Var("u8", int)  # 已完成前瞻规划的段数
+    step1_freq = Byte_Var("u32", float, 0.001)  # Hz 实际脉冲频率
+    step1_freq_set = Byte_Var("u32", float, 0.001)  # Hz 设定脉冲频率
 
     step2_speed = Byte_Var("s32", float, 0.01)  # deg/s
     step2_angle = Byte_Var("s32", float, 0.001)  # deg
     step2_target_angle = Byte_Var("s32", float, 0.001)  # deg
     step2_rotating = Byte_Var("u8", bool)  # bool
     step2_dir = Byte_Var("u8", int)  # 0:逆时针 1:顺时针
+    step2_queue = Byte_Var("u8", int)  # 排队中的运动段数
+    step2_planned = Byte_Var("u8", int)  # 已完成前瞻规划的段数
+    step2_freq = Byte_Var("u32", float, 0.001)  # Hz 实际脉冲频率
+    step2_freq_set = Byte_Var("u32", float, 0.001)  # Hz 设定脉冲频率
 
     step3_speed = Byte_Var("s32", float, 0.01)  # deg/s
     step3_angle = Byte_Var("s32", float, 0.001)  # deg
     step3_target_angle = Byte_Var("s32", float, 0.001)  # deg
     step3_rotating = Byte_Var("u8", bool)  # bool
     step3_dir = Byte_Var("u8", int)  # 0:逆时针 1:顺时针
+    step3_queue = Byte_Var("u8", int)  # 排队中的运动段数
+    step3_planned = Byte_Var("u8", int)  # 已完成前瞻规划的段数
+    step3_freq = Byte_Var("u32", float, 0.001)  # Hz 实际脉冲频率
+    step3_freq_set = Byte_Var("u32", float, 0.001)  # Hz 设定脉冲频率
+
+    sync_skew = Byte_Var("u16", int)  # ns 多轴同步启动偏差, 0xFFFF为溢出
+    pvt_depth = Byte_Var("u8", int)  # 轨迹点缓冲深度
+    pvt_underrun = Byte_Var("u16", int)  # 轨迹点缓冲取空次数
+
+    dc1_speed = Byte_Var("s32", float, 0.01)  # rpm
+    dc1_angle = Byte_Var("s32", float, 0.001)  # deg
+    dc1_duty = Byte_Var("s16", float, 0.01)  # % PWM占空比
+    dc1_mode = Byte_Var("u8", int)  # 0:速度环 1:位置环
+    dc1_tune = Byte_Var("u8", int)  # 自整定 0:未进行 1:进行中 2:完成 3:失败
+
+    dc2_speed = Byte_Var("s32", float, 0.01)  # rpm
+    dc2_angle = Byte_Var("s32", float, 0.001)  # deg
+    dc2_duty = Byte_Var("s16", float, 0.01)  # % PWM占空比
+    dc2_mode = Byte_Var("u8", int)  # 0:速度环 1:位置环
+    dc2_tune = Byte_Var("u8", int)  # 自整定 0:未进行 1:进行中 2:完成 3:失败
+
+    motor_loop_wcet = Byte_Var("u16", int)  # ns 直流电机控制环最长执行时间
+    motor_loop_overrun = Byte_Var("u16", int)  # 直流电机控制环超时次数
+    cpu_load = Byte_Var("u16", float, 0.01)  # % 调度器任务CPU占用率
 
     RECV_ORDER = [  # 数据包顺序
-        step1_speed,step1_angle,step1_target_angle,step1_rotating,step1_dir,
-        step2_speed,step2_angle,step2_target_angle,step2_rotating,step2_dir,
-        step3_speed,step3_angle,step3_target_angle,step3_rotating,step3_dir,
+        step1_speed,step1_angle,step1_target_angle,step1_rotating,step1_dir,step1_queue,step1_planned,
+        step1_freq,step1_freq_set,
+        step2_speed,step2_angle,step2_target_angle,step2_rotating,step2_dir,step2_queue,step2_planned,
+        step2_freq,step2_freq_set,
+        step3_speed,step3_angle,step3_target_angle,step3_rotating,step3_dir,step3_queue,step3_planned,
+        step3_freq,step3_freq_set,
+        sync_skew,pvt_depth,pvt_underrun,
+        dc1_speed,dc1_angle,dc1_duty,dc1_mode,dc1_tune,
+        dc2_speed,dc2_angle,dc2_duty,dc2_mode,dc2_tune,
+        motor_loop_wcet,motor_loop_overrun,cpu_load,
     ]  # fmt: skip
 
     def __init__(self):
@@ -224,11 +263,17 @@ class FC_Event_Struct:
     key_short = FC_Event()
     key_long = FC_Event()
     key_double = FC_Event()
+    step1_done = FC_Event()
+    step2_done = FC_Event()
+    step3_done = FC_Event()
 
     EVENT_CODE = {
         0x01: key_short,
         0x02: key_long,
         0x03: key_double,
+        0x04: step1_done,
+        0x05: step2_done,
+        0x06: step3_done,
     }
 
 
@@ -257,6 +302,7 @@ class FC_Base_Uart_Comunication(object):
         self._ser_32 = None
         self._send_lock = threading.Lock()
         self._recivied_ack_dict = {}
+        self.sch_stats = {}  # 调度器任务统计, 由sch_query更新
         self._event_update_callback = None  # 仅供FC_Remote使用
         self.state = FC_State_Struct()
         self.event = FC_Event_Struct()
@@ -365,6 +411,8 @@ class FC_Base_Uart_Comunication(object):
                         self._recivied_ack_dict[data[0]] = time.perf_counter()
                     elif cmd == 0x03:  # 事件通讯
                         self._update_event(data)
+                    elif cmd == 0x04:  # 调度器任务统计
+                        self._update_sch_stat(data)
                 if time.perf_counter() - last_heartbeat_time > 0.25:  # 心跳包
                     self.send_data_to_fc(b"\x01", 0x00)
                     last_heartbeat_time = time.perf_counter()
@@ -405,6 +453,24 @@ class FC_Base_Uart_Comunication(object):
         except Exception as e:
             logger.error(f"[FC] Update state exception: {traceback.format_exc()}")
 
+    SCH_STAT_KEYS = (
+        "id", "state", "max_task", "rate", "run_cnt", "min_cyc", "avg_cyc",
+        "max_cyc", "max_late", "overrun", "load", "cpu_load", "core_clock",
+    )  # fmt: skip
+
+    def _update_sch_stat(self, recv_byte):
+        try:
+            vals = struct.unpack("<BBBIIIIIIIHHI", recv_byte)
+            stat = dict(zip(self.SCH_STAT_KEYS, vals))
+            stat["exists"] = bool(stat["state"] & 0x01)
+            stat["enable"] = bool(stat["state"] & 0x02)
+            stat["rate"] /= 1000  # Hz
+            stat["load"] /= 100  # %
+            stat["cpu_load"] /= 100  # %
+            self.sch_stats[stat["id"]] = stat
+        except Exception as e:
+            logger.error(f"[FC] Update sch stat exception: {traceback.format_exc()}")
+
     def _set_event_callback(self, func):
         self._event_update_callback = func
 
@@ -14,6 +14,11 @@ class FC_Protocol(FC_Base_Uart_Comunication):
     STEP1 = 0x01
     STEP2 = 0x02
     STEP3 = 0x04
+    DC1 = 0x01
+    DC2 = 0x02
+    QUEUE_SIZE = 16  # 与固件STEP_QUEUE_SIZE一致
+    PVT_BUF_SIZE = 64  # 与固件PVT_BUF_SIZE一致
+    PVT_MAX_PER_FRAME = 4  # 与固件PVT_MAX_PER_FRAME一致
 
     def __init__(self, *args, **kwargs) -> None:
         super().__init__(*args, **kwargs)
@@ -48,6 +53,17 @@ class FC_Protocol(FC_Base_Uart_Comunication):
         if not self.step_idle(motor):
             raise Exception(f"Step {motor} is not idle")
 
+    def _check_queue(self, motor: int):
+        if not self.settings.check_idle:
+            return
+        for mask, depth in (
+            (self.STEP1, self.state.step1_queue),
+            (self.STEP2, self.state.step2_queue),
+            (self.STEP3, self.state.step3_queue),
+        ):
+            if motor & mask and depth.value >= self.QUEUE_SIZE:
+                raise Exception(f"Step {motor} queue is full")
+
     ######### 飞控命令 #########
 
     def _send_command(self, option: int, data: bytes = b"", need_ack=True) -> None:
@@ -65,6 +81,30 @@ class FC_Protocol(FC_Base_Uart_Comunication):
         self._send_command(0x01, self._byte_temp1.bytes + self._byte_temp2.bytes)
         self._action_log("set speed", f"Step {motor} speed: {speed}")
 
+    def step_set_accel(self, motor: int, accel: float):
+        """
+        设置电机加速度, 启停时按梯形曲线加减速
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        accel: deg/s^2, 正数, 0为不加减速
+        """
+        self._check_idle(motor)
+        self._byte_temp1.reset(motor, "u8", int)
+        self._byte_temp2.reset(accel, "s32", float, 0.01)
+        self._send_command(0x06, self._byte_temp1.bytes + self._byte_temp2.bytes)
+        self._action_log("set accel", f"Step {motor} accel: {accel}")
+
+    def step_set_jerk(self, motor: int, jerk: float):
+        """
+        设置电机加加速度, 与加速度同时设置时按S曲线加减速
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        jerk: deg/s^3, 正数, 0为梯形加减速
+        """
+        self._check_idle(motor)
+        self._byte_temp1.reset(motor, "u8", int)
+        self._byte_temp2.reset(jerk, "s32", float, 0.01)
+        self._send_command(0x07, self._byte_temp1.bytes + self._byte_temp2.bytes)
+        self._action_log("set jerk", f"Step {motor} jerk: {jerk}")
+
     def step_set_angle(self, motor: int, angle: float):
         """
         设置电机当前角度
@@ -79,11 +119,11 @@ class FC_Protocol(FC_Base_Uart_Comunication):
 
     def step_rotate(self, motor: int, deg: float):
         """
-        相对旋转电机
+        相对旋转电机, 电机转动时排队到当前运动之后执行
         motor: 电机掩码(eg: STEP1 | STEP2)
         deg: deg 旋转角度, 正数为顺时针
         """
-        self._check_idle(motor)
+        self._check_queue(motor)
         self._byte_temp1.reset(motor, "u8", int)
         self._byte_temp2.reset(deg, "s32", float, 0.001)
         self._send_command(0x03, self._byte_temp1.bytes + self._byte_temp2.bytes)
@@ -91,16 +131,146 @@ class FC_Protocol(FC_Base_Uart_Comunication):
 
     def step_rotate_abs(self, motor: int, deg: float):
         """
-        绝对旋转电机
+        绝对旋转电机, 电机转动时排队到当前运动之后执行
         motor: 电机掩码(eg: STEP1 | STEP2)
         deg: deg 旋转到的绝对角度, 正数为顺时针
         """
-        self._check_idle(motor)
+        self._check_queue(motor)
         self._byte_temp1.reset(motor, "u8", int)
         self._byte_temp2.reset(deg, "s32", float, 0.001)
         self._send_command(0x04, self._byte_temp1.bytes + self._byte_temp2.bytes)
         self._action_log("rotate abs", f"Step {motor} rotate to: {deg}")
 
+    def step_rotate_sync(
+        self, motor: int, speed: float, degs: list, absolute: bool = False
+    ):
+        """
+        多轴直线插补, 各轴同时启动并同时到达
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        speed: deg/s 位移最大轴的速度, 其余轴按比例缩放
+        degs: [step1, step2, step3] 各轴角度, 未选中的轴忽略
+        absolute: True为绝对角度, False为相对角度
+        """
+        assert len(degs) == 3, "degs must have 3 elements"
+        self._check_idle(motor)
+        self._byte_temp1.reset(motor | (0x80 if absolute else 0), "u8", int)
+        self._byte_temp2.reset(speed, "s32", float, 0.01)
+        data = self._byte_temp1.bytes + self._byte_temp2.bytes
+        for deg in degs:
+            self._byte_temp3.reset(deg, "s32", float, 0.001)
+            data += self._byte_temp3.bytes
+        self._send_command(0x08, data)
+        self._action_log("rotate sync", f"Step {motor} rotate: {degs}")
+
+    def step_retarget(self, motor: int, deg: float = None, speed: float = None):
+        """
+        运动中修改目标角度和速度, 不停止电机, 队列中未执行的运动被丢弃
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        deg: deg 新的绝对目标角度, None为保持当前目标
+        speed: deg/s 新的速度, None为保持当前速度
+        """
+        self._byte_temp1.reset(motor | (0x40 if deg is None else 0), "u8", int)
+        self._byte_temp2.reset(0 if deg is None else deg, "s32", float, 0.001)
+        self._byte_temp3.reset(0 if speed is None else speed, "s32", float, 0.01)
+        self._send_command(
+            0x09,
+            self._byte_temp1.bytes + self._byte_temp2.bytes + self._byte_temp3.bytes,
+        )
+        self._action_log("retarget", f"Step {motor} target: {deg} speed: {speed}")
+
+    def step_jog(self, motor: int, speed: float):
+        """
+        连续速度模式, 电机持续转动直到设置速度为0或下达位置运动
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        speed: deg/s 速度, 正数为顺时针, 0为减速停止
+        """
+        self._byte_temp1.reset(motor, "u8", int)
+        self._byte_temp2.reset(speed, "s32", float, 0.01)
+        self._send_command(0x0A, self._byte_temp1.bytes + self._byte_temp2.bytes)
+        self._action_log("jog", f"Step {motor} speed: {speed}")
+
+    def pvt_begin(self, motor: int):
+        """
+        开始轨迹点流式执行, 预填充足够的点后自动开始运动
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        """
+        self._check_idle(motor)
+        self._send_command(0x0B, struct.pack("<BB", motor, 0x01))
+        self._action_log("pvt begin", f"Step {motor}")
+
+    def pvt_end(self):
+        """
+        轨迹点发送完毕, 执行完缓冲中的点后停止
+        """
+        self._send_command(0x0B, struct.pack("<BB", 0, 0x02))
+        self._action_log("pvt end")
+
+    def pvt_abort(self):
+        """
+        立即停止轨迹点流式执行
+        """
+        self._send_command(0x0B, struct.pack("<BB", 0, 0x00))
+        self._action_log("pvt abort")
+
+    def pvt_send(self, points: list):
+        """
+        发送轨迹点(不等待ACK), 缓冲深度和取空次数见state.pvt_depth/pvt_underrun
+        points: [(time_ms, [deg1, deg2, deg3], [vel1, vel2, vel3] 或 None), ...]
+        time_ms为主机时钟时间戳(需递增), vel单位为deg/s, None为PT点(线性插值)
+        """
+        for i in range(0, len(points), self.PVT_MAX_PER_FRAME):
+            chunk = points[i : i + self.PVT_MAX_PER_FRAME]
+            data = struct.pack("<B", len(chunk))
+            for t, degs, vels in chunk:
+                assert len(degs) == 3, "degs must have 3 elements"
+                data += struct.pack("<IB", int(t) & 0xFFFFFFFF, vels is not None)
+                data += struct.pack("<3i", *[int(round(d * 1000)) for d in degs])
+                data += struct.pack(
+                    "<3i", *[int(round(v * 100)) for v in (vels or (0, 0, 0))]
+                )
+            self._send_command(0x0C, data, need_ack=False)
+
+    def _step_halt(self, motor: int, cmd: int, deg: float = 0):
+        self._byte_temp1.reset(motor, "u8", int)
+        self._byte_temp2.reset(cmd, "u8", int)
+        self._byte_temp3.reset(deg, "s32", float, 0.001)
+        self._send_command(
+            0x0D,
+            self._byte_temp1.bytes + self._byte_temp2.bytes + self._byte_temp3.bytes,
+        )
+
+    def step_stop_ramp(self, motor: int, deg: float = 0):
+        """
+        减速停止, 丢弃队列中的运动
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        deg: deg 最大停止距离, 0为按设定加速度减速
+        """
+        self._step_halt(motor, 0x00, deg)
+        self._action_log("stop ramp", f"Step {motor} within: {deg}")
+
+    def step_pause(self, motor: int):
+        """
+        暂停, 减速停止并保留剩余距离和队列
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        """
+        self._step_halt(motor, 0x01)
+        self._action_log("pause", f"Step {motor}")
+
+    def step_resume(self, motor: int):
+        """
+        恢复暂停的运动
+        motor: 电机掩码(eg: STEP1 | STEP2)
+        """
+        self._step_halt(motor, 0x02)
+        self._action_log("resume", f"Step {motor}")
+
+    def step_estop(self):
+        """
+        急停所有电机
+        """
+        self._step_halt(0, 0x03)
+        self._action_log("estop")
+
     def step_stop(self, motor: int):
         """
         停止电机
@@ -109,3 +279,76 @@ class FC_Protocol(FC_Base_Uart_Comunication):
         self._byte_temp1.reset(motor, "u8", int)
         self._send_command(0x05, self._byte_temp1.bytes)
         self._action_log("stop", f"Step {motor}")
+
+    def dc_set_speed(self, motor: int, rpm: float):
+        """
+        直流电机速度环
+        motor: 电机掩码(eg: DC1 | DC2)
+        rpm: 目标转速
+        """
+        data = struct.pack("<BBi", motor, 0x00, int(round(rpm * 100)))
+        self._send_command(0x0E, data)
+        self._action_log("dc speed", f"DC {motor} speed: {rpm}")
+
+    def dc_set_angle(self, motor: int, deg: float):
+        """
+        直流电机位置环
+        motor: 电机掩码(eg: DC1 | DC2)
+        deg: 目标角度(以中立位为基准)
+        """
+        data = struct.pack("<BBi", motor, 0x01, int(round(deg * 1000)))
+        self._send_command(0x0E, data)
+        self._action_log("dc angle", f"DC {motor} angle: {deg}")
+
+    def dc_set_gains(self, motor: int, loop: int, kp: float, ki: float, kd: float):
+        """
+        设置直流电机PID参数
+        motor: 电机掩码(eg: DC1 | DC2)
+        loop: 0:速度环 1:位置环
+        kp: 比例系数, ki: 积分系数(1/s), kd: 微分系数(s)
+        """
+        data = struct.pack("<BB", motor, loop)
+        data += struct.pack("<3i", *[int(round(k * 1e6)) for k in (kp, ki, kd)])
+        self._send_command(0x0F, data)
+        self._action_log("dc gains", f"DC {motor} loop {loop}: {kp}, {ki}, {kd}")
+
+    def dc_autotune(
+        self, motor: int, loop: int, amp: float, hyst: float, cycles: int = 4
+    ):
+        """
+        直流电机继电反馈自整定, 结果见state.dc1_tune/dc2_tune
+        motor: 电机掩码(eg: DC1 | DC2)
+        loop: 0:速度环(amp为%占空比, hyst为rpm) 1:位置环(amp为rpm, hyst为deg)
+        cycles: 平均的振荡周期数
+        """
+        data = struct.pack("<BB", motor, loop + 1)
+        data += struct.pack(
+            "<iiB", int(round(amp * 100)), int(round(hyst * 100)), cycles
+        )
+        self._send_command(0x10, data)
+        self._action_log("dc autotune", f"DC {motor} loop {loop}")
+
+    def dc_autotune_stop(self, motor: int):
+        """
+        中止直流电机自整定, 保留原参数
+        motor: 电机掩码(eg: DC1 | DC2)
+        """
+        self._send_command(0x10, struct.pack("<BBiiB", motor, 0x00, 0, 0, 0))
+        self._action_log("dc autotune stop", f"DC {motor}")
+
+    def sch_query(self, task: int, reset: bool = False, timeout: float = 0.5):
+        """
+        查询调度器任务运行统计
+        task: 任务id(Add_SchTask的返回值, 按添加顺序从0开始)
+        reset: 回传后清除该任务的统计
+        返回: dict(执行时间单位为cycles, 除以core_clock为秒), 超时返回None
+        """
+        self.sch_stats.pop(task, None)
+        self._send_command(0x11, struct.pack("<BB", task, 0x01 if reset else 0x00))
+        start_time = time.perf_counter()
+        while task not in self.sch_stats:
+            if time.perf_counter() - start_time > timeout:
+                logger.warning("[FC] Wait for sch stat timeout")
+                return None
+            time.sleep(0.001)
+        return self.sch_stats[task]